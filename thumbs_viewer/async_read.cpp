@@ -0,0 +1,298 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "async_read.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#define RING_ENTRIES	256		// Maximum number of reads in flight.
+
+// The submission and completion rings that are shared with the kernel.
+struct io_ring
+{
+	int fd;
+
+	unsigned char *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+	io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned char *cq_ring;		// Same as sq_ring if the kernel maps both rings together.
+	size_t cq_ring_size;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	io_uring_cqe *cqes;
+};
+
+void close_ring( io_ring *ring )
+{
+	if ( ring->sqes != NULL )
+	{
+		munmap( ring->sqes, ring->sqes_size );
+	}
+
+	if ( ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring )
+	{
+		munmap( ring->cq_ring, ring->cq_ring_size );
+	}
+
+	if ( ring->sq_ring != NULL )
+	{
+		munmap( ring->sq_ring, ring->sq_ring_size );
+	}
+
+	close( ring->fd );
+}
+
+bool open_ring( io_ring *ring, unsigned entries )
+{
+	memset( ring, 0, sizeof( io_ring ) );
+
+	io_uring_params params;
+	memset( &params, 0, sizeof( io_uring_params ) );
+
+	ring->fd = ( int )syscall( __NR_io_uring_setup, entries, &params );
+	if ( ring->fd < 0 )
+	{
+		return false;
+	}
+
+	ring->sq_ring_size = params.sq_off.array + ( params.sq_entries * sizeof( unsigned ) );
+	ring->cq_ring_size = params.cq_off.cqes + ( params.cq_entries * sizeof( io_uring_cqe ) );
+
+	// Newer kernels let both rings share one mapping.
+	if ( params.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		if ( ring->cq_ring_size > ring->sq_ring_size )
+		{
+			ring->sq_ring_size = ring->cq_ring_size;
+		}
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	void *sq_ring = mmap( NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING );
+	if ( sq_ring == MAP_FAILED )
+	{
+		close_ring( ring );
+		return false;
+	}
+	ring->sq_ring = ( unsigned char * )sq_ring;
+
+	if ( params.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		ring->cq_ring = ring->sq_ring;
+	}
+	else
+	{
+		void *cq_ring = mmap( NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING );
+		if ( cq_ring == MAP_FAILED )
+		{
+			close_ring( ring );
+			return false;
+		}
+		ring->cq_ring = ( unsigned char * )cq_ring;
+	}
+
+	ring->sqes_size = params.sq_entries * sizeof( io_uring_sqe );
+	void *sqes = mmap( NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES );
+	if ( sqes == MAP_FAILED )
+	{
+		close_ring( ring );
+		return false;
+	}
+	ring->sqes = ( io_uring_sqe * )sqes;
+
+	ring->sq_head = ( unsigned * )( ring->sq_ring + params.sq_off.head );
+	ring->sq_tail = ( unsigned * )( ring->sq_ring + params.sq_off.tail );
+	ring->sq_mask = ( unsigned * )( ring->sq_ring + params.sq_off.ring_mask );
+	ring->sq_array = ( unsigned * )( ring->sq_ring + params.sq_off.array );
+	ring->sq_entries = params.sq_entries;
+
+	ring->cq_head = ( unsigned * )( ring->cq_ring + params.cq_off.head );
+	ring->cq_tail = ( unsigned * )( ring->cq_ring + params.cq_off.tail );
+	ring->cq_mask = ( unsigned * )( ring->cq_ring + params.cq_off.ring_mask );
+	ring->cqes = ( io_uring_cqe * )( ring->cq_ring + params.cq_off.cqes );
+
+	return true;
+}
+
+// Adds a read of whatever remains of the request to the submission ring. There must be room for it.
+void queue_read( io_ring *ring, int file_fd, read_request *request, unsigned long index )
+{
+	unsigned tail = *ring->sq_tail;
+	unsigned sq_index = tail & *ring->sq_mask;
+
+	io_uring_sqe *sqe = &ring->sqes[ sq_index ];
+	memset( sqe, 0, sizeof( io_uring_sqe ) );
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = file_fd;
+	sqe->addr = ( unsigned long long )( size_t )( request->buf + request->read );
+	sqe->len = request->length - request->read;
+	sqe->off = request->offset + request->read;
+	sqe->user_data = index;
+
+	ring->sq_array[ sq_index ] = sq_index;
+
+	// The kernel mustn't see the new tail before the entry has been filled in.
+	__atomic_store_n( ring->sq_tail, tail + 1, __ATOMIC_RELEASE );
+}
+
+bool read_ranges( const wchar_t *path, read_request *requests, unsigned long count )
+{
+	if ( path == NULL || requests == NULL )
+	{
+		return false;
+	}
+
+	for ( unsigned long i = 0; i < count; ++i )
+	{
+		requests[ i ].read = 0;
+	}
+
+	if ( count == 0 )
+	{
+		return true;
+	}
+
+	// Paths are stored as wide characters. Convert it to the locale's multibyte encoding.
+	char mb_path[ PATH_MAX ];
+	size_t mb_length = wcstombs( mb_path, path, PATH_MAX );
+	if ( mb_length == ( size_t )-1 || mb_length >= PATH_MAX )
+	{
+		return false;
+	}
+
+	int file_fd = open( mb_path, O_RDONLY );
+	if ( file_fd == -1 )
+	{
+		return false;
+	}
+
+	io_ring ring;
+	if ( open_ring( &ring, ( count < RING_ENTRIES ? ( unsigned )count : RING_ENTRIES ) ) == false )
+	{
+		close( file_fd );
+		return false;
+	}
+
+	// Requests that were cut short and need the rest of their range read.
+	unsigned long *retries = ( unsigned long * )malloc( sizeof( unsigned long ) * count );
+	unsigned long retry_count = 0;
+
+	unsigned long next_request = 0;
+	unsigned long in_flight = 0;
+	unsigned long queued = 0;		// Entries in the submission ring that the kernel hasn't consumed yet.
+	bool ok = true;
+
+	while ( next_request < count || retry_count > 0 || in_flight > 0 )
+	{
+		// Fill the submission ring.
+		while ( in_flight < ring.sq_entries && ( retry_count > 0 || next_request < count ) )
+		{
+			unsigned long index = ( retry_count > 0 ? retries[ --retry_count ] : next_request++ );
+
+			queue_read( &ring, file_fd, &requests[ index ], index );
+
+			++in_flight;
+			++queued;
+		}
+
+		int ret = ( int )syscall( __NR_io_uring_enter, ring.fd, ( unsigned )queued, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+		if ( ret < 0 )
+		{
+			if ( errno == EINTR )
+			{
+				continue;
+			}
+
+			// Whatever the kernel didn't consume will never complete.
+			in_flight -= queued;
+
+			ok = false;
+			break;
+		}
+		queued -= ret;
+
+		// Collect the completed reads.
+		unsigned head = *ring.cq_head;
+		unsigned tail = __atomic_load_n( ring.cq_tail, __ATOMIC_ACQUIRE );
+		while ( head != tail )
+		{
+			io_uring_cqe *cqe = &ring.cqes[ head & *ring.cq_mask ];
+			read_request *request = &requests[ cqe->user_data ];
+
+			// A short read isn't the end of the file until it reads nothing.
+			if ( cqe->res > 0 )
+			{
+				request->read += cqe->res;
+				if ( request->read < request->length )
+				{
+					retries[ retry_count++ ] = ( unsigned long )cqe->user_data;
+				}
+			}
+
+			--in_flight;
+			++head;
+		}
+		__atomic_store_n( ring.cq_head, head, __ATOMIC_RELEASE );
+	}
+
+	// Wait for anything that's still in flight before the buffers are given back.
+	while ( ok == false && in_flight > 0 )
+	{
+		if ( syscall( __NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 ) < 0 && errno != EINTR )
+		{
+			break;
+		}
+
+		unsigned head = *ring.cq_head;
+		unsigned tail = __atomic_load_n( ring.cq_tail, __ATOMIC_ACQUIRE );
+		in_flight -= ( tail - head );
+		__atomic_store_n( ring.cq_head, tail, __ATOMIC_RELEASE );
+	}
+
+	free( retries );
+
+	close_ring( &ring );
+	close( file_fd );
+
+	// The caller falls back to reading everything itself.
+	if ( ok == false )
+	{
+		for ( unsigned long i = 0; i < count; ++i )
+		{
+			requests[ i ].read = 0;
+		}
+	}
+
+	return ok;
+}
@@ -0,0 +1,39 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASYNC_READ_H
+#define ASYNC_READ_H
+
+// Reads many ranges of a file at once through io_uring. It's only built on Linux with USE_IO_URING defined.
+
+#include <wchar.h>
+
+// A range of the file to read into buf.
+struct read_request
+{
+	unsigned long long offset;
+	char *buf;
+	unsigned long length;
+	unsigned long read;		// Number of bytes that were read. It's less than length if the read failed or reached the end of the file.
+};
+
+// Submits every request at once and waits for all of them to complete. They complete in any order.
+// Returns false if the file couldn't be opened or io_uring isn't available. Nothing is read in that case.
+bool read_ranges( const wchar_t *path, read_request *requests, unsigned long count );
+
+#endif
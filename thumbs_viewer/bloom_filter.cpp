@@ -0,0 +1,111 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bloom_filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Odd constants that pick a different bit for each word of a block.
+static const unsigned int bloom_salts[ BLOOM_BLOCK_WORDS ] = { 0x47B6137B, 0x44974D91, 0x8824AD5B, 0xA2B7289D, 0x705495C7, 0x2DF1424B, 0x9EFC4947, 0x5C6BFB31 };
+
+// Hashes that were built from file names don't have their bits evenly spread out. This mixes every bit of the hash.
+unsigned long long mix_bloom_hash( unsigned long long hash )
+{
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+void create_bloom_filter( bloom_filter *bf, unsigned long key_count )
+{
+	unsigned long block_bits = BLOOM_BLOCK_WORDS * 32;
+
+	bf->block_count = ( unsigned long )( ( ( unsigned long long )key_count * BLOOM_BITS_PER_KEY + block_bits - 1 ) / block_bits );
+	if ( bf->block_count == 0 )
+	{
+		bf->block_count = 1;
+	}
+
+	unsigned long block_size = sizeof( unsigned int ) * BLOOM_BLOCK_WORDS;
+
+	bf->buffer = malloc( ( block_size * bf->block_count ) + block_size - 1 );
+	bf->blocks = ( unsigned int * )( ( ( size_t )bf->buffer + block_size - 1 ) & ~( ( size_t )block_size - 1 ) );
+	memset( bf->blocks, 0, block_size * bf->block_count );
+
+	bf->capacity = ( bf->block_count * block_bits ) / BLOOM_BITS_PER_KEY;
+	bf->key_count = 0;
+}
+
+// The upper half of the hash picks the block, and the lower half picks the bits in it.
+unsigned int *get_bloom_block( bloom_filter *bf, unsigned long long hash )
+{
+	return bf->blocks + ( ( ( hash >> 32 ) * bf->block_count ) >> 32 ) * BLOOM_BLOCK_WORDS;
+}
+
+void add_bloom_filter( bloom_filter *bf, unsigned long long hash )
+{
+	hash = mix_bloom_hash( hash );
+
+	unsigned int *block = get_bloom_block( bf, hash );
+	unsigned int key = ( unsigned int )hash;
+
+	for ( int i = 0; i < BLOOM_BLOCK_WORDS; ++i )
+	{
+		block[ i ] |= 1U << ( ( key * bloom_salts[ i ] ) >> 27 );
+	}
+
+	++bf->key_count;
+}
+
+// Returns false if the hash was never added. Returns true if it might have been.
+bool check_bloom_filter( bloom_filter *bf, unsigned long long hash )
+{
+	if ( bf->blocks == NULL )
+	{
+		return false;
+	}
+
+	hash = mix_bloom_hash( hash );
+
+	unsigned int *block = get_bloom_block( bf, hash );
+	unsigned int key = ( unsigned int )hash;
+
+	// Every word is checked without branching so that the compiler can check them together.
+	unsigned int missing = 0;
+	for ( int i = 0; i < BLOOM_BLOCK_WORDS; ++i )
+	{
+		missing |= ~block[ i ] & ( 1U << ( ( key * bloom_salts[ i ] ) >> 27 ) );
+	}
+
+	return ( missing == 0 );
+}
+
+void free_bloom_filter( bloom_filter *bf )
+{
+	free( bf->buffer );
+	bf->buffer = NULL;
+	bf->blocks = NULL;
+	bf->block_count = 0;
+	bf->capacity = 0;
+	bf->key_count = 0;
+}
@@ -0,0 +1,41 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#define BLOOM_BLOCK_WORDS	8		// Each block is 256 bits. A hash sets one bit in every word of its block.
+#define BLOOM_BITS_PER_KEY	16		// About 0.2% of the hashes that were never added pass the filter.
+
+// A blocked Bloom filter. Every bit of a hash is in the same block, so checking a hash reads a single cache line.
+// It's only read once it's built, so any number of threads can check it.
+struct bloom_filter
+{
+	unsigned int *blocks;			// Aligned to the size of a block. NULL if the filter hasn't been created.
+	unsigned long block_count;
+	void *buffer;					// What was allocated for the blocks.
+	unsigned long capacity;			// Number of hashes that the blocks were sized for.
+	unsigned long key_count;		// Number of hashes that were added.
+};
+
+void create_bloom_filter( bloom_filter *bf, unsigned long key_count );
+void add_bloom_filter( bloom_filter *bf, unsigned long long hash );
+bool check_bloom_filter( bloom_filter *bf, unsigned long long hash );
+void free_bloom_filter( bloom_filter *bf );
+
+#endif
@@ -0,0 +1,128 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times hash table lookups with and without the Bloom filter in front of them. Run it with: make bench
+#include "bloom_filter.h"
+#include "hash_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_LOOKUPS		20000000
+#define BENCH_QUERY_COUNT	( 1 << 20 )	// Must be a power of 2.
+#define BENCH_HIT_PERCENT	1			// Most lookups are for files that aren't in any database.
+#define BENCH_UNSEEN_HASHES	4000000
+
+static unsigned long long random_state = 0xD1B54A32D192ED03ULL;
+
+// splitmix64
+static unsigned long long next_random()
+{
+	unsigned long long z = ( random_state += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+static double elapsed_ns( clock_t start, unsigned long count )
+{
+	return ( ( double )( clock() - start ) * 1000000000.0 / CLOCKS_PER_SEC ) / count;
+}
+
+static void bench_rows( unsigned long row_count )
+{
+	unsigned long long *hashes = ( unsigned long long * )malloc( sizeof( unsigned long long ) * row_count );
+
+	hash_table ht;
+	create_hash_table( &ht, row_count );
+
+	bloom_filter bf;
+	create_bloom_filter( &bf, row_count );
+
+	for ( unsigned long i = 0; i < row_count; ++i )
+	{
+		hashes[ i ] = next_random();
+		insert_hash_row( &ht, hashes[ i ], i + 1 );
+		add_bloom_filter( &bf, hashes[ i ] );
+	}
+
+	unsigned long false_positives = 0;
+	for ( unsigned long i = 0; i < BENCH_UNSEEN_HASHES; ++i )
+	{
+		if ( check_bloom_filter( &bf, next_random() ) == true )
+		{
+			++false_positives;
+		}
+	}
+
+	unsigned long long *queries = ( unsigned long long * )malloc( sizeof( unsigned long long ) * BENCH_QUERY_COUNT );
+	for ( unsigned long i = 0; i < BENCH_QUERY_COUNT; ++i )
+	{
+		queries[ i ] = ( next_random() % 100 < BENCH_HIT_PERCENT ? hashes[ next_random() % row_count ] : next_random() );
+	}
+
+	// The counts keep the lookups from being optimized away. They should be the same.
+	unsigned long table_found = 0;
+	unsigned long filter_found = 0;
+
+	clock_t start = clock();
+
+	for ( unsigned long i = 0; i < BENCH_LOOKUPS; ++i )
+	{
+		unsigned long position;
+		if ( find_hash_row( &ht, queries[ i & ( BENCH_QUERY_COUNT - 1 ) ], &position ) != 0 )
+		{
+			++table_found;
+		}
+	}
+
+	double table_find = elapsed_ns( start, BENCH_LOOKUPS );
+
+	start = clock();
+
+	for ( unsigned long i = 0; i < BENCH_LOOKUPS; ++i )
+	{
+		unsigned long long hash = queries[ i & ( BENCH_QUERY_COUNT - 1 ) ];
+		unsigned long position;
+		if ( check_bloom_filter( &bf, hash ) == true && find_hash_row( &ht, hash, &position ) != 0 )
+		{
+			++filter_found;
+		}
+	}
+
+	double filter_find = elapsed_ns( start, BENCH_LOOKUPS );
+
+	printf( "%8lu rows  filter %5lu KB  table %6lu KB  %.3f%% false positives  find: table %5.1f ns  filter and table %5.1f ns  (%lu %lu)\n",
+			row_count, ( bf.block_count * sizeof( unsigned int ) * BLOOM_BLOCK_WORDS ) / 1024, ( ht.slot_count * sizeof( hash_slot ) ) / 1024,
+			( 100.0 * false_positives ) / BENCH_UNSEEN_HASHES, table_find, filter_find, table_found, filter_found );
+
+	free_bloom_filter( &bf );
+	free_hash_table( &ht );
+	free( queries );
+	free( hashes );
+}
+
+int main()
+{
+	bench_rows( 1000 );
+	bench_rows( 100000 );
+	bench_rows( 1000000 );
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Checks that the Bloom filter never rejects a hash that was added, and that few others pass it. Run it with: make check
+#include "bloom_filter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_UNSEEN_HASHES			1000000
+#define TEST_MAX_FALSE_POSITIVES	0.2		// Percent. See BLOOM_BITS_PER_KEY.
+
+static unsigned long failures = 0;
+static unsigned long long random_state = 0x9FB21C651E98DF25ULL;
+
+// splitmix64
+static unsigned long long next_random()
+{
+	unsigned long long z = ( random_state += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+// Fills a filter to its capacity. sequential uses hashes that only differ in their low bits.
+static void check_filter( unsigned long key_count, bool sequential )
+{
+	const char *kind = ( sequential == true ? "sequential" : "random" );
+
+	bloom_filter bf;
+	create_bloom_filter( &bf, key_count );
+
+	if ( bf.capacity < key_count )
+	{
+		fprintf( stderr, "%lu %s hashes: the capacity is only %lu\n", key_count, kind, bf.capacity );
+		++failures;
+	}
+
+	unsigned long long base = next_random();
+	unsigned long long *hashes = ( unsigned long long * )malloc( sizeof( unsigned long long ) * bf.capacity );
+	for ( unsigned long i = 0; i < bf.capacity; ++i )
+	{
+		hashes[ i ] = ( sequential == true ? base + i : next_random() );
+		add_bloom_filter( &bf, hashes[ i ] );
+	}
+
+	unsigned long misses = 0;
+	for ( unsigned long i = 0; i < bf.capacity; ++i )
+	{
+		if ( check_bloom_filter( &bf, hashes[ i ] ) == false )
+		{
+			++misses;
+		}
+	}
+
+	// Sequential hashes that come after the added ones, or random hashes that were almost certainly never added.
+	unsigned long false_positives = 0;
+	for ( unsigned long i = 0; i < TEST_UNSEEN_HASHES; ++i )
+	{
+		if ( check_bloom_filter( &bf, ( sequential == true ? base + bf.capacity + i : next_random() ) ) == true )
+		{
+			++false_positives;
+		}
+	}
+
+	double rate = ( 100.0 * false_positives ) / TEST_UNSEEN_HASHES;
+
+	printf( "%9lu %-10s hashes: %lu missed, %.3f%% false positives\n", bf.capacity, kind, misses, rate );
+
+	if ( misses > 0 )
+	{
+		fprintf( stderr, "%lu %s hashes: %lu added hashes were missed\n", key_count, kind, misses );
+		++failures;
+	}
+
+	if ( rate > TEST_MAX_FALSE_POSITIVES )
+	{
+		fprintf( stderr, "%lu %s hashes: %.3f%% false positives is more than %.1f%%\n", key_count, kind, rate, TEST_MAX_FALSE_POSITIVES );
+		++failures;
+	}
+
+	free( hashes );
+	free_bloom_filter( &bf );
+}
+
+int main()
+{
+	// A filter that was never created (or was freed) has nothing in it.
+	bloom_filter bf;
+	memset( &bf, 0, sizeof( bloom_filter ) );
+	if ( check_bloom_filter( &bf, next_random() ) == true )
+	{
+		fprintf( stderr, "an empty filter passed a hash\n" );
+		++failures;
+	}
+
+	check_filter( 0, false );
+	check_filter( 1000, false );
+	check_filter( 100000, false );
+	check_filter( 1000000, false );
+	check_filter( 100000, true );
+
+	printf( "%s: %lu failures\n", ( failures == 0 ? "PASS" : "FAIL" ), failures );
+
+	return ( failures == 0 ? 0 : 1 );
+}
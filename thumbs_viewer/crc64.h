@@ -19,6 +19,16 @@
 #ifndef CRC64_H
 #define CRC64_H
 
+// Builds the tables and picks the fastest path. It must be called before any threads use crc64.
+// crc64 calls it if it wasn't, but that's only safe when there's a single thread.
+void initialize_crc64();
+
 unsigned long long crc64( char *buf, unsigned int length, unsigned long long init_crc );
 
+// The original byte at a time loop. Every path of crc64 must give the same result.
+unsigned long long crc64_bytes( const unsigned char *buf, unsigned long length, unsigned long long crc );
+
+// Turns the PCLMULQDQ path on or off, and returns true if it's used. It stays off if the processor doesn't support it.
+bool set_crc64_clmul( bool enable );
+
 #endif
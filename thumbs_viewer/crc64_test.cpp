@@ -0,0 +1,99 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Checks every path of crc64 against the byte at a time loop. Run it with: make check
+#include "crc64.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK_MAX_LENGTH	4096
+#define CHECK_ALIGNMENTS	16
+#define CHECK_SEEDS			4
+
+// Returns the number of mismatches.
+unsigned long check_lengths( unsigned char *data, const char *path )
+{
+	unsigned long mismatches = 0;
+
+	for ( unsigned int alignment = 0; alignment < CHECK_ALIGNMENTS; ++alignment )
+	{
+		for ( unsigned int length = 0; length <= CHECK_MAX_LENGTH; ++length )
+		{
+			for ( int s = 0; s < CHECK_SEEDS; ++s )
+			{
+				// All zeros, all ones, then random seeds.
+				unsigned long long seed = 0;
+				if ( s == 1 )
+				{
+					seed = 0xFFFFFFFFFFFFFFFFULL;
+				}
+				else if ( s > 1 )
+				{
+					seed = ( ( unsigned long long )rand() << 48 ) ^ ( ( unsigned long long )rand() << 24 ) ^ rand();
+				}
+
+				unsigned long long expected = crc64_bytes( data + alignment, length, seed );
+				unsigned long long actual = crc64( ( char * )( data + alignment ), length, seed );
+				if ( actual != expected )
+				{
+					if ( mismatches++ < 10 )
+					{
+						fprintf( stderr, "%s: length %u, alignment %u, seed %016llx: %016llx != %016llx\n", path, length, alignment, seed, actual, expected );
+					}
+				}
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+int main()
+{
+	srand( 1 );
+
+	unsigned char *data = ( unsigned char * )malloc( CHECK_MAX_LENGTH + CHECK_ALIGNMENTS );
+	for ( unsigned int i = 0; i < CHECK_MAX_LENGTH + CHECK_ALIGNMENTS; ++i )
+	{
+		data[ i ] = ( unsigned char )rand();
+	}
+
+	initialize_crc64();
+
+	unsigned long mismatches = 0;
+
+	if ( set_crc64_clmul( true ) == true )
+	{
+		mismatches += check_lengths( data, "pclmul" );
+	}
+	else
+	{
+		printf( "PCLMULQDQ isn't supported. Only the table path is checked.\n" );
+	}
+
+	set_crc64_clmul( false );
+
+	mismatches += check_lengths( data, "slice16" );
+
+	free( data );
+
+	printf( "%s: %lu mismatches\n", ( mismatches == 0 ? "PASS" : "FAIL" ), mismatches );
+
+	return ( mismatches == 0 ? 0 : 1 );
+}
@@ -352,7 +352,7 @@ dllrbt_status dllrbt_insert( dllrbt_tree *tree, void *key, void *val )
 	return DLLRBT_STATUS_OK;
 }
 
-void delete_fixup( tag_type *rbt, node_type *x )
+static void delete_fixup( tag_type *rbt, node_type *x )
 {
 	// Maintain red-black tree balance after deleting node x
 	while ( x != rbt->root && x->color == BLACK )
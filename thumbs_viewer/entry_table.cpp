@@ -0,0 +1,190 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "entry_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Moves the entry into a row and returns the row number. Returns 0 if the table is full, and the entry is left alone.
+// The row takes over the entry's filename and its reference to the shared info.
+unsigned long add_entry_row( entry_table *table, fileinfo *fi )
+{
+	unsigned long row = 0;
+
+	if ( table->free_count > 0 )
+	{
+		row = table->free_rows[ --table->free_count ];
+	}
+	else
+	{
+		if ( table->row_count == 0 )
+		{
+			table->row_count = 1;	// Skip row 0.
+		}
+
+		row = table->row_count;
+
+		if ( row / ENTRY_BLOCK_ROWS >= table->block_count )
+		{
+			if ( table->block_count == ENTRY_TABLE_BLOCKS )
+			{
+				return 0;
+			}
+
+			// The block is in place before any of its rows are handed out.
+			table->blocks[ table->block_count ] = ( entry_block * )malloc( sizeof( entry_block ) );
+			memset( table->blocks[ table->block_count ], 0, sizeof( entry_block ) );
+			++table->block_count;
+		}
+
+		++table->row_count;
+	}
+
+	entry_block *block = table->blocks[ row / ENTRY_BLOCK_ROWS ];
+	unsigned long index = row % ENTRY_BLOCK_ROWS;
+
+	block->entry_hash[ index ] = fi->entry_hash;
+	block->date_modified[ index ] = fi->date_modified;
+	block->si[ index ] = fi->si;
+	block->filename[ index ] = fi->filename;
+	block->offset[ index ] = fi->offset;
+	block->size[ index ] = fi->size;
+	block->entry_type[ index ] = fi->entry_type;
+	block->flag[ index ] = fi->flag & ~FIF_ARENA_ENTRY;	// The row doesn't keep the structure.
+
+	// An entry from the arena is freed along with its database.
+	if ( !( fi->flag & FIF_ARENA_ENTRY ) )
+	{
+		free( fi );
+	}
+
+	return row;
+}
+
+// Fills in fi so that the row can be passed to the database functions. Nothing in fi needs to be freed.
+void get_entry_row( entry_table *table, unsigned long row, fileinfo *fi )
+{
+	entry_block *block = table->blocks[ row / ENTRY_BLOCK_ROWS ];
+	unsigned long index = row % ENTRY_BLOCK_ROWS;
+
+	fi->entry_hash = block->entry_hash[ index ];
+	fi->date_modified = block->date_modified[ index ];
+	fi->si = block->si[ index ];
+	fi->filename = block->filename[ index ];
+	fi->offset = block->offset[ index ];
+	fi->size = block->size[ index ];
+	fi->entry_type = block->entry_type[ index ];
+	fi->flag = block->flag[ index ];
+}
+
+// Listview items can outlive their rows while the table is being cleared.
+bool is_entry_row( entry_table *table, unsigned long row )
+{
+	return ( row != 0 && row < table->row_count && ENTRY_FIELD( table, row, si ) != NULL );
+}
+
+// The row takes ownership of the filename. It must have been allocated with malloc.
+void set_entry_name( entry_table *table, unsigned long row, wchar_t *filename )
+{
+	entry_block *block = table->blocks[ row / ENTRY_BLOCK_ROWS ];
+	unsigned long index = row % ENTRY_BLOCK_ROWS;
+
+	if ( !( block->flag[ index ] & FIF_ARENA_NAME ) )
+	{
+		free( block->filename[ index ] );
+	}
+
+	block->filename[ index ] = filename;
+	block->flag[ index ] &= ~FIF_ARENA_NAME;
+}
+
+// Frees the row's filename, and its shared info if it was the last entry of the database.
+void release_entry_row( entry_table *table, unsigned long row )
+{
+	entry_block *block = table->blocks[ row / ENTRY_BLOCK_ROWS ];
+	unsigned long index = row % ENTRY_BLOCK_ROWS;
+
+	if ( !( block->flag[ index ] & FIF_ARENA_NAME ) )
+	{
+		free( block->filename[ index ] );
+	}
+
+	shared_info *si = block->si[ index ];
+	if ( si != NULL )
+	{
+		--( si->count );
+
+		if ( si->count == 0 )
+		{
+			cleanup_shared_info( &si );
+		}
+	}
+
+	block->si[ index ] = NULL;
+	block->filename[ index ] = NULL;
+	block->flag[ index ] = 0;
+}
+
+void remove_entry_row( entry_table *table, unsigned long row )
+{
+	if ( !is_entry_row( table, row ) )
+	{
+		return;
+	}
+
+	release_entry_row( table, row );
+
+	if ( table->free_count == table->free_size )
+	{
+		table->free_size = ( table->free_size == 0 ? 64 : table->free_size * 2 );
+		table->free_rows = ( unsigned long * )realloc( table->free_rows, sizeof( unsigned long ) * table->free_size );
+	}
+	table->free_rows[ table->free_count++ ] = row;
+}
+
+// Removes every row. The blocks are kept so that listview items that haven't been deleted yet can still be checked.
+void clear_entry_table( entry_table *table )
+{
+	for ( unsigned long row = 1; row < table->row_count; ++row )
+	{
+		if ( ENTRY_FIELD( table, row, si ) != NULL )
+		{
+			release_entry_row( table, row );
+		}
+	}
+
+	table->row_count = 0;
+	table->free_count = 0;
+}
+
+void free_entry_table( entry_table *table )
+{
+	clear_entry_table( table );
+
+	for ( unsigned long i = 0; i < table->block_count; ++i )
+	{
+		free( table->blocks[ i ] );
+		table->blocks[ i ] = NULL;
+	}
+	table->block_count = 0;
+
+	free( table->free_rows );
+	table->free_rows = NULL;
+	table->free_size = 0;
+}
@@ -0,0 +1,65 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTRY_TABLE_H
+#define ENTRY_TABLE_H
+
+#include "thumbs_db.h"
+
+#define ENTRY_BLOCK_ROWS	4096	// Number of rows in each block of the entry table.
+#define ENTRY_TABLE_BLOCKS	4096	// Maximum number of blocks. The block list never moves, so rows stay put while they're being read.
+
+// Gets a field of a row. It can also be assigned to.
+#define ENTRY_FIELD( table, row, field )	( ( table )->blocks[ ( row ) / ENTRY_BLOCK_ROWS ]->field[ ( row ) % ENTRY_BLOCK_ROWS ] )
+
+// Each field of a block's rows is kept in its own array. Scanning a column only touches that column.
+struct entry_block
+{
+	long long entry_hash[ ENTRY_BLOCK_ROWS ];		// Hashed filename for Vista and above.
+	long long date_modified[ ENTRY_BLOCK_ROWS ];	// Modified FILETIME
+	shared_info *si[ ENTRY_BLOCK_ROWS ];			// NULL if the row isn't being used.
+	wchar_t *filename[ ENTRY_BLOCK_ROWS ];
+	unsigned long offset[ ENTRY_BLOCK_ROWS ];
+	unsigned long size[ ENTRY_BLOCK_ROWS ];
+	char entry_type[ ENTRY_BLOCK_ROWS ];
+	unsigned char flag[ ENTRY_BLOCK_ROWS ];			// Same values as the fileinfo flag.
+};
+
+// Holds every entry that's in the listview. The listview items refer to their entries by row number.
+// Row 0 is never used so that it can stand for no entry.
+struct entry_table
+{
+	entry_block *blocks[ ENTRY_TABLE_BLOCKS ];
+	unsigned long block_count;
+
+	unsigned long row_count;		// Rows that have been handed out, including row 0 and any that were removed.
+
+	unsigned long *free_rows;		// Removed rows that can be handed out again.
+	unsigned long free_count;
+	unsigned long free_size;
+};
+
+unsigned long add_entry_row( entry_table *table, fileinfo *fi );
+void get_entry_row( entry_table *table, unsigned long row, fileinfo *fi );
+bool is_entry_row( entry_table *table, unsigned long row );
+void set_entry_name( entry_table *table, unsigned long row, wchar_t *filename );
+void remove_entry_row( entry_table *table, unsigned long row );
+void clear_entry_table( entry_table *table );
+void free_entry_table( entry_table *table );
+
+#endif
@@ -0,0 +1,144 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "file_map.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <limits.h>
+	#include <stdlib.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+bool map_file( file_map *fm, const wchar_t *path )
+{
+	if ( fm == NULL || path == NULL )
+	{
+		return false;
+	}
+
+	fm->base = NULL;
+	fm->size = 0;
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFile( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER f_size = { 0 };
+	GetFileSizeEx( hFile, &f_size );
+	fm->size = f_size.QuadPart;
+
+	// Empty files can't be mapped. Let the caller deal with the size.
+	if ( fm->size > 0 )
+	{
+		HANDLE hMap = CreateFileMapping( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		if ( hMap != NULL )
+		{
+			fm->base = ( unsigned char * )MapViewOfFile( hMap, FILE_MAP_READ, 0, 0, 0 );
+
+			// The view keeps its own reference to the mapping object.
+			CloseHandle( hMap );
+		}
+
+		if ( fm->base == NULL )
+		{
+			CloseHandle( hFile );
+
+			fm->size = 0;
+
+			return false;
+		}
+	}
+
+	// The mapping stays valid after the file handle is closed.
+	CloseHandle( hFile );
+#else
+	// Paths are stored as wide characters. Convert it to the locale's multibyte encoding.
+	char mb_path[ PATH_MAX ];
+	size_t mb_length = wcstombs( mb_path, path, PATH_MAX );
+	if ( mb_length == ( size_t )-1 || mb_length >= PATH_MAX )
+	{
+		return false;
+	}
+
+	int fd = open( mb_path, O_RDONLY );
+	if ( fd == -1 )
+	{
+		return false;
+	}
+
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 )
+	{
+		close( fd );
+
+		return false;
+	}
+
+	fm->size = st.st_size;
+
+	// Empty files can't be mapped. Let the caller deal with the size.
+	if ( fm->size > 0 )
+	{
+		void *view = mmap( NULL, fm->size, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( view == MAP_FAILED )
+		{
+			close( fd );
+
+			fm->size = 0;
+
+			return false;
+		}
+
+		fm->base = ( unsigned char * )view;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	close( fd );
+#endif
+
+	return true;
+}
+
+void unmap_file( file_map *fm )
+{
+	if ( fm == NULL )
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	if ( fm->base != NULL )
+	{
+		UnmapViewOfFile( fm->base );
+	}
+#else
+	if ( fm->base != NULL )
+	{
+		munmap( fm->base, fm->size );
+	}
+#endif
+
+	fm->base = NULL;
+	fm->size = 0;
+}
@@ -0,0 +1,43 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#ifdef _WIN32
+	#define STRICT
+	#define WIN32_LEAN_AND_MEAN
+
+	#include <windows.h>
+#endif
+
+// A read-only view of an entire file.
+struct file_map
+{
+	unsigned char *base;		// Beginning of the view. NULL if the file is empty.
+	unsigned long long size;	// Size of the file (and the view).
+};
+
+// Map the file into memory. Returns false if the file could not be opened or mapped.
+// No file handles or descriptors are held open once the view has been created.
+bool map_file( file_map *fm, const wchar_t *path );
+
+// Unmap the view.
+void unmap_file( file_map *fm );
+
+#endif
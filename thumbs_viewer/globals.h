@@ -38,6 +38,7 @@
 #include <process.h>
 
 #include "resource.h"
+#include "thumbs_db.h"
 
 #define PROGRAM_CAPTION		L"Thumbs Viewer"
 #define PROGRAM_CAPTION_A	"Thumbs Viewer"
@@ -52,57 +53,6 @@
 #define WM_CHANGE_CURSOR	WM_APP + 2	// Updates the window cursor.
 #define WM_ALERT			WM_APP + 3	// Called from threads to display a message box.
 
-// fileinfo flags.
-#define FIF_TYPE_JPG		1
-#define FIF_TYPE_CMYK_JPG	2
-#define FIF_TYPE_PNG		4
-#define FIF_TYPE_UNKNOWN	8
-
-// Holds shared variables among database entries.
-struct shared_info
-{
-	wchar_t dbpath[ MAX_PATH ];
-	long *sat;
-	long *ssat;
-	char *short_stream_container;
-	
-	//These are found in the database header.
-	unsigned long num_sat_sects;
-	long first_dir_sect;
-	long first_ssat_sect;
-	unsigned long num_ssat_sects;
-	long first_dis_sect;
-	unsigned long num_dis_sects;
-	unsigned long short_sect_cutoff;
-
-	unsigned long count;		// Number of directory entries.
-
-	unsigned short sect_size;
-	unsigned short version;
-	unsigned char system;		// 0 = Unknown, 1 = Me/2000, 2 = XP/2003, 3 = Vista/2008/7
-};
-
-// This structure holds information obtained as we read the database. It's passed as an lParam to our listview items.
-struct fileinfo
-{
-	long long entry_hash;				// Hashed filename for Vista and above.
-	long long date_modified;			// Modified FILETIME
-	shared_info *si;
-	fileinfo *next;						// Allows us to process catalog entries in order.
-	wchar_t *filename;					// Name of the database entry.
-	unsigned long offset;				// Offset in SAT or short stream container (depends on size of entry)
-	unsigned long size;					// Size of file.
-	char entry_type;
-	unsigned char flag;					// 1 = jpg, 2 = cmyk jpg, 4 = png, 8 = unknown, 16 = in tree.
-};
-
-// Holds duplicate entries.
-struct linked_list
-{
-	fileinfo *fi;
-	linked_list *next;
-};
-
 // Multi-file open structure.
 struct pathinfo
 {
@@ -0,0 +1,188 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "hash_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The slot that a hash starts looking from. Fibonacci hashing mixes every bit of the hash into the index.
+unsigned long get_home_slot( hash_table *ht, unsigned long long hash )
+{
+	return ( unsigned long )( ( hash * 0x9E3779B97F4A7C15ULL ) >> ht->shift );
+}
+
+// Makes room for the number of rows so that the table is never more than half full.
+void create_hash_table( hash_table *ht, unsigned long row_count )
+{
+	unsigned long slot_count = HASH_TABLE_MIN_SLOTS;
+	unsigned char bits = 4;
+	while ( slot_count < row_count * 2 )
+	{
+		slot_count *= 2;
+		++bits;
+	}
+
+	ht->slots = ( hash_slot * )malloc( sizeof( hash_slot ) * slot_count );
+	memset( ht->slots, 0, sizeof( hash_slot ) * slot_count );
+	ht->slot_count = slot_count;
+	ht->row_count = 0;
+	ht->shift = 64 - bits;
+}
+
+void grow_hash_table( hash_table *ht )
+{
+	hash_slot *slots = ht->slots;
+	unsigned long slot_count = ht->slot_count;
+
+	create_hash_table( ht, slot_count );
+
+	for ( unsigned long i = 0; i < slot_count; ++i )
+	{
+		if ( slots[ i ].row != 0 )
+		{
+			insert_hash_row( ht, slots[ i ].hash, slots[ i ].row );
+		}
+	}
+
+	free( slots );
+}
+
+void insert_hash_row( hash_table *ht, unsigned long long hash, unsigned long row )
+{
+	if ( row == 0 )
+	{
+		return;
+	}
+
+	if ( ( ht->row_count + 1 ) * 2 > ht->slot_count )
+	{
+		grow_hash_table( ht );
+	}
+
+	hash_slot slot;
+	slot.hash = hash;
+	slot.row = row;
+	slot.distance = 0;
+
+	unsigned long mask = ht->slot_count - 1;
+	unsigned long index = get_home_slot( ht, hash );
+
+	while ( ht->slots[ index ].row != 0 )
+	{
+		// Take the place of any row that's closer to its home, and keep going with that row instead.
+		if ( ht->slots[ index ].distance < slot.distance )
+		{
+			hash_slot swap = ht->slots[ index ];
+			ht->slots[ index ] = slot;
+			slot = swap;
+		}
+
+		index = ( index + 1 ) & mask;
+		++slot.distance;
+	}
+
+	ht->slots[ index ] = slot;
+	++ht->row_count;
+}
+
+// Returns the row that's found at or after the position, or 0 if there are no more rows with the hash.
+unsigned long find_hash_row_from( hash_table *ht, unsigned long long hash, unsigned long index, unsigned long distance, unsigned long *position )
+{
+	unsigned long mask = ht->slot_count - 1;
+
+	while ( ht->slots[ index ].row != 0 && ht->slots[ index ].distance >= distance )
+	{
+		if ( ht->slots[ index ].hash == hash )
+		{
+			*position = index;
+			return ht->slots[ index ].row;
+		}
+
+		index = ( index + 1 ) & mask;
+		++distance;
+	}
+
+	return 0;
+}
+
+// Returns the first row with the hash, or 0 if there isn't one. Pass the position to find_next_hash_row to get the others.
+unsigned long find_hash_row( hash_table *ht, unsigned long long hash, unsigned long *position )
+{
+	if ( ht->slots == NULL )
+	{
+		return 0;
+	}
+
+	return find_hash_row_from( ht, hash, get_home_slot( ht, hash ), 0, position );
+}
+
+unsigned long find_next_hash_row( hash_table *ht, unsigned long long hash, unsigned long *position )
+{
+	unsigned long mask = ht->slot_count - 1;
+	unsigned long index = ( *position + 1 ) & mask;
+	unsigned long distance = ht->slots[ *position ].distance + 1;
+
+	return find_hash_row_from( ht, hash, index, distance, position );
+}
+
+// Takes the row out of the table. Returns false if it wasn't filed under the hash.
+bool remove_hash_row( hash_table *ht, unsigned long long hash, unsigned long row )
+{
+	unsigned long position = 0;
+	unsigned long found = find_hash_row( ht, hash, &position );
+	while ( found != 0 && found != row )
+	{
+		found = find_next_hash_row( ht, hash, &position );
+	}
+
+	if ( found == 0 )
+	{
+		return false;
+	}
+
+	// Move the rows after it back a slot until one is in its home or the slot is empty.
+	// This leaves the table as if the row had never been inserted, so lookups can still stop early.
+	unsigned long mask = ht->slot_count - 1;
+	unsigned long index = position;
+	unsigned long next = ( index + 1 ) & mask;
+
+	while ( ht->slots[ next ].row != 0 && ht->slots[ next ].distance > 0 )
+	{
+		ht->slots[ index ] = ht->slots[ next ];
+		--ht->slots[ index ].distance;
+
+		index = next;
+		next = ( next + 1 ) & mask;
+	}
+
+	ht->slots[ index ].hash = 0;
+	ht->slots[ index ].row = 0;
+	ht->slots[ index ].distance = 0;
+	--ht->row_count;
+
+	return true;
+}
+
+void free_hash_table( hash_table *ht )
+{
+	free( ht->slots );
+	ht->slots = NULL;
+	ht->slot_count = 0;
+	ht->row_count = 0;
+}
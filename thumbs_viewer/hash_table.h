@@ -0,0 +1,49 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#define HASH_TABLE_MIN_SLOTS	16
+
+// A row and the hash it's filed under. Rows with the same hash each have their own slot.
+struct hash_slot
+{
+	unsigned long long hash;
+	unsigned long row;			// 0 if the slot is empty.
+	unsigned long distance;		// How far the slot is from where the hash would start looking.
+};
+
+// Open addressing with Robin Hood probing. A row is moved further along only by rows that are closer to their own slot.
+// A lookup can stop as soon as it reaches a row that's closer to its slot than the hash would be, so misses are short.
+struct hash_table
+{
+	hash_slot *slots;
+	unsigned long slot_count;	// Always a power of 2.
+	unsigned long row_count;
+	unsigned char shift;		// 64 minus the number of bits in a slot index.
+};
+
+void create_hash_table( hash_table *ht, unsigned long row_count );
+void insert_hash_row( hash_table *ht, unsigned long long hash, unsigned long row );
+unsigned long find_hash_row( hash_table *ht, unsigned long long hash, unsigned long *position );
+unsigned long find_next_hash_row( hash_table *ht, unsigned long long hash, unsigned long *position );
+bool remove_hash_row( hash_table *ht, unsigned long long hash, unsigned long row );
+void free_hash_table( hash_table *ht );
+
+#endif
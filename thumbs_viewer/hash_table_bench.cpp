@@ -0,0 +1,163 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times lookups in the hash table against the dllrbt tree that it replaced. Run it with: make bench
+// The tree is keyed on the hash the way the entry index used to be, with rows that share a hash in a list.
+#include "hash_table.h"
+#include "dllrbt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_LOOKUPS		10000000
+#define BENCH_QUERY_COUNT	( 1 << 20 )	// Must be a power of 2.
+#define BENCH_HIT_PERCENT	1			// Most lookups are for files that aren't in any database.
+
+struct linked_list
+{
+	unsigned long row;
+	linked_list *next;
+};
+
+static unsigned long long random_state = 0x2545F4914F6CDD1DULL;
+
+// splitmix64
+static unsigned long long next_random()
+{
+	unsigned long long z = ( random_state += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+static int bench_compare( void *a, void *b )
+{
+	if ( a > b )
+	{
+		return 1;
+	}
+
+	if ( a < b )
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static double elapsed_ns( clock_t start, unsigned long count )
+{
+	return ( ( double )( clock() - start ) * 1000000000.0 / CLOCKS_PER_SEC ) / count;
+}
+
+static void bench_rows( unsigned long row_count )
+{
+	unsigned long long *hashes = ( unsigned long long * )malloc( sizeof( unsigned long long ) * row_count );
+	linked_list *nodes = ( linked_list * )malloc( sizeof( linked_list ) * row_count );
+
+	// One in ten rows shares the hash of an earlier row.
+	for ( unsigned long i = 0; i < row_count; ++i )
+	{
+		hashes[ i ] = ( i % 10 == 9 ? hashes[ next_random() % i ] : next_random() );
+	}
+
+	clock_t start = clock();
+
+	hash_table ht;
+	create_hash_table( &ht, 0 );
+	for ( unsigned long i = 0; i < row_count; ++i )
+	{
+		insert_hash_row( &ht, hashes[ i ], i + 1 );
+	}
+
+	double hash_insert = elapsed_ns( start, row_count );
+
+	start = clock();
+
+	dllrbt_tree *tree = dllrbt_create( bench_compare );
+	for ( unsigned long i = 0; i < row_count; ++i )
+	{
+		nodes[ i ].row = i + 1;
+		nodes[ i ].next = NULL;
+
+		linked_list *ll = ( linked_list * )dllrbt_find( tree, ( void * )hashes[ i ], true );
+		if ( ll == NULL )
+		{
+			dllrbt_insert( tree, ( void * )hashes[ i ], &nodes[ i ] );
+		}
+		else
+		{
+			nodes[ i ].next = ll->next;
+			ll->next = &nodes[ i ];
+		}
+	}
+
+	double tree_insert = elapsed_ns( start, row_count );
+
+	unsigned long long *queries = ( unsigned long long * )malloc( sizeof( unsigned long long ) * BENCH_QUERY_COUNT );
+	for ( unsigned long i = 0; i < BENCH_QUERY_COUNT; ++i )
+	{
+		queries[ i ] = ( next_random() % 100 < BENCH_HIT_PERCENT ? hashes[ next_random() % row_count ] : next_random() );
+	}
+
+	// The sums keep the lookups from being optimized away.
+	unsigned long tree_sum = 0;
+	unsigned long hash_sum = 0;
+
+	start = clock();
+
+	for ( unsigned long i = 0; i < BENCH_LOOKUPS; ++i )
+	{
+		linked_list *ll = ( linked_list * )dllrbt_find( tree, ( void * )queries[ i & ( BENCH_QUERY_COUNT - 1 ) ], true );
+		if ( ll != NULL )
+		{
+			tree_sum += ll->row;
+		}
+	}
+
+	double tree_find = elapsed_ns( start, BENCH_LOOKUPS );
+
+	start = clock();
+
+	for ( unsigned long i = 0; i < BENCH_LOOKUPS; ++i )
+	{
+		unsigned long position;
+		hash_sum += find_hash_row( &ht, queries[ i & ( BENCH_QUERY_COUNT - 1 ) ], &position );
+	}
+
+	double hash_find = elapsed_ns( start, BENCH_LOOKUPS );
+
+	printf( "%9lu rows  insert: dllrbt %6.1f ns  hash %6.1f ns  find: dllrbt %6.1f ns  hash %6.1f ns  (%lu %lu)\n",
+			row_count, tree_insert, hash_insert, tree_find, hash_find, tree_sum, hash_sum );
+
+	dllrbt_delete_recursively( tree );
+	free_hash_table( &ht );
+	free( queries );
+	free( nodes );
+	free( hashes );
+}
+
+int main()
+{
+	bench_rows( 1000 );
+	bench_rows( 100000 );
+	bench_rows( 1000000 );
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Checks the hash table against a std::multimap while rows are inserted, found, and removed. Run it with: make check
+#include "hash_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#define TEST_OPERATIONS		200000
+#define TEST_CHECK_INTERVAL	997
+
+static unsigned long failures = 0;
+static unsigned long long random_state = 0x853C49E6748FEA9BULL;
+
+// splitmix64. rand() only gives 15 bits on some systems.
+static unsigned long long next_random()
+{
+	unsigned long long z = ( random_state += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+static void fail( const char *message, unsigned long long hash )
+{
+	if ( failures++ < 10 )
+	{
+		fprintf( stderr, "%s: hash %016llx\n", message, hash );
+	}
+}
+
+// Every row that's filed under the hash must be found, and nothing else.
+static void check_hash( hash_table *ht, std::multimap< unsigned long long, unsigned long > &expected, unsigned long long hash )
+{
+	std::multiset< unsigned long > want;
+	std::multiset< unsigned long > got;
+
+	std::pair< std::multimap< unsigned long long, unsigned long >::iterator, std::multimap< unsigned long long, unsigned long >::iterator > range = expected.equal_range( hash );
+	for ( std::multimap< unsigned long long, unsigned long >::iterator i = range.first; i != range.second; ++i )
+	{
+		want.insert( i->second );
+	}
+
+	unsigned long position = 0;
+	for ( unsigned long row = find_hash_row( ht, hash, &position ); row != 0; row = find_next_hash_row( ht, hash, &position ) )
+	{
+		got.insert( row );
+	}
+
+	if ( want != got )
+	{
+		fail( "the rows don't match", hash );
+	}
+}
+
+// A row can only be displaced past its home if every slot before it is full and no closer to its own home.
+// If remove_hash_row didn't move the rows after it back, this is where it shows up.
+static void check_slots( hash_table *ht )
+{
+	unsigned long mask = ht->slot_count - 1;
+	unsigned long used = 0;
+
+	for ( unsigned long i = 0; i < ht->slot_count; ++i )
+	{
+		hash_slot *slot = &ht->slots[ i ];
+		if ( slot->row == 0 )
+		{
+			if ( slot->distance != 0 )
+			{
+				fail( "an empty slot has a distance", slot->hash );
+			}
+
+			continue;
+		}
+
+		++used;
+
+		hash_slot *previous = &ht->slots[ ( i - 1 ) & mask ];
+		if ( slot->distance > 0 && ( previous->row == 0 || previous->distance + 1 < slot->distance ) )
+		{
+			fail( "a row is further from its home than it should be", slot->hash );
+		}
+	}
+
+	if ( used != ht->row_count )
+	{
+		fail( "the row count is wrong", used );
+	}
+}
+
+// Three rows with the same hash, then the first is removed. The other two must move back into its slot.
+static void check_shift()
+{
+	hash_table ht;
+	create_hash_table( &ht, 0 );
+
+	unsigned long long hash = 0x1234567890ABCDEFULL;
+	insert_hash_row( &ht, hash, 1 );
+	insert_hash_row( &ht, hash, 2 );
+	insert_hash_row( &ht, hash, 3 );
+
+	unsigned long position = 0;
+	unsigned long row = find_hash_row( &ht, hash, &position );
+	unsigned long home = position;
+
+	if ( remove_hash_row( &ht, hash, row ) == false )
+	{
+		fail( "the first row wasn't removed", hash );
+	}
+
+	if ( ht.slots[ home ].row == 0 || ht.slots[ home ].distance != 0 || ht.slots[ ( home + 1 ) & ( ht.slot_count - 1 ) ].distance != 1 ||
+		 ht.slots[ ( home + 2 ) & ( ht.slot_count - 1 ) ].row != 0 )
+	{
+		fail( "the rows weren't moved back", hash );
+	}
+
+	if ( remove_hash_row( &ht, hash, row ) == true )
+	{
+		fail( "a removed row was removed again", hash );
+	}
+
+	if ( remove_hash_row( &ht, hash + 1, ht.slots[ home ].row ) == true )
+	{
+		fail( "a row was removed under the wrong hash", hash );
+	}
+
+	check_slots( &ht );
+
+	free_hash_table( &ht );
+}
+
+int main()
+{
+	check_shift();
+
+	hash_table ht;
+	create_hash_table( &ht, 0 );	// Start small so that it grows.
+
+	std::multimap< unsigned long long, unsigned long > expected;
+	std::vector< std::pair< unsigned long long, unsigned long > > rows;
+	unsigned long next_row = 1;
+
+	for ( unsigned long i = 0; i < TEST_OPERATIONS; ++i )
+	{
+		unsigned long operation = ( unsigned long )( next_random() % 10 );
+
+		if ( operation < 6 || rows.empty() == true )
+		{
+			// A third of the rows reuse a hash so that they chain. The others only differ in a few bits so that their homes collide.
+			unsigned long long hash;
+			if ( rows.empty() == false && next_random() % 3 == 0 )
+			{
+				hash = rows[ ( size_t )( next_random() % rows.size() ) ].first;
+			}
+			else
+			{
+				hash = next_random() & 0xFF000000000000FFULL;
+			}
+
+			insert_hash_row( &ht, hash, next_row );
+			expected.insert( std::make_pair( hash, next_row ) );
+			rows.push_back( std::make_pair( hash, next_row ) );
+			++next_row;
+		}
+		else
+		{
+			size_t index = ( size_t )( next_random() % rows.size() );
+			std::pair< unsigned long long, unsigned long > row = rows[ index ];
+			rows[ index ] = rows.back();
+			rows.pop_back();
+
+			if ( remove_hash_row( &ht, row.first, row.second ) == false )
+			{
+				fail( "a row wasn't removed", row.first );
+			}
+
+			std::pair< std::multimap< unsigned long long, unsigned long >::iterator, std::multimap< unsigned long long, unsigned long >::iterator > range = expected.equal_range( row.first );
+			for ( std::multimap< unsigned long long, unsigned long >::iterator j = range.first; j != range.second; ++j )
+			{
+				if ( j->second == row.second )
+				{
+					expected.erase( j );
+					break;
+				}
+			}
+
+			if ( remove_hash_row( &ht, row.first, row.second ) == true )
+			{
+				fail( "a removed row was removed again", row.first );
+			}
+
+			check_hash( &ht, expected, row.first );
+		}
+
+		if ( i % TEST_CHECK_INTERVAL == 0 )
+		{
+			check_slots( &ht );
+
+			for ( size_t j = 0; j < rows.size(); j += 7 )
+			{
+				check_hash( &ht, expected, rows[ j ].first );
+			}
+
+			// Hashes that were never inserted.
+			for ( int j = 0; j < 100; ++j )
+			{
+				check_hash( &ht, expected, next_random() | 0x0000FFFFFFFFFF00ULL );
+			}
+		}
+	}
+
+	// Empty the table. Every row has to be found on the way out.
+	while ( rows.empty() == false )
+	{
+		if ( remove_hash_row( &ht, rows.back().first, rows.back().second ) == false )
+		{
+			fail( "a row wasn't removed", rows.back().first );
+		}
+
+		rows.pop_back();
+	}
+
+	if ( ht.row_count != 0 )
+	{
+		fail( "rows were left in the table", ht.row_count );
+	}
+
+	check_slots( &ht );
+
+	free_hash_table( &ht );
+
+	printf( "%s: %lu failures\n", ( failures == 0 ? "PASS" : "FAIL" ), failures );
+
+	return ( failures == 0 ? 0 : 1 );
+}
@@ -19,6 +19,8 @@
 #include "map_entries.h"
 #include "globals.h"
 #include "utilities.h"
+#include "scan_index.h"
+#include "typed_rbt.h"
 
 #include <stdio.h>
 
@@ -27,41 +29,238 @@ wchar_t g_extension_filter[ MAX_PATH + 2 ] = { 0 };	// A list of extensions to f
 
 bool g_include_folders = false;						// Include folders in a file scan.
 bool g_show_details = false;						// Show details in the scan window.
+bool g_watch_changes = false;						// Keep mapping the files that are added or renamed after a file scan.
+bool g_watching = false;							// The file scan is done and we're watching for changes.
 
 bool g_kill_scan = true;							// Stop a file scan.
 
-unsigned int file_count = 0;						// Number of files scanned.
+volatile LONG file_count = 0;						// Number of files scanned.
 unsigned int match_count = 0;						// Number of files that match an entry hash.
 
-void update_scan_info( unsigned long long hash, wchar_t *filepath )
+// A directory that's waiting to be enumerated.
+struct scan_directory
 {
-	// Now that we have a hash value to compare, search our fileinfo tree for the same value.
-	linked_list *ll = ( linked_list * )dllrbt_find( fileinfo_tree, ( void * )hash, true );
-	while ( ll != NULL )
+	wchar_t *path;
+	unsigned long *order;	// Position of the directory within each of its parents, starting below the scan's root.
+	unsigned long depth;	// Number of positions in order.
+};
+
+// Each worker takes the most recent directory from the end of its own deque.
+// Once it's empty, it steals the oldest directory from the beginning of another worker's deque.
+struct scan_deque
+{
+	scan_directory **directories;
+	unsigned long start;
+	unsigned long end;
+	unsigned long size;
+	CRITICAL_SECTION lock;
+};
+
+// A name that was hashed by the worker.
+struct name_cache_entry
+{
+	unsigned long long hash;
+	unsigned short length;				// 0 if the slot is empty.
+	wchar_t name[ NAME_CACHE_LENGTH ];	// Not NULL terminated.
+};
+
+// Files of a directory that are waiting to be hashed.
+struct hash_batch
+{
+	wchar_t filepaths[ HASH_BATCH_SIZE ][ ( MAX_PATH * 2 ) + 2 ];
+	wchar_t names[ HASH_BATCH_SIZE ][ MAX_PATH ];
+	unsigned long lengths[ HASH_BATCH_SIZE ];
+	unsigned long long hashes[ HASH_BATCH_SIZE ];
+	unsigned long positions[ HASH_BATCH_SIZE ];	// Position of the file within its directory.
+	bool is_folder[ HASH_BATCH_SIZE ];
+	bool report[ HASH_BATCH_SIZE ];				// Compare the file with the entries. Otherwise, it's only hashed for the scan index.
+	unsigned long count;
+
+	scan_index_directory *sid;					// The directory's contents for the scan index. NULL if there's no index.
+
+	name_cache_entry cache[ NAME_CACHE_SIZE ];
+};
+
+struct extension_slot
+{
+	wchar_t *extension;		// NULL if the slot is empty.
+	unsigned long length;
+};
+
+// The extensions are split up once and kept in an open addressed table, so that files are matched without any allocations.
+struct extension_filter
+{
+	wchar_t extensions[ MAX_PATH + 2 ];
+	extension_slot slots[ EXTENSION_FILTER_SLOTS ];
+	unsigned long longest;	// Length of the longest extension.
+	bool enabled;
+};
+
+// The file that matched a row last, in the order a depth-first walk would have reached it.
+struct scan_match
+{
+	wchar_t *filepath;
+	unsigned long *order;
+	unsigned long depth;
+};
+
+struct scan_queue
+{
+	scan_deque *deques;
+	unsigned long deque_count;
+
+	volatile LONG pending;		// Directories that are queued or being enumerated. The scan is done once it's 0.
+	volatile LONG next_worker;	// Deque of the next worker that starts.
+
+	typed_dllrbt< unsigned long, scan_match * > matches;	// scan_match of each matched row, keyed by the row.
+	CRITICAL_SECTION lock;		// Guards the matches, the match count, and the scan window's details.
+
+	scan_index si;				// Directories that haven't changed since the previous scan aren't enumerated.
+
+	extension_filter filter;
+};
+
+// Compares the positions of two files as if they were reached by a depth-first walk.
+int order_compare( unsigned long *a, unsigned long a_depth, unsigned long *b, unsigned long b_depth )
+{
+	for ( unsigned long i = 0; i < a_depth && i < b_depth; ++i )
+	{
+		if ( a[ i ] != b[ i ] )
+		{
+			return ( a[ i ] > b[ i ] ? 1 : -1 );
+		}
+	}
+
+	return ( a_depth == b_depth ? 0 : ( a_depth > b_depth ? 1 : -1 ) );
+}
+
+void push_directory( scan_deque *deque, scan_directory *sd )
+{
+	EnterCriticalSection( &deque->lock );
+
+	if ( deque->end == deque->size )
+	{
+		// Reuse the space that was left by stolen directories before growing.
+		if ( deque->start > 0 )
+		{
+			memmove( deque->directories, deque->directories + deque->start, sizeof( scan_directory * ) * ( deque->end - deque->start ) );
+			deque->end -= deque->start;
+			deque->start = 0;
+		}
+
+		if ( deque->end == deque->size )
+		{
+			deque->size = ( deque->size == 0 ? 64 : deque->size * 2 );
+			deque->directories = ( scan_directory ** )realloc( deque->directories, sizeof( scan_directory * ) * deque->size );
+		}
+	}
+
+	deque->directories[ deque->end++ ] = sd;
+
+	LeaveCriticalSection( &deque->lock );
+}
+
+// Takes a directory from either end of the deque. Returns NULL if it's empty.
+scan_directory *take_directory( scan_deque *deque, bool steal )
+{
+	scan_directory *sd = NULL;
+
+	EnterCriticalSection( &deque->lock );
+
+	if ( deque->start < deque->end )
+	{
+		sd = ( steal == true ? deque->directories[ deque->start++ ] : deque->directories[ --deque->end ] );
+
+		if ( deque->start == deque->end )
+		{
+			deque->start = deque->end = 0;
+		}
+	}
+
+	LeaveCriticalSection( &deque->lock );
+
+	return sd;
+}
+
+void free_scan_directory( scan_directory *sd )
+{
+	free( sd->path );
+	free( sd->order );
+	free( sd );
+}
+
+// Keep the file if it's the last one to match the row in depth-first order.
+// The queue's lock must be held.
+void add_scan_match( scan_queue *sq, unsigned long row, wchar_t *filepath, unsigned long *order, unsigned long depth )
+{
+	scan_match *sm = sq->matches.find_value( row, NULL );
+	if ( sm == NULL )
+	{
+		sm = ( scan_match * )malloc( sizeof( scan_match ) );
+		sm->filepath = NULL;
+		sm->order = NULL;
+		sm->depth = 0;
+
+		if ( sq->matches.insert( row, sm ) == false )
+		{
+			free( sm );
+			return;
+		}
+	}
+	else if ( order_compare( order, depth, sm->order, sm->depth ) < 0 )
+	{
+		return;
+	}
+
+	free( sm->filepath );
+	free( sm->order );
+
+	sm->filepath = _wcsdup( filepath );
+	sm->order = ( unsigned long * )malloc( sizeof( unsigned long ) * depth );
+	memcpy( sm->order, order, sizeof( unsigned long ) * depth );
+	sm->depth = depth;
+}
+
+void update_scan_info( scan_queue *sq, unsigned long long hash, wchar_t *filepath, unsigned long *order, unsigned long depth )
+{
+	// Now that we have a hash value to compare, search our entry hash table for the same value.
+	// The table is kept up to date as entries are added and removed. It isn't changed while we're scanning, so every worker can search it.
+	// Nearly every file is a miss. The Bloom filter rules most of them out without touching the table.
+	unsigned long position = 0;
+	unsigned long row = ( check_bloom_filter( &entry_bloom_filter, hash ) == true ? find_hash_row( &entry_hash_table, hash, &position ) : 0 );
+	if ( row != 0 )
 	{
-		if ( ll->fi != NULL )
+		EnterCriticalSection( &sq->lock );
+
+		for ( ; row != 0; row = find_next_hash_row( &entry_hash_table, hash, &position ) )
 		{
-			++match_count;
+			if ( is_entry_row( &g_entry_table, row ) )
+			{
+				++match_count;
 
-			// Replace the hash filename with the local filename.
-			free( ll->fi->filename );
-			ll->fi->filename = _wcsdup( filepath );
+				// The hash filename is replaced with the local filename once the scan is done.
+				add_scan_match( sq, row, filepath, order, depth );
+			}
 		}
 
-		ll = ll->next;
+		LeaveCriticalSection( &sq->lock );
 	}
 
-	++file_count; 
+	LONG count = InterlockedIncrement( &file_count );
 
 	// Update our scan window with new scan information.
 	if ( g_show_details == true )
 	{
+		EnterCriticalSection( &sq->lock );
+
 		SendMessage( g_hWnd_scan, WM_PROPAGATE, 3, ( LPARAM )filepath );
 		char buf[ 17 ] = { 0 };
 		sprintf_s( buf, 17, "%016llx", hash );
 		SendMessageA( g_hWnd_scan, WM_PROPAGATE, 4, ( LPARAM )buf );
-		sprintf_s( buf, 17, "%lu", file_count );
+		sprintf_s( buf, 17, "%lu", count );
 		SendMessageA( g_hWnd_scan, WM_PROPAGATE, 5, ( LPARAM )buf );
+
+		LeaveCriticalSection( &sq->lock );
 	}
 }
 
@@ -75,18 +274,310 @@ unsigned long long hash_data( char *data, unsigned long long hash, short length
 	return hash;
 }
 
-void hash_file( wchar_t *filepath, wchar_t *filename )
+// Hashes HASH_LANES names at once. Each hash depends on the one before it, so a single name can't be hashed any faster.
+// Interleaving independent names keeps the processor busy while each hash waits on its previous value.
+// The lanes run for as long as the shortest name, and what's left of each name is finished on its own.
+void hash_lanes( wchar_t **names, unsigned long *lengths, unsigned long long *hashes )
 {
+	unsigned char *data[ HASH_LANES ];
+	short remaining[ HASH_LANES ];
+	short shortest = 0x7FFF;
+
+	for ( int i = 0; i < HASH_LANES; ++i )
+	{
+		data[ i ] = ( unsigned char * )names[ i ];
+		remaining[ i ] = ( short )( lengths[ i ] * sizeof( wchar_t ) );	// Same truncation as hash_data.
+		shortest = ( remaining[ i ] < shortest ? remaining[ i ] : shortest );
+	}
+
 	// Initial hash value. This value was found in thumbcache.dll.
-	unsigned long long hash = 0x295BA83CF71232D9;
+	unsigned long long hash0 = 0x295BA83CF71232D9, hash1 = 0x295BA83CF71232D9, hash2 = 0x295BA83CF71232D9, hash3 = 0x295BA83CF71232D9;
 
-	// Hash the filename.
-	hash = hash_data( ( char * )filename, hash, wcslen( filename ) * sizeof( wchar_t ) );
+	for ( short i = 0; i < shortest; ++i )
+	{
+		hash0 = ( ( ( hash0 * 0x820 ) + data[ 0 ][ i ] ) + ( hash0 >> 2 ) ) ^ hash0;
+		hash1 = ( ( ( hash1 * 0x820 ) + data[ 1 ][ i ] ) + ( hash1 >> 2 ) ) ^ hash1;
+		hash2 = ( ( ( hash2 * 0x820 ) + data[ 2 ][ i ] ) + ( hash2 >> 2 ) ) ^ hash2;
+		hash3 = ( ( ( hash3 * 0x820 ) + data[ 3 ][ i ] ) + ( hash3 >> 2 ) ) ^ hash3;
+	}
+
+	if ( shortest < 0 )
+	{
+		shortest = 0;
+	}
+
+	hashes[ 0 ] = hash_data( ( char * )data[ 0 ] + shortest, hash0, remaining[ 0 ] - shortest );
+	hashes[ 1 ] = hash_data( ( char * )data[ 1 ] + shortest, hash1, remaining[ 1 ] - shortest );
+	hashes[ 2 ] = hash_data( ( char * )data[ 2 ] + shortest, hash2, remaining[ 2 ] - shortest );
+	hashes[ 3 ] = hash_data( ( char * )data[ 3 ] + shortest, hash3, remaining[ 3 ] - shortest );
+}
+
+// The cache is direct mapped. Names that are longer than NAME_CACHE_LENGTH aren't cached.
+unsigned long get_name_slot( wchar_t *name, unsigned long length )
+{
+	unsigned long slot = length;
+
+	for ( unsigned long i = 0; i < length; ++i )
+	{
+		slot = ( slot * 33 ) + name[ i ];
+	}
 
-	update_scan_info( hash, filepath );
+	return slot & ( NAME_CACHE_SIZE - 1 );
 }
 
-void traverse_directory( wchar_t *path )
+// Names that were recently hashed by the worker are found in its cache. The rest are hashed HASH_LANES at a time.
+void hash_names( hash_batch *hb )
+{
+	unsigned long misses[ HASH_BATCH_SIZE ];
+	unsigned long miss_count = 0;
+
+	for ( unsigned long i = 0; i < hb->count; ++i )
+	{
+		hb->lengths[ i ] = wcslen( hb->names[ i ] );
+
+		if ( hb->lengths[ i ] <= NAME_CACHE_LENGTH )
+		{
+			name_cache_entry *nce = &hb->cache[ get_name_slot( hb->names[ i ], hb->lengths[ i ] ) ];
+			if ( nce->length == hb->lengths[ i ] && wmemcmp( nce->name, hb->names[ i ], hb->lengths[ i ] ) == 0 )
+			{
+				hb->hashes[ i ] = nce->hash;
+				continue;
+			}
+		}
+
+		misses[ miss_count++ ] = i;
+	}
+
+	wchar_t *names[ HASH_LANES ];
+	unsigned long lengths[ HASH_LANES ];
+	unsigned long long hashes[ HASH_LANES ];
+
+	unsigned long m = 0;
+	for ( ; m + HASH_LANES <= miss_count; m += HASH_LANES )
+	{
+		for ( int lane = 0; lane < HASH_LANES; ++lane )
+		{
+			names[ lane ] = hb->names[ misses[ m + lane ] ];
+			lengths[ lane ] = hb->lengths[ misses[ m + lane ] ];
+		}
+
+		hash_lanes( names, lengths, hashes );
+
+		for ( int lane = 0; lane < HASH_LANES; ++lane )
+		{
+			hb->hashes[ misses[ m + lane ] ] = hashes[ lane ];
+		}
+	}
+
+	// Not enough names are left to fill the lanes.
+	for ( ; m < miss_count; ++m )
+	{
+		// Initial hash value. This value was found in thumbcache.dll.
+		hb->hashes[ misses[ m ] ] = hash_data( ( char * )hb->names[ misses[ m ] ], 0x295BA83CF71232D9, hb->lengths[ misses[ m ] ] * sizeof( wchar_t ) );
+	}
+
+	for ( m = 0; m < miss_count; ++m )
+	{
+		unsigned long i = misses[ m ];
+		if ( hb->lengths[ i ] <= NAME_CACHE_LENGTH )
+		{
+			name_cache_entry *nce = &hb->cache[ get_name_slot( hb->names[ i ], hb->lengths[ i ] ) ];
+			wmemcpy( nce->name, hb->names[ i ], hb->lengths[ i ] );
+			nce->length = ( unsigned short )hb->lengths[ i ];
+			nce->hash = hb->hashes[ i ];
+		}
+	}
+}
+
+// Hashes the batch's files and compares them with the entries. order holds the position of the directory that they're in.
+void flush_hash_batch( scan_queue *sq, hash_batch *hb, unsigned long *order, unsigned long depth )
+{
+	hash_names( hb );
+
+	for ( unsigned long i = 0; i < hb->count; ++i )
+	{
+		if ( hb->sid != NULL )
+		{
+			hb->sid->entries[ hb->positions[ i ] ].hash = hb->hashes[ i ];
+		}
+
+		if ( hb->report[ i ] == true )
+		{
+			order[ depth ] = hb->positions[ i ];
+
+			update_scan_info( sq, hb->hashes[ i ], hb->filepaths[ i ], order, depth + ( hb->is_folder[ i ] == true ? 2 : 1 ) );
+		}
+	}
+
+	hb->count = 0;
+}
+
+// Adds the file to the batch. Its path is built in the batch.
+void add_hash_batch( scan_queue *sq, hash_batch *hb, wchar_t *path, wchar_t *filename, unsigned long *order, unsigned long depth, unsigned long position, bool is_folder, bool report )
+{
+	if ( hb->count == HASH_BATCH_SIZE )
+	{
+		flush_hash_batch( sq, hb, order, depth );
+	}
+
+	swprintf_s( hb->filepaths[ hb->count ], ( MAX_PATH * 2 ) + 2, L"%.259s\\%.259s", path, filename );
+	wmemcpy( hb->names[ hb->count ], filename, MAX_PATH );
+	hb->positions[ hb->count ] = position;
+	hb->is_folder[ hb->count ] = is_folder;
+	hb->report[ hb->count ] = report;
+	++hb->count;
+}
+
+unsigned long hash_extension( wchar_t *extension, unsigned long length )
+{
+	unsigned long hash = 0;
+
+	for ( unsigned long i = 0; i < length; ++i )
+	{
+		hash = ( hash * 31 ) + extension[ i ];
+	}
+
+	return hash;
+}
+
+// The filter is a list of extensions that are each surrounded by '|'. It's already lowercase.
+void compile_extension_filter( extension_filter *ef, wchar_t *filter )
+{
+	memset( ef, 0, sizeof( extension_filter ) );
+
+	wchar_t *start = wcschr( filter, L'|' );
+	if ( start == NULL )
+	{
+		return;
+	}
+
+	ef->enabled = true;
+
+	wcscpy_s( ef->extensions, MAX_PATH + 2, start + 1 );
+
+	wchar_t *extension = ef->extensions;
+	wchar_t *end = NULL;
+	while ( ( end = wcschr( extension, L'|' ) ) != NULL )
+	{
+		*end = L'\0';
+
+		unsigned long length = ( unsigned long )( end - extension );
+		unsigned long slot = hash_extension( extension, length ) & ( EXTENSION_FILTER_SLOTS - 1 );
+
+		// Skip any duplicate extensions.
+		while ( ef->slots[ slot ].extension != NULL &&
+			  ( ef->slots[ slot ].length != length || wmemcmp( ef->slots[ slot ].extension, extension, length ) != 0 ) )
+		{
+			slot = ( slot + 1 ) & ( EXTENSION_FILTER_SLOTS - 1 );
+		}
+
+		ef->slots[ slot ].extension = extension;
+		ef->slots[ slot ].length = length;
+
+		if ( length > ef->longest )
+		{
+			ef->longest = length;
+		}
+
+		extension = end + 1;
+	}
+}
+
+// Returns true if there's a filter and the file's extension isn't in it.
+bool is_filtered( extension_filter *ef, wchar_t *filename )
+{
+	if ( ef->enabled == false )
+	{
+		return false;
+	}
+
+	wchar_t *ext = get_extension_from_filename( filename, wcslen( filename ) );
+
+	// Lowercase the extension for the comparison. It can't be in the filter if it's longer than every extension in it.
+	wchar_t lower_ext[ MAX_PATH + 2 ];
+	unsigned long ext_length = 0;
+	for ( ; ext[ ext_length ] != L'\0'; ++ext_length )
+	{
+		if ( ext_length == ef->longest )
+		{
+			return true;
+		}
+
+		lower_ext[ ext_length ] = towlower( ext[ ext_length ] );
+	}
+
+	unsigned long slot = hash_extension( lower_ext, ext_length ) & ( EXTENSION_FILTER_SLOTS - 1 );
+	while ( ef->slots[ slot ].extension != NULL )
+	{
+		if ( ef->slots[ slot ].length == ext_length && wmemcmp( ef->slots[ slot ].extension, lower_ext, ext_length ) == 0 )
+		{
+			return false;
+		}
+
+		slot = ( slot + 1 ) & ( EXTENSION_FILTER_SLOTS - 1 );
+	}
+
+	return true;
+}
+
+// Queues a subdirectory to be enumerated. order holds the subdirectory's position.
+void queue_directory( scan_queue *sq, scan_deque *deque, wchar_t *path, int path_length, unsigned long *order, unsigned long depth )
+{
+	scan_directory *child = ( scan_directory * )malloc( sizeof( scan_directory ) );
+	child->path = ( wchar_t * )malloc( sizeof( wchar_t ) * ( path_length + 1 ) );
+	wmemcpy( child->path, path, path_length + 1 );
+	child->depth = depth;
+	child->order = ( unsigned long * )malloc( sizeof( unsigned long ) * child->depth );
+	memcpy( child->order, order, sizeof( unsigned long ) * child->depth );
+
+	InterlockedIncrement( &sq->pending );
+	push_directory( deque, child );
+}
+
+// Goes through the directory's contents from the previous scan. Its files were already hashed.
+void replay_directory( scan_queue *sq, scan_deque *deque, scan_index_directory *sid, scan_directory *sd, unsigned long *order )
+{
+	wchar_t filepath[ ( MAX_PATH * 2 ) + 2 ];
+	wchar_t name[ MAX_PATH ];
+
+	for ( unsigned long i = 0; i < sid->entry_count; ++i )
+	{
+		if ( g_kill_scan == true )
+		{
+			break;
+		}
+
+		scan_index_entry *sie = &sid->entries[ i ];
+
+		wmemcpy( name, sid->names + sie->name_offset, sie->name_length );
+		name[ sie->name_length ] = L'\0';
+
+		order[ sd->depth ] = i;
+
+		int filepath_length = swprintf_s( filepath, ( MAX_PATH * 2 ) + 2, L"%.259s\\%.259s", sd->path, name );
+
+		if ( ( sie->flags & SCAN_ENTRY_FOLDER ) != 0 )
+		{
+			if ( filepath_length < MAX_PATH )
+			{
+				queue_directory( sq, deque, filepath, filepath_length, order, sd->depth + 1 );
+
+				// Only hash folders if enabled.
+				if ( g_include_folders == true )
+				{
+					update_scan_info( sq, sie->hash, filepath, order, sd->depth + 2 );
+				}
+			}
+		}
+		else if ( is_filtered( &sq->filter, name ) == false )
+		{
+			update_scan_info( sq, sie->hash, filepath, order, sd->depth + 1 );
+		}
+	}
+}
+
+// Hashes the files of the directory and queues its subdirectories on the worker's deque.
+void traverse_directory( scan_queue *sq, scan_deque *deque, hash_batch *hb, scan_directory *sd )
 {
 	// We don't want to continue scanning if the user cancels the scan.
 	if ( g_kill_scan == true )
@@ -96,16 +587,54 @@ void traverse_directory( wchar_t *path )
 
 	// Set the file path to search for all files/folders in the current directory.
 	wchar_t filepath[ ( MAX_PATH * 2 ) + 2 ];
-	swprintf_s( filepath, ( MAX_PATH * 2 ) + 2, L"%.259s\\*", path );
+	swprintf_s( filepath, ( MAX_PATH * 2 ) + 2, L"%.259s\\*", sd->path );
+
+	// The order of each file is the directory's order followed by the file's position.
+	// A folder is hashed after everything in it, so its order has one more position that comes after theirs.
+	unsigned long *order = ( unsigned long * )malloc( sizeof( unsigned long ) * ( sd->depth + 2 ) );
+	if ( sd->depth > 0 )
+	{
+		memcpy( order, sd->order, sizeof( unsigned long ) * sd->depth );
+	}
+	order[ sd->depth + 1 ] = 0xFFFFFFFF;
+
+	hb->sid = NULL;
+
+	if ( sq->si.index_path != NULL )
+	{
+		// Nothing has been added, removed, or renamed in the directory if it hasn't been written to since the previous scan.
+		unsigned long long last_write_time = get_directory_time( sd->path );
+
+		scan_index_directory *sid = find_scan_directory( &sq->si, sd->path, last_write_time );
+		if ( sid != NULL )
+		{
+			replay_directory( sq, deque, sid, sd, order );
+
+			add_scan_directory( &sq->si, sid );
+
+			free( order );
+
+			return;
+		}
+
+		hb->sid = create_scan_directory( sd->path, last_write_time );
+	}
+
+	// Positions only count the files that could be scanned, so they're the same whether or not the directory is enumerated.
+	unsigned long position = 0;
+	bool enumerated = false;
 
 	WIN32_FIND_DATA FindFileData;
 	HANDLE hFind = FindFirstFileEx( ( LPCWSTR )filepath, FindExInfoStandard, &FindFileData, FindExSearchNameMatch, NULL, 0 );
 	if ( hFind != INVALID_HANDLE_VALUE ) 
 	{
+		enumerated = true;
+
 		do
 		{
 			if ( g_kill_scan == true )
 			{
+				enumerated = false;
 				break;	// We need to close the find file handle.
 			}
 
@@ -116,53 +645,386 @@ void traverse_directory( wchar_t *path )
 				if ( ( wcscmp( FindFileData.cFileName, L"." ) != 0 ) && ( wcscmp( FindFileData.cFileName, L".." ) != 0 ) )
 				{
 					// Move to the next directory. Limit the path length to MAX_PATH.
-					if ( swprintf_s( filepath, ( MAX_PATH * 2 ) + 2, L"%.259s\\%.259s", path, FindFileData.cFileName ) < MAX_PATH )
+					int filepath_length = swprintf_s( filepath, ( MAX_PATH * 2 ) + 2, L"%.259s\\%.259s", sd->path, FindFileData.cFileName );
+					if ( filepath_length < MAX_PATH )
 					{
-						traverse_directory( filepath );
+						order[ sd->depth ] = ( hb->sid != NULL ? add_scan_entry( hb->sid, FindFileData.cFileName, SCAN_ENTRY_FOLDER ) : position );
+						++position;
+
+						queue_directory( sq, deque, filepath, filepath_length, order, sd->depth + 1 );
 
-						// Only hash folders if enabled.
-						if ( g_include_folders == true )
+						// Only hash folders if enabled. They're always hashed for the scan index.
+						if ( g_include_folders == true || hb->sid != NULL )
 						{
-							hash_file( filepath, FindFileData.cFileName );
+							add_hash_batch( sq, hb, sd->path, FindFileData.cFileName, order, sd->depth, order[ sd->depth ], true, g_include_folders );
 						}
 					}
 				}
 			}
 			else
 			{
-				// See if the file's extension is in our filter. Go to the next file if it's not.
-				wchar_t *ext = get_extension_from_filename( FindFileData.cFileName, wcslen( FindFileData.cFileName ) );
-				if ( g_extension_filter[ 0 ] != 0 )
+				// See if the file's extension is in our filter. It's still hashed for the scan index since the filter can change.
+				bool filtered = is_filtered( &sq->filter, FindFileData.cFileName );
+				if ( filtered == true && hb->sid == NULL )
+				{
+					continue;
+				}
+
+				order[ sd->depth ] = ( hb->sid != NULL ? add_scan_entry( hb->sid, FindFileData.cFileName, 0 ) : position );
+				++position;
+
+				add_hash_batch( sq, hb, sd->path, FindFileData.cFileName, order, sd->depth, order[ sd->depth ], false, !filtered );
+			}
+		}
+		while ( FindNextFile( hFind, &FindFileData ) != 0 );	// Go to the next file.
+
+		FindClose( hFind );	// Close the find file handle.
+	}
+
+	flush_hash_batch( sq, hb, order, sd->depth );
+
+	// A directory that couldn't be completely enumerated can't be reused.
+	if ( hb->sid != NULL )
+	{
+		if ( enumerated == true )
+		{
+			add_scan_directory( &sq->si, hb->sid );
+		}
+		else
+		{
+			free_scan_index_directory( hb->sid );
+		}
+
+		hb->sid = NULL;
+	}
+
+	free( order );
+}
+
+// Enumerates directories until every directory has been enumerated, or the scan is cancelled.
+void scan_directories( scan_queue *sq )
+{
+	unsigned long index = ( unsigned long )InterlockedIncrement( &sq->next_worker ) - 1;
+	scan_deque *deque = &sq->deques[ index ];
+
+	// Each worker has its own batch and cache of names.
+	hash_batch *hb = ( hash_batch * )malloc( sizeof( hash_batch ) );
+	hb->count = 0;
+	hb->sid = NULL;
+	memset( hb->cache, 0, sizeof( hb->cache ) );
+
+	while ( sq->pending > 0 && g_kill_scan == false )
+	{
+		scan_directory *sd = take_directory( deque, false );
+
+		// Steal from the other workers if our deque is empty.
+		for ( unsigned long i = 1; sd == NULL && i < sq->deque_count; ++i )
+		{
+			sd = take_directory( &sq->deques[ ( index + i ) % sq->deque_count ], true );
+		}
+
+		if ( sd == NULL )
+		{
+			// The workers that are still enumerating may queue more directories.
+			Sleep( 1 );
+			continue;
+		}
+
+		traverse_directory( sq, deque, hb, sd );
+
+		free_scan_directory( sd );
+
+		InterlockedDecrement( &sq->pending );
+	}
+
+	free( hb );
+}
+
+unsigned __stdcall scan_worker( void *pArguments )
+{
+	scan_directories( ( scan_queue * )pArguments );
+
+	_endthreadex( 0 );
+	return 0;
+}
+
+// Enumerating directories mostly waits on the file system, so there are more workers than processors.
+// The file that matches an entry last in depth-first order names it, just as if the directories were walked one at a time.
+// A tree that's only part of a previous scan shouldn't have an index of its own, so use_index is false for it.
+void scan_tree( wchar_t *path, bool use_index )
+{
+	unsigned long thread_count = get_processor_count() * SCAN_THREADS_PER_PROCESSOR;
+	if ( thread_count > MAX_SCAN_THREADS )
+	{
+		thread_count = MAX_SCAN_THREADS;
+	}
+
+	scan_queue sq;
+	sq.deque_count = thread_count;
+	sq.deques = ( scan_deque * )malloc( sizeof( scan_deque ) * sq.deque_count );
+	memset( sq.deques, 0, sizeof( scan_deque ) * sq.deque_count );
+	for ( unsigned long i = 0; i < sq.deque_count; ++i )
+	{
+		InitializeCriticalSection( &sq.deques[ i ].lock );
+	}
+	sq.pending = 1;
+	sq.next_worker = 0;
+	compile_extension_filter( &sq.filter, g_extension_filter );
+	InitializeCriticalSection( &sq.lock );
+
+	open_scan_index( &sq.si, path, use_index );
+
+	// The root is the only directory that has no position.
+	scan_directory *root = ( scan_directory * )malloc( sizeof( scan_directory ) );
+	root->path = _wcsdup( path );
+	root->order = NULL;
+	root->depth = 0;
+	push_directory( &sq.deques[ 0 ], root );
+
+	// This thread is the first worker.
+	HANDLE *threads = ( HANDLE * )malloc( sizeof( HANDLE ) * thread_count );
+	unsigned long threads_created = 0;
+	for ( unsigned long i = 1; i < thread_count; ++i )
+	{
+		threads[ threads_created ] = ( HANDLE )_beginthreadex( NULL, 0, &scan_worker, ( void * )&sq, 0, NULL );
+		if ( threads[ threads_created ] != NULL )
+		{
+			++threads_created;
+		}
+	}
+
+	scan_directories( &sq );
+
+	for ( unsigned long i = 0; i < threads_created; ++i )
+	{
+		WaitForSingleObject( threads[ i ], INFINITE );
+		CloseHandle( threads[ i ] );
+	}
+	free( threads );
+
+	// Free the directories that were left when the scan was cancelled.
+	for ( unsigned long i = 0; i < sq.deque_count; ++i )
+	{
+		scan_directory *sd = NULL;
+		while ( ( sd = take_directory( &sq.deques[ i ], false ) ) != NULL )
+		{
+			free_scan_directory( sd );
+		}
+
+		free( sq.deques[ i ].directories );
+		DeleteCriticalSection( &sq.deques[ i ].lock );
+	}
+	free( sq.deques );
+
+	save_scan_index( &sq.si, g_kill_scan );
+	close_scan_index( &sq.si );
+
+	// Replace the hash filenames with the local filenames.
+	typed_dllrbt< unsigned long, scan_match * >::node *node = sq.matches.get_head();
+	while ( node != NULL )
+	{
+		scan_match *sm = node->val;
+
+		if ( is_entry_row( &g_entry_table, node->key ) )
+		{
+			set_entry_name( &g_entry_table, node->key, sm->filepath );
+
+			// It's been mapped, so later scans and watches leave it alone.
+			remove_entry_hash( node->key );
+		}
+		else
+		{
+			free( sm->filepath );
+		}
+
+		free( sm->order );
+		free( sm );
+
+		node = node->next;
+	}
+	sq.matches.clear();
+
+	DeleteCriticalSection( &sq.lock );
+}
+
+// A file that's added or renamed while watching is the newest file with its name, so it names every entry that it matches.
+void map_file( wchar_t *filepath, wchar_t *filename )
+{
+	// Initial hash value. This value was found in thumbcache.dll.
+	unsigned long long hash = hash_data( ( char * )filename, 0x295BA83CF71232D9, wcslen( filename ) * sizeof( wchar_t ) );
+
+	if ( check_bloom_filter( &entry_bloom_filter, hash ) == true )
+	{
+		// Each row that's mapped is taken out of the table, so the first row is always the next one.
+		unsigned long position = 0;
+		unsigned long row = 0;
+		while ( ( row = find_hash_row( &entry_hash_table, hash, &position ) ) != 0 )
+		{
+			remove_entry_hash( row );
+
+			if ( is_entry_row( &g_entry_table, row ) )
+			{
+				++match_count;
+
+				set_entry_name( &g_entry_table, row, _wcsdup( filepath ) );
+			}
+		}
+	}
+
+	LONG count = InterlockedIncrement( &file_count );
+
+	// Update our scan window with new scan information.
+	if ( g_show_details == true )
+	{
+		SendMessage( g_hWnd_scan, WM_PROPAGATE, 3, ( LPARAM )filepath );
+		char buf[ 17 ] = { 0 };
+		sprintf_s( buf, 17, "%016llx", hash );
+		SendMessageA( g_hWnd_scan, WM_PROPAGATE, 4, ( LPARAM )buf );
+		sprintf_s( buf, 17, "%lu", count );
+		SendMessageA( g_hWnd_scan, WM_PROPAGATE, 5, ( LPARAM )buf );
+	}
+}
+
+// Maps a file or folder that was added or renamed in the watched tree. name is relative to the tree's root and isn't NULL terminated.
+void map_change( wchar_t *root, wchar_t *name, unsigned long name_length, extension_filter *filter )
+{
+	if ( name_length == 0 || name_length >= MAX_PATH )
+	{
+		return;
+	}
+
+	wchar_t filepath[ ( MAX_PATH * 2 ) + 2 ];
+	int filepath_length = swprintf_s( filepath, ( MAX_PATH * 2 ) + 2, L"%.259s\\%.*s", root, ( int )name_length, name );
+	if ( filepath_length < 0 )
+	{
+		return;
+	}
+
+	wchar_t *filename = wcsrchr( filepath, L'\\' ) + 1;
+
+	// It may have been removed, or renamed again, since it was reported.
+	DWORD attributes = GetFileAttributes( filepath );
+	if ( attributes == INVALID_FILE_ATTRIBUTES )
+	{
+		return;
+	}
+
+	if ( ( attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 )
+	{
+		// Limit the path length to MAX_PATH, just like the scan.
+		if ( filepath_length < MAX_PATH )
+		{
+			// Nothing is reported for the files and folders that were moved in with the folder.
+			scan_tree( filepath, false );
+
+			// Only hash folders if enabled.
+			if ( g_include_folders == true )
+			{
+				map_file( filepath, filename );
+			}
+		}
+	}
+	else if ( is_filtered( filter, filename ) == false )
+	{
+		map_file( filepath, filename );
+	}
+}
+
+// Waits for files and folders to be added or renamed in the tree, and maps only them.
+// The entries are locked while the changes are mapped. Other threads can run in between.
+void watch_tree( wchar_t *path )
+{
+	HANDLE hDirectory = CreateFile( path, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL );
+	if ( hDirectory == INVALID_HANDLE_VALUE )
+	{
+		return;
+	}
+
+	extension_filter *filter = ( extension_filter * )malloc( sizeof( extension_filter ) );
+	compile_extension_filter( filter, g_extension_filter );
+
+	// The changes are DWORD aligned.
+	DWORD *changes = ( DWORD * )malloc( WATCH_BUFFER_SIZE );
+
+	OVERLAPPED overlapped = { 0 };
+	overlapped.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+	while ( g_kill_scan == false && g_kill_thread == false )
+	{
+		// Changes that happen while we're mapping are held until the next call.
+		ResetEvent( overlapped.hEvent );
+		if ( ReadDirectoryChangesW( hDirectory, changes, WATCH_BUFFER_SIZE, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME, NULL, &overlapped, NULL ) == 0 )
+		{
+			break;
+		}
+
+		DWORD wait = WAIT_TIMEOUT;
+		while ( wait == WAIT_TIMEOUT && g_kill_scan == false && g_kill_thread == false )
+		{
+			wait = WaitForSingleObject( overlapped.hEvent, WATCH_INTERVAL );
+		}
+
+		DWORD size = 0;
+		if ( wait != WAIT_OBJECT_0 )
+		{
+			// Wait for the cancelled call to finish before its buffer is freed.
+			CancelIo( hDirectory );
+			GetOverlappedResult( hDirectory, &overlapped, &size, TRUE );
+			break;
+		}
+
+		// The root was removed, or the share was disconnected.
+		if ( GetOverlappedResult( hDirectory, &overlapped, &size, FALSE ) == 0 )
+		{
+			break;
+		}
+
+		// This will block every other thread from entering until the changes are mapped.
+		EnterCriticalSection( &pe_cs );
+
+		if ( g_kill_thread == false )
+		{
+			in_thread = true;
+
+			if ( size == 0 )
+			{
+				// More changes happened than could fit in the buffer, so we don't know what they were.
+				// The scan index lets the directories that didn't change be skipped.
+				scan_tree( path, true );
+			}
+			else
+			{
+				FILE_NOTIFY_INFORMATION *fni = ( FILE_NOTIFY_INFORMATION * )changes;
+				while ( g_kill_scan == false )
 				{
-					// Do a case-insensitive substring search for the extension.
-					int ext_length = wcslen( ext );
-					wchar_t *temp_ext = ( wchar_t * )malloc( sizeof( wchar_t ) * ( ext_length + 3 ) );
-					for ( int i = 0; i < ext_length; ++i )
+					if ( fni->Action == FILE_ACTION_ADDED || fni->Action == FILE_ACTION_RENAMED_NEW_NAME )
 					{
-						temp_ext[ i + 1 ] = towlower( ext[ i ] );
+						map_change( path, fni->FileName, fni->FileNameLength / sizeof( wchar_t ), filter );
 					}
-					temp_ext[ 0 ] = L'|';				// Append the delimiter to the beginning of the string.
-					temp_ext[ ext_length + 1 ] = L'|';	// Append the delimiter to the end of the string.
-					temp_ext[ ext_length + 2 ] = L'\0';
 
-					if ( wcsstr( g_extension_filter, temp_ext ) == NULL )
+					if ( fni->NextEntryOffset == 0 )
 					{
-						free( temp_ext );
-						continue;
+						break;
 					}
 
-					free( temp_ext );
+					fni = ( FILE_NOTIFY_INFORMATION * )( ( char * )fni + fni->NextEntryOffset );
 				}
+			}
 
-				swprintf_s( filepath, ( MAX_PATH * 2 ) + 2, L"%.259s\\%.259s", path, FindFileData.cFileName );
+			InvalidateRect( g_hWnd_list, NULL, TRUE );
 
-				hash_file( filepath, FindFileData.cFileName );
-			}
+			in_thread = false;
 		}
-		while ( FindNextFile( hFind, &FindFileData ) != 0 );	// Go to the next file.
 
-		FindClose( hFind );	// Close the find file handle.
+		// Let other threads continue.
+		LeaveCriticalSection( &pe_cs );
 	}
+
+	CloseHandle( overlapped.hEvent );
+	CloseHandle( hDirectory );
+
+	free( changes );
+	free( filter );
 }
 
 unsigned __stdcall map_entries( void *pArguments )
@@ -176,17 +1038,36 @@ unsigned __stdcall map_entries( void *pArguments )
 	// Disable scan button, enable cancel button.
 	SendMessage( g_hWnd_scan, WM_PROPAGATE, 1, 0 );
 
-	create_fileinfo_tree();
-
 	file_count = 0;		// Reset the file count.
 	match_count = 0;	// Reset the match count.
 
-	traverse_directory( g_filepath );
-
-	cleanup_fileinfo_tree();
+	scan_tree( g_filepath, true );
 
 	InvalidateRect( g_hWnd_list, NULL, TRUE );
 
+	if ( g_watch_changes == true && g_kill_scan == false )
+	{
+		g_watching = true;
+
+		SendMessage( g_hWnd_scan, WM_CHANGE_CURSOR, FALSE, 0 );	// Reset the cursor.
+		SetWindowTextA( g_hWnd_scan, "Map File Paths to Entry Hashes - Watching for changes..." );	// Update the window title.
+
+		// The entries can be used by other threads while we're waiting for changes.
+		LeaveCriticalSection( &pe_cs );
+
+		watch_tree( g_filepath );
+
+		// Release the semaphore if we're killing the thread. The entries aren't used after the watch has stopped.
+		if ( shutdown_semaphore != NULL )
+		{
+			ReleaseSemaphore( shutdown_semaphore, 1, NULL );
+		}
+
+		EnterCriticalSection( &pe_cs );
+
+		g_watching = false;
+	}
+
 	// Update the details.
 	if ( g_show_details == false )
 	{
@@ -19,6 +19,19 @@
 #ifndef MAP_ENTRIES_H
 #define MAP_ENTRIES_H
 
+#define SCAN_THREADS_PER_PROCESSOR	4	// Directory enumeration mostly waits on the file system.
+#define MAX_SCAN_THREADS			64
+
+#define HASH_LANES			4		// Number of names that are hashed together.
+#define HASH_BATCH_SIZE		64		// Number of files that are collected from a directory before they're hashed.
+#define NAME_CACHE_SIZE		1024	// Number of names that each worker remembers. Must be a power of 2.
+#define NAME_CACHE_LENGTH	32		// Longest name that can be remembered.
+
+#define EXTENSION_FILTER_SLOTS	256	// Must be a power of 2 and more than the number of extensions that fit in the filter.
+
+#define WATCH_BUFFER_SIZE	65536	// Size of the buffer that receives changes. Network shares can't return more than 64 KB.
+#define WATCH_INTERVAL		250		// Milliseconds between checks for a stopped watch.
+
 unsigned __stdcall map_entries( void *pArguments );
 
 extern wchar_t g_filepath[];			// Path to the files and folders to scan.
@@ -26,5 +39,7 @@ extern wchar_t g_extension_filter[];	// A list of extensions to filter from a fi
 
 extern bool g_include_folders;			// Include folders in a file scan.
 extern bool g_show_details;				// Show details in the scan window.
+extern bool g_watch_changes;			// Keep mapping the files that are added or renamed after a file scan.
+extern bool g_watching;					// The file scan is done and we're watching for changes.
 
 #endif
@@ -284,7 +284,7 @@ rbt_status rbt_insert( rbt_tree *tree, void *key, void *val )
 	return RBT_STATUS_OK;
 }
 
-void delete_fixup( tag_type *rbt, node_type *x )
+static void delete_fixup( tag_type *rbt, node_type *x )
 {
 	// Maintain red-black tree balance after deleting node x
 	while ( x != rbt->root && x->color == BLACK )
@@ -0,0 +1,484 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "globals.h"
+#include "scan_index.h"
+#include "file_map.h"
+#include "crc64.h"
+
+// The index is a header followed by each directory and its entries. Nothing in it is aligned.
+//
+// Header:    "TVSI", version (4 bytes), root length (2 bytes), root (UTF-16), directory count (4 bytes)
+// Directory: path length (2 bytes), path (UTF-16), last write time (8 bytes), entry count (4 bytes)
+// Entry:     flags (1 byte), name length (2 bytes), hash (8 bytes), name (UTF-16)
+
+struct index_writer
+{
+	HANDLE hFile;
+	char *buf;
+	unsigned long length;
+	unsigned long size;
+	bool failed;
+};
+
+void free_scan_index_directory( scan_index_directory *sid )
+{
+	free( sid->path );
+	free( sid->entries );
+	free( sid->names );
+	free( sid );
+}
+
+scan_index_directory *create_scan_directory( wchar_t *path, unsigned long long last_write_time )
+{
+	scan_index_directory *sid = ( scan_index_directory * )malloc( sizeof( scan_index_directory ) );
+	memset( sid, 0, sizeof( scan_index_directory ) );
+	sid->path = _wcsdup( path );
+	sid->last_write_time = last_write_time;
+
+	return sid;
+}
+
+// Returns the entry's position in the directory. Its hash is set once the name has been hashed.
+unsigned long add_scan_entry( scan_index_directory *sid, wchar_t *name, unsigned char flags )
+{
+	unsigned long name_length = wcslen( name );
+
+	if ( sid->entry_count == sid->entries_size )
+	{
+		sid->entries_size = ( sid->entries_size == 0 ? 16 : sid->entries_size * 2 );
+		sid->entries = ( scan_index_entry * )realloc( sid->entries, sizeof( scan_index_entry ) * sid->entries_size );
+	}
+
+	if ( sid->names_length + name_length > sid->names_size )
+	{
+		while ( sid->names_length + name_length > sid->names_size )
+		{
+			sid->names_size = ( sid->names_size == 0 ? 256 : sid->names_size * 2 );
+		}
+		sid->names = ( wchar_t * )realloc( sid->names, sizeof( wchar_t ) * sid->names_size );
+	}
+
+	scan_index_entry *sie = &sid->entries[ sid->entry_count ];
+	sie->hash = 0;
+	sie->name_offset = sid->names_length;
+	sie->name_length = ( unsigned short )name_length;
+	sie->flags = flags;
+
+	wmemcpy( sid->names + sid->names_length, name, name_length );
+	sid->names_length += name_length;
+
+	return sid->entry_count++;
+}
+
+// Directories are added once they've been completely enumerated, or reused.
+void add_scan_directory( scan_index *si, scan_index_directory *sid )
+{
+	EnterCriticalSection( &si->lock );
+
+	sid->updated = true;
+	sid->next = si->updated;
+	si->updated = sid;
+	++si->updated_count;
+
+	LeaveCriticalSection( &si->lock );
+}
+
+// Returns the directory from the previous scan if it hasn't been written to since then.
+// Every worker can search the directories since they're not changed until the scan is done.
+scan_index_directory *find_scan_directory( scan_index *si, wchar_t *path, unsigned long long last_write_time )
+{
+	scan_index_directory *sid = si->directories.find_value( path, NULL );
+	if ( sid == NULL )
+	{
+		return NULL;
+	}
+
+	// The directory was reached. It's either reused or replaced by its new contents.
+	sid->visited = true;
+
+	return ( last_write_time != 0 && sid->last_write_time == last_write_time ? sid : NULL );
+}
+
+// Returns 0 if the directory's time can't be trusted.
+unsigned long long get_directory_time( wchar_t *path )
+{
+	// The root of a drive needs its trailing backslash. Without it, the drive's current directory is used.
+	wchar_t drive_path[ 4 ];
+	if ( path[ 0 ] != L'\0' && path[ 1 ] == L':' && path[ 2 ] == L'\0' )
+	{
+		swprintf_s( drive_path, 4, L"%c:\\", path[ 0 ] );
+		path = drive_path;
+	}
+
+	WIN32_FILE_ATTRIBUTE_DATA wfad;
+	if ( GetFileAttributesEx( path, GetFileExInfoStandard, &wfad ) == 0 )
+	{
+		return 0;
+	}
+
+	unsigned long long last_write_time = ( ( unsigned long long )wfad.ftLastWriteTime.dwHighDateTime << 32 ) | wfad.ftLastWriteTime.dwLowDateTime;
+
+	FILETIME ft;
+	GetSystemTimeAsFileTime( &ft );
+	unsigned long long now = ( ( unsigned long long )ft.dwHighDateTime << 32 ) | ft.dwLowDateTime;
+
+	if ( last_write_time + SCAN_INDEX_SETTLE_TIME > now )
+	{
+		return 0;
+	}
+
+	return last_write_time;
+}
+
+bool read_index( unsigned char **data, unsigned char *end, void *value, unsigned long size )
+{
+	if ( ( unsigned long )( end - *data ) < size )
+	{
+		return false;
+	}
+
+	memcpy( value, *data, size );
+	*data += size;
+
+	return true;
+}
+
+// Reads every directory of the previous scan. Anything after a malformed directory is ignored.
+void load_scan_index( scan_index *si )
+{
+	file_map fm;
+	if ( map_file( &fm, si->index_path ) == false )
+	{
+		return;
+	}
+
+	unsigned char *data = fm.base;
+	unsigned char *end = fm.base + fm.size;
+
+	char magic[ 4 ];
+	unsigned long version = 0;
+	unsigned short root_length = 0;
+	unsigned long directory_count = 0;
+
+	wchar_t path[ MAX_PATH ];
+
+	if ( read_index( &data, end, magic, 4 ) == false || memcmp( magic, "TVSI", 4 ) != 0 ||
+		 read_index( &data, end, &version, sizeof( unsigned long ) ) == false || version != SCAN_INDEX_VERSION ||
+		 read_index( &data, end, &root_length, sizeof( unsigned short ) ) == false || root_length >= MAX_PATH ||
+		 read_index( &data, end, path, sizeof( wchar_t ) * root_length ) == false ||
+		 read_index( &data, end, &directory_count, sizeof( unsigned long ) ) == false )
+	{
+		unmap_file( &fm );
+		return;
+	}
+
+	// Another root has the same index name.
+	path[ root_length ] = L'\0';
+	if ( _wcsicmp( path, si->root ) != 0 )
+	{
+		unmap_file( &fm );
+		return;
+	}
+
+	for ( unsigned long i = 0; i < directory_count; ++i )
+	{
+		unsigned short path_length = 0;
+		unsigned long long last_write_time = 0;
+		unsigned long entry_count = 0;
+
+		if ( read_index( &data, end, &path_length, sizeof( unsigned short ) ) == false || path_length >= MAX_PATH ||
+			 read_index( &data, end, path, sizeof( wchar_t ) * path_length ) == false ||
+			 read_index( &data, end, &last_write_time, sizeof( unsigned long long ) ) == false ||
+			 read_index( &data, end, &entry_count, sizeof( unsigned long ) ) == false )
+		{
+			break;
+		}
+
+		path[ path_length ] = L'\0';
+
+		scan_index_directory *sid = create_scan_directory( path, last_write_time );
+
+		unsigned long j = 0;
+		for ( ; j < entry_count; ++j )
+		{
+			unsigned char flags = 0;
+			unsigned short name_length = 0;
+			unsigned long long hash = 0;
+			wchar_t name[ MAX_PATH ];
+
+			if ( read_index( &data, end, &flags, sizeof( unsigned char ) ) == false ||
+				 read_index( &data, end, &name_length, sizeof( unsigned short ) ) == false || name_length == 0 || name_length >= MAX_PATH ||
+				 read_index( &data, end, &hash, sizeof( unsigned long long ) ) == false ||
+				 read_index( &data, end, name, sizeof( wchar_t ) * name_length ) == false )
+			{
+				break;
+			}
+
+			name[ name_length ] = L'\0';
+
+			unsigned long position = add_scan_entry( sid, name, flags );
+			sid->entries[ position ].hash = hash;
+		}
+
+		if ( j < entry_count || si->directories.insert( sid->path, sid ) == false )
+		{
+			free_scan_index_directory( sid );
+
+			if ( j < entry_count )
+			{
+				break;
+			}
+		}
+	}
+
+	unmap_file( &fm );
+}
+
+// Each root has its own index in the local application data folder. Its name comes from the lowercase root.
+wchar_t *get_scan_index_path( wchar_t *root )
+{
+	wchar_t app_data[ MAX_PATH ];
+	if ( SHGetFolderPath( NULL, CSIDL_LOCAL_APPDATA, NULL, 0, app_data ) != S_OK )
+	{
+		return NULL;
+	}
+
+	wchar_t *index_path = ( wchar_t * )malloc( sizeof( wchar_t ) * MAX_PATH );
+	swprintf_s( index_path, MAX_PATH, L"%s\\thumbs_viewer", app_data );
+	CreateDirectory( index_path, NULL );
+
+	int root_length = wcslen( root );
+	wchar_t *lower_root = _wcsdup( root );
+	_wcslwr_s( lower_root, root_length + 1 );
+	unsigned long long id = crc64( ( char * )lower_root, sizeof( wchar_t ) * root_length, 0xFFFFFFFFFFFFFFFFULL );
+	free( lower_root );
+
+	if ( swprintf_s( index_path, MAX_PATH, L"%s\\thumbs_viewer\\scan_%016llx.idx", app_data, id ) < 0 )
+	{
+		free( index_path );
+		return NULL;
+	}
+
+	return index_path;
+}
+
+// The index is only loaded, and later saved, if load is true.
+void open_scan_index( scan_index *si, wchar_t *root, bool load )
+{
+	si->root = _wcsdup( root );
+	si->index_path = NULL;
+	si->updated = NULL;
+	si->updated_count = 0;
+	InitializeCriticalSection( &si->lock );
+
+	if ( load == false )
+	{
+		return;
+	}
+
+	// Only NTFS and ReFS update a directory's last write time whenever something in it is added, removed, or renamed.
+	wchar_t volume_path[ MAX_PATH ];
+	wchar_t file_system[ MAX_PATH ];
+	if ( GetVolumePathName( root, volume_path, MAX_PATH ) == 0 ||
+		 GetVolumeInformation( volume_path, NULL, 0, NULL, NULL, NULL, file_system, MAX_PATH ) == 0 ||
+		 ( _wcsicmp( file_system, L"NTFS" ) != 0 && _wcsicmp( file_system, L"ReFS" ) != 0 ) )
+	{
+		return;
+	}
+
+	si->index_path = get_scan_index_path( root );
+	if ( si->index_path == NULL )
+	{
+		return;
+	}
+
+	load_scan_index( si );
+}
+
+void write_index( index_writer *iw, const void *data, unsigned long size )
+{
+	DWORD write = 0;
+
+	if ( iw->failed == true )
+	{
+		return;
+	}
+
+	if ( iw->length + size > iw->size )
+	{
+		if ( WriteFile( iw->hFile, iw->buf, iw->length, &write, NULL ) == FALSE || write != iw->length )
+		{
+			iw->failed = true;
+			return;
+		}
+
+		iw->length = 0;
+	}
+
+	if ( size > iw->size )
+	{
+		if ( WriteFile( iw->hFile, data, size, &write, NULL ) == FALSE || write != size )
+		{
+			iw->failed = true;
+		}
+
+		return;
+	}
+
+	memcpy( iw->buf + iw->length, data, size );
+	iw->length += size;
+}
+
+void write_scan_directory( index_writer *iw, scan_index_directory *sid )
+{
+	unsigned short path_length = ( unsigned short )wcslen( sid->path );
+
+	write_index( iw, &path_length, sizeof( unsigned short ) );
+	write_index( iw, sid->path, sizeof( wchar_t ) * path_length );
+	write_index( iw, &sid->last_write_time, sizeof( unsigned long long ) );
+	write_index( iw, &sid->entry_count, sizeof( unsigned long ) );
+
+	for ( unsigned long i = 0; i < sid->entry_count; ++i )
+	{
+		scan_index_entry *sie = &sid->entries[ i ];
+
+		write_index( iw, &sie->flags, sizeof( unsigned char ) );
+		write_index( iw, &sie->name_length, sizeof( unsigned short ) );
+		write_index( iw, &sie->hash, sizeof( unsigned long long ) );
+		write_index( iw, sid->names + sie->name_offset, sizeof( wchar_t ) * sie->name_length );
+	}
+}
+
+// Directories that can't be reused aren't saved.
+// If the scan was cancelled, the directories that weren't reached are kept for the next scan.
+void save_scan_index( scan_index *si, bool cancelled )
+{
+	if ( si->index_path == NULL )
+	{
+		return;
+	}
+
+	unsigned long directory_count = 0;
+
+	for ( scan_index_directory *sid = si->updated; sid != NULL; sid = sid->next )
+	{
+		if ( sid->last_write_time != 0 )
+		{
+			++directory_count;
+		}
+	}
+
+	if ( cancelled == true )
+	{
+		for ( scan_directory_tree::node *node = si->directories.get_head(); node != NULL; node = node->next )
+		{
+			if ( node->val->visited == false )
+			{
+				++directory_count;
+			}
+		}
+	}
+
+	// Write to a temporary file so that the old index stays intact if something goes wrong.
+	int index_path_length = wcslen( si->index_path ) + 5;
+	wchar_t *temp_path = ( wchar_t * )malloc( sizeof( wchar_t ) * index_path_length );
+	swprintf_s( temp_path, index_path_length, L"%s.tmp", si->index_path );
+
+	index_writer iw;
+	iw.hFile = CreateFile( temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( iw.hFile != INVALID_HANDLE_VALUE )
+	{
+		iw.size = 32768;
+		iw.buf = ( char * )malloc( sizeof( char ) * iw.size );
+		iw.length = 0;
+		iw.failed = false;
+
+		unsigned long version = SCAN_INDEX_VERSION;
+		unsigned short root_length = ( unsigned short )wcslen( si->root );
+
+		write_index( &iw, "TVSI", 4 );
+		write_index( &iw, &version, sizeof( unsigned long ) );
+		write_index( &iw, &root_length, sizeof( unsigned short ) );
+		write_index( &iw, si->root, sizeof( wchar_t ) * root_length );
+		write_index( &iw, &directory_count, sizeof( unsigned long ) );
+
+		for ( scan_index_directory *sid = si->updated; sid != NULL; sid = sid->next )
+		{
+			if ( sid->last_write_time != 0 )
+			{
+				write_scan_directory( &iw, sid );
+			}
+		}
+
+		if ( cancelled == true )
+		{
+			for ( scan_directory_tree::node *node = si->directories.get_head(); node != NULL; node = node->next )
+			{
+				if ( node->val->visited == false )
+				{
+					write_scan_directory( &iw, node->val );
+				}
+			}
+		}
+
+		// Write whatever is left in the buffer.
+		DWORD write = 0;
+		if ( iw.failed == false && iw.length > 0 && ( WriteFile( iw.hFile, iw.buf, iw.length, &write, NULL ) == FALSE || write != iw.length ) )
+		{
+			iw.failed = true;
+		}
+
+		free( iw.buf );
+		CloseHandle( iw.hFile );
+
+		if ( iw.failed == true || MoveFileEx( temp_path, si->index_path, MOVEFILE_REPLACE_EXISTING ) == 0 )
+		{
+			DeleteFile( temp_path );
+		}
+	}
+
+	free( temp_path );
+}
+
+void close_scan_index( scan_index *si )
+{
+	// Reused directories are freed with the updated directories.
+	for ( scan_directory_tree::node *node = si->directories.get_head(); node != NULL; node = node->next )
+	{
+		if ( node->val->updated == false )
+		{
+			free_scan_index_directory( node->val );
+		}
+	}
+	si->directories.clear();
+
+	scan_index_directory *sid = si->updated;
+	while ( sid != NULL )
+	{
+		scan_index_directory *del_sid = sid;
+		sid = sid->next;
+
+		free_scan_index_directory( del_sid );
+	}
+
+	free( si->index_path );
+	free( si->root );
+
+	DeleteCriticalSection( &si->lock );
+}
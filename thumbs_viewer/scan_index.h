@@ -0,0 +1,89 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCAN_INDEX_H
+#define SCAN_INDEX_H
+
+#include "typed_rbt.h"
+
+#define SCAN_INDEX_VERSION		1
+
+#define SCAN_ENTRY_FOLDER		0x01
+
+// A directory is only reused if it hasn't been written to for this long before it was enumerated (in 100 nanosecond intervals).
+// Anything that's added within the same tick of a coarse timestamp would otherwise go unnoticed.
+#define SCAN_INDEX_SETTLE_TIME	20000000ULL	// 2 seconds.
+
+struct scan_index_entry
+{
+	unsigned long long hash;
+	unsigned long name_offset;		// Offset of the name in the directory's names.
+	unsigned short name_length;		// In characters.
+	unsigned char flags;
+};
+
+// The contents of a directory as they were when it was last enumerated.
+struct scan_index_directory
+{
+	wchar_t *path;
+	unsigned long long last_write_time;	// 0 if the directory can't be reused.
+	scan_index_entry *entries;
+	wchar_t *names;						// Every entry's name. They aren't NULL terminated.
+	unsigned long entry_count;
+	unsigned long entries_size;
+	unsigned long names_length;
+	unsigned long names_size;
+	bool visited;						// The directory was reached during the scan.
+	bool updated;						// The directory is part of the current scan.
+	scan_index_directory *next;
+};
+
+struct scan_path_compare
+{
+	int operator()( wchar_t * const &a, wchar_t * const &b ) const
+	{
+		return _wcsicmp( a, b );
+	}
+};
+
+typedef typed_dllrbt< wchar_t *, scan_index_directory *, scan_path_compare > scan_directory_tree;
+
+struct scan_index
+{
+	wchar_t *root;
+	wchar_t *index_path;			// NULL if there's nowhere to save the index.
+	scan_directory_tree directories;	// Directories from the previous scan, keyed by path. They're only read during the scan.
+	scan_index_directory *updated;	// Directories from the current scan.
+	unsigned long updated_count;
+	CRITICAL_SECTION lock;			// Guards the updated directories.
+};
+
+void open_scan_index( scan_index *si, wchar_t *root, bool load );
+void save_scan_index( scan_index *si, bool cancelled );
+void close_scan_index( scan_index *si );
+
+unsigned long long get_directory_time( wchar_t *path );
+
+scan_index_directory *find_scan_directory( scan_index *si, wchar_t *path, unsigned long long last_write_time );
+
+scan_index_directory *create_scan_directory( wchar_t *path, unsigned long long last_write_time );
+unsigned long add_scan_entry( scan_index_directory *sid, wchar_t *name, unsigned char flags );
+void add_scan_directory( scan_index *si, scan_index_directory *sid );
+void free_scan_index_directory( scan_index_directory *sid );
+
+#endif
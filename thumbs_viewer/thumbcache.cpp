@@ -0,0 +1,404 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "thumbcache.h"
+#include "crc64.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool g_verify_checksums = false;	// Verify the checksums of each entry as the cache is walked.
+
+void set_checksum_verification( bool enable )
+{
+	g_verify_checksums = enable;
+}
+
+// Validates the cache's header and finds where its entries begin and end.
+char open_cache( file_map *fm, shared_info *si, database_callbacks *dc )
+{
+	// The header is followed by the offset of the first entry and the offset of the first available entry.
+	unsigned long info_offset = sizeof( cache_header );
+	unsigned int header_size = 0;
+
+	if ( fm->size < sizeof( cache_header ) )
+	{
+		report_error( dc, "Premature end of file encountered while reading the header." );
+		return SC_FAIL;
+	}
+
+	cache_header *ch = ( cache_header * )fm->base;
+
+	switch ( ch->version )
+	{
+		case CACHE_WINDOWS_VISTA:
+		{
+			header_size = sizeof( cache_entry_vista );
+		}
+		break;
+
+		case CACHE_WINDOWS_7:
+		{
+			header_size = sizeof( cache_entry_7 );
+		}
+		break;
+
+		case CACHE_WINDOWS_8:
+		case CACHE_WINDOWS_8V2:
+		case CACHE_WINDOWS_8V3:
+		case CACHE_WINDOWS_8_1:
+		case CACHE_WINDOWS_10:
+		{
+			header_size = sizeof( cache_entry_8 );
+			info_offset += sizeof( unsigned int );	// Unknown value.
+		}
+		break;
+
+		default:
+		{
+			report_error( dc, "The thumbcache version is not supported." );
+			return SC_FAIL;
+		}
+		break;
+	}
+
+	if ( fm->size < info_offset + ( sizeof( unsigned int ) * 2 ) )
+	{
+		report_error( dc, "Premature end of file encountered while reading the header." );
+		return SC_FAIL;
+	}
+
+	unsigned int first_entry = 0;
+	unsigned int available_entry = 0;
+	memcpy( &first_entry, fm->base + info_offset, sizeof( unsigned int ) );
+	memcpy( &available_entry, fm->base + info_offset + sizeof( unsigned int ), sizeof( unsigned int ) );
+
+	if ( first_entry < info_offset + ( sizeof( unsigned int ) * 2 ) || first_entry > fm->size )
+	{
+		report_error( dc, "The first cache entry is not in the file." );
+		return SC_FAIL;
+	}
+
+	si->database_type = DATABASE_TYPE_CACHE;
+	si->version = ( unsigned short )ch->version;
+	si->system = 3;	// Vista/2008/7/8/8.1/10
+	si->cache_entry_header_size = header_size;
+	si->cache_start = first_entry;
+	// Nothing has been written after the first available entry.
+	si->cache_end = ( available_entry >= first_entry && available_entry <= fm->size ? available_entry : fm->size );
+
+	return SC_OK;
+}
+
+// Reads the header of the entry at offset. Returns SC_FAIL if it isn't an entry, or if its contents don't fit within it.
+char get_cache_entry( file_map *fm, shared_info *si, unsigned long long offset, cache_entry *ce )
+{
+	if ( offset > si->cache_end || si->cache_end - offset < si->cache_entry_header_size )
+	{
+		return SC_FAIL;
+	}
+
+	unsigned char *header = fm->base + offset;
+	if ( memcmp( header, "CMMM", 4 ) != 0 )
+	{
+		return SC_FAIL;
+	}
+
+	unsigned int padding_size = 0;
+
+	if ( si->version == CACHE_WINDOWS_VISTA )
+	{
+		cache_entry_vista cev;
+		memcpy( &cev, header, sizeof( cache_entry_vista ) );
+
+		ce->cache_entry_size = cev.cache_entry_size;
+		ce->entry_hash = cev.entry_hash;
+		ce->identifier_length = cev.identifier_length;
+		padding_size = cev.padding_size;
+		ce->data_size = cev.data_size;
+		ce->data_checksum = cev.data_checksum;
+		ce->header_checksum = cev.header_checksum;
+	}
+	else if ( si->version == CACHE_WINDOWS_7 )
+	{
+		cache_entry_7 ce7;
+		memcpy( &ce7, header, sizeof( cache_entry_7 ) );
+
+		ce->cache_entry_size = ce7.cache_entry_size;
+		ce->entry_hash = ce7.entry_hash;
+		ce->identifier_length = ce7.identifier_length;
+		padding_size = ce7.padding_size;
+		ce->data_size = ce7.data_size;
+		ce->data_checksum = ce7.data_checksum;
+		ce->header_checksum = ce7.header_checksum;
+	}
+	else
+	{
+		cache_entry_8 ce8;
+		memcpy( &ce8, header, sizeof( cache_entry_8 ) );
+
+		ce->cache_entry_size = ce8.cache_entry_size;
+		ce->entry_hash = ce8.entry_hash;
+		ce->identifier_length = ce8.identifier_length;
+		padding_size = ce8.padding_size;
+		ce->data_size = ce8.data_size;
+		ce->data_checksum = ce8.data_checksum;
+		ce->header_checksum = ce8.header_checksum;
+	}
+
+	ce->offset = offset;
+	ce->header_size = si->cache_entry_header_size;
+
+	// The identifier, padding, and data must all fit within the entry.
+	unsigned long long contents_size = ( unsigned long long )ce->identifier_length + padding_size + ce->data_size;
+	if ( ce->cache_entry_size < ce->header_size || contents_size > ce->cache_entry_size - ce->header_size )
+	{
+		return SC_FAIL;
+	}
+
+	ce->data_offset = offset + ce->header_size + ce->identifier_length + padding_size;
+
+	return SC_OK;
+}
+
+// The header checksum covers every value of the header that comes before it. The data checksum covers the data.
+void verify_cache_entry( file_map *fm, cache_entry *ce, database_callbacks *dc )
+{
+	unsigned long long header_checksum = crc64( ( char * )fm->base + ce->offset, ce->header_size - sizeof( long long ), 0xFFFFFFFFFFFFFFFFULL );
+	if ( header_checksum != ce->header_checksum )
+	{
+		report_error( dc, "The header checksum of a cache entry does not match." );
+	}
+
+	if ( ce->data_size > 0 )
+	{
+		unsigned long long data_checksum = crc64( ( char * )fm->base + ce->data_offset, ce->data_size, 0xFFFFFFFFFFFFFFFFULL );
+		if ( data_checksum != ce->data_checksum )
+		{
+			report_error( dc, "The data checksum of a cache entry does not match." );
+		}
+	}
+}
+
+// Moves offset to the next entry that has data. Entries without any data are skipped since there's nothing to extract.
+// Returns SC_FAIL once there are no more entries, or if an entry is invalid. Nothing after an invalid entry can be trusted.
+char find_cache_entry( file_map *fm, shared_info *si, unsigned long long &offset, cache_entry *ce, database_callbacks *dc )
+{
+	while ( offset < si->cache_end )
+	{
+		// Stop processing and exit the thread.
+		if ( is_cancelled( dc ) == true )
+		{
+			return SC_QUIT;
+		}
+
+		if ( si->cache_end - offset < si->cache_entry_header_size )
+		{
+			report_error( dc, "Premature end of file encountered while reading the cache entries." );
+			return SC_FAIL;
+		}
+
+		if ( get_cache_entry( fm, si, offset, ce ) != SC_OK )
+		{
+			report_error( dc, "Invalid cache entry." );
+			return SC_FAIL;
+		}
+
+		if ( ce->cache_entry_size > si->cache_end - offset )
+		{
+			report_error( dc, "Premature end of file encountered while reading the cache entries." );
+			return SC_FAIL;
+		}
+
+		offset += ce->cache_entry_size;
+
+		if ( g_verify_checksums == true )
+		{
+			verify_cache_entry( fm, ce, dc );
+		}
+
+		if ( ce->data_size == 0 )
+		{
+			continue;
+		}
+
+		// The entry's offset is what we use to find it again.
+		if ( ce->offset > 0xFFFFFFFF )
+		{
+			report_error( dc, "The cache entries beyond 4 GB can't be read." );
+			return SC_FAIL;
+		}
+
+		return SC_OK;
+	}
+
+	return SC_FAIL;
+}
+
+// Sets the entry's type from the beginning of its data, and returns the extension that its name should have.
+// Bitmaps and anything else are left without a type. They have no header to reconstruct a raw image from, so they're decoded as is.
+const wchar_t *get_cache_entry_type( file_map *fm, cache_entry *ce, unsigned char &flag )
+{
+	unsigned char *data = fm->base + ce->data_offset;
+
+	if ( ce->data_size > 3 && memcmp( data, "\xFF\xD8\xFF", 3 ) == 0 )
+	{
+		flag = FIF_TYPE_JPG;
+		return L".jpg";
+	}
+	else if ( ce->data_size > 8 && memcmp( data, FILE_TYPE_PNG, 8 ) == 0 )
+	{
+		flag = FIF_TYPE_PNG;
+		return L".png";
+	}
+	else if ( ce->data_size > 2 && memcmp( data, "BM", 2 ) == 0 )
+	{
+		flag = 0;
+		return L".bmp";
+	}
+
+	flag = 0;
+	return L"";
+}
+
+// The entry is named after its identifier, which is its hash as a hex string. The extension of its data is appended.
+// The name is allocated from the database's arena if in_arena is true, otherwise it must be freed.
+wchar_t *get_cache_entry_name( file_map *fm, shared_info *si, cache_entry *ce, const wchar_t *extension, bool in_arena )
+{
+	unsigned long identifier_length = ce->identifier_length / 2;
+	unsigned long extension_length = wcslen( extension );
+	// The hash is used if there's no identifier.
+	unsigned long name_size = sizeof( wchar_t ) * ( ( identifier_length > 16 ? identifier_length : 16 ) + extension_length + 1 );
+
+	wchar_t *name = ( wchar_t * )( in_arena == true ? arena_alloc( si, name_size ) : malloc( name_size ) );
+	unsigned long name_length = 0;
+
+	if ( identifier_length > 0 )
+	{
+		name_length = convert_utf16_string( ( char * )fm->base + ce->offset + ce->header_size, identifier_length, name );
+	}
+	else
+	{
+		for ( int shift = 60; shift >= 0; shift -= 4 )
+		{
+			name[ name_length++ ] = L"0123456789abcdef"[ ( ( unsigned long long )ce->entry_hash >> shift ) & 0x0F ];
+		}
+	}
+
+	memcpy( name + name_length, extension, sizeof( wchar_t ) * ( extension_length + 1 ) );
+
+	if ( in_arena == true )
+	{
+		arena_shrink( si, name, name_size, sizeof( wchar_t ) * ( name_length + extension_length + 1 ) );
+	}
+
+	return name;
+}
+
+void set_cache_fileinfo( file_map *fm, shared_info *si, cache_entry *ce, fileinfo *fi, bool in_arena )
+{
+	unsigned char flag = 0;
+	const wchar_t *extension = get_cache_entry_type( fm, ce, flag );
+
+	fi->filename = get_cache_entry_name( fm, si, ce, extension, in_arena );
+	fi->date_modified = 0;			// Caches don't keep a date.
+	fi->offset = ( unsigned long )ce->offset;
+	fi->size = ce->data_size;
+	fi->entry_type = 2;				// Stream
+	fi->flag = flag;
+	fi->si = si;
+	fi->entry_hash = ce->entry_hash;
+}
+
+// Walks the cache and passes each entry to add_entry. Entries are allocated from the database's arena.
+char build_cache_entries( shared_info *si, database_callbacks *dc )
+{
+	file_map *fm = &si->fm;	// open_database keeps the view mapped until close_database is called.
+
+	unsigned long long offset = si->cache_start;
+	cache_entry ce;
+	char status = SC_OK;
+
+	while ( ( status = find_cache_entry( fm, si, offset, &ce, dc ) ) == SC_OK )
+	{
+		fileinfo *fi = ( fileinfo * )arena_alloc( si, sizeof( fileinfo ) );
+		set_cache_fileinfo( fm, si, &ce, fi, true );
+		fi->flag |= FIF_ARENA_ENTRY | FIF_ARENA_NAME;	// Both are freed with the database.
+
+		++( si->count );	// Increment the number of entries.
+
+		if ( dc != NULL && dc->add_entry != NULL )
+		{
+			dc->add_entry( dc->context, fi );
+		}
+	}
+
+	return ( status == SC_QUIT ? SC_QUIT : SC_OK );
+}
+
+// Moves the iterator to the next entry of the cache.
+char next_cache_entry( entry_iterator *ei )
+{
+	cache_entry ce;
+
+	char status = find_cache_entry( &ei->si->fm, ei->si, ei->cache_offset, &ce, ei->dc );
+	if ( status == SC_OK )
+	{
+		set_cache_fileinfo( &ei->si->fm, ei->si, &ce, &ei->fi, false );
+
+		++ei->entry_count;
+	}
+
+	return status;
+}
+
+// Copies the entry's data into buf, growing it if it's too small. The data has no header of its own.
+char *read_cache_entry( fileinfo *fi, char *&buf, unsigned long &buf_size, unsigned long &size, unsigned long &header_offset, database_callbacks *dc )
+{
+	file_map *fm = acquire_database_map( fi->si );
+	if ( fm == NULL )
+	{
+		return NULL;
+	}
+
+	cache_entry ce;
+	if ( get_cache_entry( fm, fi->si, fi->offset, &ce ) != SC_OK || ce.data_offset + ce.data_size > fm->size )
+	{
+		release_database_map( fi->si );
+
+		report_error( dc, "Invalid cache entry." );
+
+		return NULL;
+	}
+
+	if ( ce.data_size > buf_size || buf == NULL )
+	{
+		free( buf );
+		buf = ( char * )malloc( sizeof( char ) * ( ce.data_size > 0 ? ce.data_size : 1 ) );
+		buf_size = ( ce.data_size > 0 ? ce.data_size : 1 );
+	}
+
+	memcpy( buf, fm->base + ce.data_offset, ce.data_size );
+
+	release_database_map( fi->si );
+
+	size = ce.data_size;
+	header_offset = 0;
+
+	return buf;
+}
@@ -0,0 +1,111 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THUMBCACHE_H
+#define THUMBCACHE_H
+
+// Reads the thumbcache_*.db files that Windows Vista and newer keep in place of Thumbs.db.
+// They're opened through open_database and read_database like any other database.
+
+#include "thumbs_db.h"
+
+// Format versions that are found in the file header.
+#define CACHE_WINDOWS_VISTA	0x14
+#define CACHE_WINDOWS_7		0x15
+#define CACHE_WINDOWS_8		0x1A
+#define CACHE_WINDOWS_8V2	0x1C
+#define CACHE_WINDOWS_8V3	0x1E
+#define CACHE_WINDOWS_8_1	0x1F
+#define CACHE_WINDOWS_10	0x20
+
+// The first 12 bytes of every version.
+struct cache_header
+{
+	char magic_identifier[ 4 ];	// "CMMM"
+	unsigned int version;
+	unsigned int type;			// Size of the thumbnails. The values differ between versions.
+};
+
+// Found in Windows Vista caches.
+struct cache_entry_vista
+{
+	char magic_identifier[ 4 ];	// "CMMM"
+	unsigned int cache_entry_size;
+	long long entry_hash;
+	unsigned short extension[ 4 ];	// UTF-16
+	unsigned int identifier_length;
+	unsigned int padding_size;
+	unsigned int data_size;
+	unsigned int unknown;
+	long long data_checksum;
+	long long header_checksum;
+};
+
+// Found in Windows 7 caches.
+struct cache_entry_7
+{
+	char magic_identifier[ 4 ];	// "CMMM"
+	unsigned int cache_entry_size;
+	long long entry_hash;
+	unsigned int identifier_length;
+	unsigned int padding_size;
+	unsigned int data_size;
+	unsigned int unknown;
+	long long data_checksum;
+	long long header_checksum;
+};
+
+// Found in Windows 8, 8.1, and 10 caches.
+struct cache_entry_8
+{
+	char magic_identifier[ 4 ];	// "CMMM"
+	unsigned int cache_entry_size;
+	long long entry_hash;
+	unsigned int identifier_length;
+	unsigned int padding_size;
+	unsigned int data_size;
+	unsigned int width;
+	unsigned int height;
+	unsigned int unknown;
+	long long data_checksum;
+	long long header_checksum;
+};
+
+// The values of a cache entry's header that we use, whatever the version.
+struct cache_entry
+{
+	unsigned long long offset;			// Offset of the entry's header.
+	unsigned long long data_offset;		// The identifier and padding come between the header and the data.
+	long long entry_hash;
+	unsigned long long data_checksum;
+	unsigned long long header_checksum;
+	unsigned int header_size;
+	unsigned int cache_entry_size;
+	unsigned int identifier_length;		// In bytes.
+	unsigned int data_size;
+};
+
+// Checksums aren't verified unless this is enabled. It applies to every cache that's read afterward.
+void set_checksum_verification( bool enable );
+
+char open_cache( file_map *fm, shared_info *si, database_callbacks *dc );
+char build_cache_entries( shared_info *si, database_callbacks *dc );
+char next_cache_entry( entry_iterator *ei );
+char *read_cache_entry( fileinfo *fi, char *&buf, unsigned long &buf_size, unsigned long &size, unsigned long &header_offset, database_callbacks *dc );
+
+#endif
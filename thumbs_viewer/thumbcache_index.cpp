@@ -0,0 +1,237 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "thumbcache_index.h"
+#include "thumbcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The caches that each version of the index refers to, in the order their offsets are stored.
+static const wchar_t *cache_names_vista[] = { L"thumbcache_32.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_1024.db" };
+static const wchar_t *cache_names_7[] = { L"thumbcache_32.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_1024.db", L"thumbcache_sr.db" };
+static const wchar_t *cache_names_8[] = { L"thumbcache_16.db", L"thumbcache_32.db", L"thumbcache_48.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_1024.db",
+										  L"thumbcache_sr.db", L"thumbcache_wide.db", L"thumbcache_exif.db" };
+static const wchar_t *cache_names_8v2[] = { L"thumbcache_16.db", L"thumbcache_32.db", L"thumbcache_48.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_1024.db",
+											L"thumbcache_sr.db", L"thumbcache_wide.db", L"thumbcache_exif.db", L"thumbcache_wide_alternate.db" };
+static const wchar_t *cache_names_8_1[] = { L"thumbcache_16.db", L"thumbcache_32.db", L"thumbcache_48.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_1024.db",
+											L"thumbcache_1600.db", L"thumbcache_sr.db", L"thumbcache_wide.db", L"thumbcache_exif.db", L"thumbcache_wide_alternate.db" };
+static const wchar_t *cache_names_10[] = { L"thumbcache_16.db", L"thumbcache_32.db", L"thumbcache_48.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_768.db",
+										   L"thumbcache_1280.db", L"thumbcache_1920.db", L"thumbcache_2560.db", L"thumbcache_sr.db", L"thumbcache_wide.db", L"thumbcache_exif.db",
+										   L"thumbcache_wide_alternate.db", L"thumbcache_custom_stream.db" };
+
+// Vista and 7 entries are the hash, a modified FILETIME, and flags, followed by the offsets.
+// Windows 8 and newer entries are the hash, flags, and an unknown value, followed by the offsets.
+char open_cache_index( const wchar_t *path, cache_index *ci, database_callbacks *dc )
+{
+	memset( ci, 0, sizeof( cache_index ) );
+
+	if ( path == NULL || map_file( &ci->fm, path ) == false || ci->fm.base == NULL )
+	{
+		report_error( dc, "The index file failed to open." );
+
+		return SC_FAIL;
+	}
+
+	if ( ci->fm.size < sizeof( index_header ) || memcmp( ci->fm.base, "IMMM", 4 ) != 0 )
+	{
+		close_cache_index( ci );
+
+		report_error( dc, "The file is not a thumbcache index." );
+
+		return SC_FAIL;
+	}
+
+	index_header ih;
+	memcpy( &ih, ci->fm.base, sizeof( index_header ) );
+
+	unsigned long header_size = sizeof( index_header );
+
+	switch ( ih.version )
+	{
+		case CACHE_WINDOWS_VISTA:
+		{
+			ci->cache_names = cache_names_vista;
+			ci->cache_count = sizeof( cache_names_vista ) / sizeof( cache_names_vista[ 0 ] );
+			ci->locations_offset = sizeof( long long ) + sizeof( long long ) + sizeof( unsigned int );
+		}
+		break;
+
+		case CACHE_WINDOWS_7:
+		{
+			ci->cache_names = cache_names_7;
+			ci->cache_count = sizeof( cache_names_7 ) / sizeof( cache_names_7[ 0 ] );
+			ci->locations_offset = sizeof( long long ) + sizeof( long long ) + sizeof( unsigned int );
+		}
+		break;
+
+		case CACHE_WINDOWS_8:
+		{
+			ci->cache_names = cache_names_8;
+			ci->cache_count = sizeof( cache_names_8 ) / sizeof( cache_names_8[ 0 ] );
+		}
+		break;
+
+		case CACHE_WINDOWS_8V2:
+		{
+			ci->cache_names = cache_names_8v2;
+			ci->cache_count = sizeof( cache_names_8v2 ) / sizeof( cache_names_8v2[ 0 ] );
+		}
+		break;
+
+		case CACHE_WINDOWS_8V3:
+		case CACHE_WINDOWS_8_1:
+		{
+			ci->cache_names = cache_names_8_1;
+			ci->cache_count = sizeof( cache_names_8_1 ) / sizeof( cache_names_8_1[ 0 ] );
+		}
+		break;
+
+		case CACHE_WINDOWS_10:
+		{
+			ci->cache_names = cache_names_10;
+			ci->cache_count = sizeof( cache_names_10 ) / sizeof( cache_names_10[ 0 ] );
+		}
+		break;
+
+		default:
+		{
+			close_cache_index( ci );
+
+			report_error( dc, "The thumbcache index version is not supported." );
+
+			return SC_FAIL;
+		}
+		break;
+	}
+
+	if ( ih.version != CACHE_WINDOWS_VISTA && ih.version != CACHE_WINDOWS_7 )
+	{
+		header_size += sizeof( unsigned int );	// Unknown value.
+		ci->locations_offset = sizeof( long long ) + sizeof( unsigned int ) + sizeof( unsigned int );
+	}
+
+	ci->version = ih.version;
+	ci->entry_size = ci->locations_offset + ( sizeof( unsigned int ) * ci->cache_count );
+	ci->entries_offset = header_size;
+
+	// Only the slots that are in the file can be looked at. They must all be there for the hash to find its slot.
+	unsigned long long available = ( ci->fm.size > header_size ? ( ci->fm.size - header_size ) / ci->entry_size : 0 );
+	if ( ih.entry_count == 0 || ih.entry_count > available )
+	{
+		close_cache_index( ci );
+
+		report_error( dc, "Premature end of file encountered while reading the index entries." );
+
+		return SC_FAIL;
+	}
+
+	ci->entry_count = ih.entry_count;
+
+	// The caches are next to the index.
+	unsigned long directory_length = wcslen( path );
+	while ( directory_length > 0 && path[ directory_length - 1 ] != L'\\' && path[ directory_length - 1 ] != L'/' )
+	{
+		--directory_length;
+	}
+
+	ci->directory = ( wchar_t * )malloc( sizeof( wchar_t ) * ( directory_length + 1 ) );
+	memcpy( ci->directory, path, sizeof( wchar_t ) * directory_length );
+	ci->directory[ directory_length ] = 0;	// Sanity.
+
+	return SC_OK;
+}
+
+void close_cache_index( cache_index *ci )
+{
+	if ( ci == NULL )
+	{
+		return;
+	}
+
+	unmap_file( &ci->fm );
+	free( ci->directory );
+	ci->directory = NULL;
+}
+
+// The table is open addressed. An entry starts at its hash modulo the number of slots and moves to the next free slot.
+// The probe stops at the entry, at an empty slot, or once every slot has been looked at.
+unsigned int find_cache_locations( cache_index *ci, long long entry_hash, cache_location *locations )
+{
+	if ( ci == NULL || ci->fm.base == NULL || entry_hash == 0 )
+	{
+		return 0;
+	}
+
+	unsigned long slot = ( unsigned long )( ( unsigned long long )entry_hash % ci->entry_count );
+
+	for ( unsigned long probes = 0; probes < ci->entry_count; ++probes )
+	{
+		unsigned char *entry = ci->fm.base + ci->entries_offset + ( ( unsigned long long )slot * ci->entry_size );
+
+		long long slot_hash = 0;
+		memcpy( &slot_hash, entry, sizeof( long long ) );
+
+		if ( slot_hash == 0 )	// Empty
+		{
+			break;
+		}
+
+		if ( slot_hash == entry_hash )
+		{
+			unsigned int location_count = 0;
+
+			for ( unsigned int i = 0; i < ci->cache_count; ++i )
+			{
+				unsigned int offset = 0;
+				memcpy( &offset, entry + ci->locations_offset + ( sizeof( unsigned int ) * i ), sizeof( unsigned int ) );
+
+				// The entry isn't in that cache.
+				if ( offset == 0xFFFFFFFF || offset == 0 )
+				{
+					continue;
+				}
+
+				locations[ location_count ].cache_name = ci->cache_names[ i ];
+				locations[ location_count ].offset = offset;
+				++location_count;
+			}
+
+			return location_count;
+		}
+
+		if ( ++slot == ci->entry_count )
+		{
+			slot = 0;
+		}
+	}
+
+	return 0;
+}
+
+wchar_t *get_cache_location_path( cache_index *ci, cache_location *cl )
+{
+	unsigned long directory_length = wcslen( ci->directory );
+	unsigned long name_length = wcslen( cl->cache_name ) + 1;	// Include the NULL character.
+
+	wchar_t *path = ( wchar_t * )malloc( sizeof( wchar_t ) * ( directory_length + name_length ) );
+	memcpy( path, ci->directory, sizeof( wchar_t ) * directory_length );
+	memcpy( path + directory_length, cl->cache_name, sizeof( wchar_t ) * name_length );
+
+	return path;
+}
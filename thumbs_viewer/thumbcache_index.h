@@ -0,0 +1,73 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THUMBCACHE_INDEX_H
+#define THUMBCACHE_INDEX_H
+
+// Reads the thumbcache_idx.db file that sits next to the thumbcache_*.db files.
+// It's a table of every cached entry hash and where that entry is found in each of the caches.
+
+#include "thumbs_db.h"
+
+#define MAX_CACHE_LOCATIONS	14	// The most thumbnail sizes that an index entry can hold.
+
+// The first 24 bytes of every version.
+struct index_header
+{
+	char magic_identifier[ 4 ];	// "IMMM"
+	unsigned int version;		// Same values as the caches.
+	unsigned int unknown;
+	unsigned int used_entries;
+	unsigned int entry_count;	// Number of slots in the table.
+	unsigned int unknown2;
+};
+
+// Where one size of an entry's thumbnail is found.
+struct cache_location
+{
+	const wchar_t *cache_name;	// Name of the cache file within the index's directory.
+	unsigned long offset;		// Offset of the entry's header within the cache.
+};
+
+// The index is mapped while it's open. Only its directory is allocated. close_cache_index frees both.
+struct cache_index
+{
+	file_map fm;
+	wchar_t *directory;				// Directory of the index, including its trailing separator.
+
+	const wchar_t **cache_names;	// Cache file of each offset in an entry.
+	unsigned int cache_count;
+
+	unsigned long long entries_offset;
+	unsigned long entry_size;
+	unsigned long entry_count;		// Number of slots that are in the file.
+	unsigned long locations_offset;	// Offset of the cache offsets within an entry.
+
+	unsigned int version;
+};
+
+char open_cache_index( const wchar_t *path, cache_index *ci, database_callbacks *dc );
+void close_cache_index( cache_index *ci );
+
+// Fills locations with every cache that holds the entry. Returns the number of locations, which is 0 if the entry isn't in the index.
+unsigned int find_cache_locations( cache_index *ci, long long entry_hash, cache_location *locations );
+
+// Returns the path of the location's cache file. It must be freed.
+wchar_t *get_cache_location_path( cache_index *ci, cache_location *cl );
+
+#endif
@@ -0,0 +1,310 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Builds small thumbcache_idx.db files and checks what find_cache_locations finds in them. Run it with: make check
+#include "thumbcache_index.h"
+#include "thumbcache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_INDEX_PATH		L"thumbcache_index_test.db"
+#define TEST_INDEX_PATH_MB	"thumbcache_index_test.db"
+
+#define NO_OFFSET	0xFFFFFFFF
+
+// One occupied slot of a test index.
+struct test_slot
+{
+	unsigned long slot;
+	long long entry_hash;
+	unsigned int offsets[ MAX_CACHE_LOCATIONS ];	// Unused offsets are left as 0.
+};
+
+// One lookup and the caches it should find.
+struct test_lookup
+{
+	const char *description;
+	long long entry_hash;
+	unsigned int location_count;
+	const wchar_t *cache_names[ MAX_CACHE_LOCATIONS ];
+	unsigned long offsets[ MAX_CACHE_LOCATIONS ];
+};
+
+static unsigned long failures = 0;
+
+static void fail( const char *version_name, const char *description, const char *message )
+{
+	fprintf( stderr, "%s: %s: %s\n", version_name, description, message );
+	++failures;
+}
+
+// Writes an index with the same layout that open_cache_index expects. Returns false if it couldn't be written.
+static bool write_index( unsigned int version, unsigned int entry_count, unsigned int file_slots, unsigned int cache_count, const test_slot *slots, unsigned int slot_count )
+{
+	bool pre_8 = ( version == CACHE_WINDOWS_VISTA || version == CACHE_WINDOWS_7 );
+
+	unsigned long header_size = sizeof( index_header ) + ( pre_8 == true ? 0 : sizeof( unsigned int ) );
+	unsigned long locations_offset = ( pre_8 == true ? sizeof( long long ) + sizeof( long long ) + sizeof( unsigned int ) :
+													   sizeof( long long ) + sizeof( unsigned int ) + sizeof( unsigned int ) );
+	unsigned long entry_size = locations_offset + ( sizeof( unsigned int ) * cache_count );
+	unsigned long file_size = header_size + ( entry_size * file_slots );
+
+	unsigned char *buf = ( unsigned char * )malloc( file_size );
+	memset( buf, 0, file_size );
+
+	index_header ih;
+	memset( &ih, 0, sizeof( index_header ) );
+	memcpy( ih.magic_identifier, "IMMM", 4 );
+	ih.version = version;
+	ih.used_entries = slot_count;
+	ih.entry_count = entry_count;
+	memcpy( buf, &ih, sizeof( index_header ) );
+
+	for ( unsigned int i = 0; i < slot_count; ++i )
+	{
+		unsigned char *entry = buf + header_size + ( slots[ i ].slot * entry_size );
+		memcpy( entry, &slots[ i ].entry_hash, sizeof( long long ) );
+
+		// Flags and the other fields that the reader skips. They should never be mistaken for offsets.
+		memset( entry + sizeof( long long ), 0xAB, locations_offset - sizeof( long long ) );
+
+		memcpy( entry + locations_offset, slots[ i ].offsets, sizeof( unsigned int ) * cache_count );
+	}
+
+	FILE *f = fopen( TEST_INDEX_PATH_MB, "wb" );
+	if ( f == NULL )
+	{
+		free( buf );
+
+		return false;
+	}
+
+	bool written = ( fwrite( buf, 1, file_size, f ) == file_size );
+	fclose( f );
+	free( buf );
+
+	return written;
+}
+
+static void check_lookups( const char *version_name, cache_index *ci, const test_lookup *lookups, unsigned int lookup_count )
+{
+	for ( unsigned int i = 0; i < lookup_count; ++i )
+	{
+		cache_location locations[ MAX_CACHE_LOCATIONS ];
+		memset( locations, 0, sizeof( locations ) );
+
+		unsigned int location_count = find_cache_locations( ci, lookups[ i ].entry_hash, locations );
+		if ( location_count != lookups[ i ].location_count )
+		{
+			fail( version_name, lookups[ i ].description, "wrong number of locations" );
+
+			continue;
+		}
+
+		for ( unsigned int j = 0; j < location_count; ++j )
+		{
+			if ( locations[ j ].cache_name == NULL || wcscmp( locations[ j ].cache_name, lookups[ i ].cache_names[ j ] ) != 0 )
+			{
+				fail( version_name, lookups[ i ].description, "wrong cache" );
+			}
+			else if ( locations[ j ].offset != lookups[ i ].offsets[ j ] )
+			{
+				fail( version_name, lookups[ i ].description, "wrong offset" );
+			}
+		}
+	}
+}
+
+// Every version is checked with the same layout of slots. The table has 7 slots so the probe must wrap.
+//
+// Slot 0: B, whose home is slot 6. It's only found by wrapping.
+// Slot 1: empty
+// Slot 2: D, whose home is slot 6. The probe for it stops at slot 1 and never gets here.
+// Slot 3: N, a negative hash whose home as an unsigned value is slot 3.
+// Slot 6: A, in its home slot.
+#define TEST_SLOTS	7
+
+static void check_version( const char *version_name, unsigned int version, const wchar_t **cache_names, unsigned int cache_count )
+{
+	long long hash_a = ( 1000 * TEST_SLOTS ) + 6;
+	long long hash_b = ( 2000 * TEST_SLOTS ) + 6;
+	long long hash_d = ( 3000 * TEST_SLOTS ) + 6;
+	long long hash_missing = ( 4000 * TEST_SLOTS ) + 6;
+	long long hash_n = ( long long )0x8000000000000000ULL;
+	hash_n += ( TEST_SLOTS + 3 - ( long long )( 0x8000000000000000ULL % TEST_SLOTS ) ) % TEST_SLOTS;
+
+	unsigned int last = cache_count - 1;
+
+	test_slot slots[ 4 ];
+	memset( slots, 0, sizeof( slots ) );
+
+	// A is in every cache.
+	slots[ 0 ].slot = 6;
+	slots[ 0 ].entry_hash = hash_a;
+	for ( unsigned int i = 0; i < cache_count; ++i )
+	{
+		slots[ 0 ].offsets[ i ] = 0x100 * ( i + 1 );
+	}
+
+	// B is in the second and last caches. The others are skipped whether they're 0 or 0xFFFFFFFF.
+	slots[ 1 ].slot = 0;
+	slots[ 1 ].entry_hash = hash_b;
+	for ( unsigned int i = 0; i < cache_count; ++i )
+	{
+		slots[ 1 ].offsets[ i ] = ( i % 2 == 0 ? NO_OFFSET : 0 );
+	}
+	slots[ 1 ].offsets[ 1 ] = 0x1234;
+	slots[ 1 ].offsets[ last ] = 0xFFFFFFFE;
+
+	slots[ 2 ].slot = 2;
+	slots[ 2 ].entry_hash = hash_d;
+	slots[ 2 ].offsets[ 0 ] = 0x5678;
+
+	// N is in no cache at all.
+	slots[ 3 ].slot = 3;
+	slots[ 3 ].entry_hash = hash_n;
+	for ( unsigned int i = 0; i < cache_count; ++i )
+	{
+		slots[ 3 ].offsets[ i ] = NO_OFFSET;
+	}
+
+	if ( write_index( version, TEST_SLOTS, TEST_SLOTS, cache_count, slots, 4 ) == false )
+	{
+		fail( version_name, "write", "the test index couldn't be written" );
+
+		return;
+	}
+
+	cache_index ci;
+	if ( open_cache_index( TEST_INDEX_PATH, &ci, NULL ) != SC_OK )
+	{
+		fail( version_name, "open", "the test index didn't open" );
+
+		return;
+	}
+
+	if ( ci.cache_count != cache_count )
+	{
+		fail( version_name, "open", "wrong number of caches" );
+	}
+
+	test_lookup lookups[ 6 ];
+	memset( lookups, 0, sizeof( lookups ) );
+
+	lookups[ 0 ].description = "home slot";
+	lookups[ 0 ].entry_hash = hash_a;
+	lookups[ 0 ].location_count = cache_count;
+	for ( unsigned int i = 0; i < cache_count; ++i )
+	{
+		lookups[ 0 ].cache_names[ i ] = cache_names[ i ];
+		lookups[ 0 ].offsets[ i ] = 0x100 * ( i + 1 );
+	}
+
+	lookups[ 1 ].description = "wrapped probe";
+	lookups[ 1 ].entry_hash = hash_b;
+	lookups[ 1 ].location_count = 2;
+	lookups[ 1 ].cache_names[ 0 ] = cache_names[ 1 ];
+	lookups[ 1 ].offsets[ 0 ] = 0x1234;
+	lookups[ 1 ].cache_names[ 1 ] = cache_names[ last ];
+	lookups[ 1 ].offsets[ 1 ] = 0xFFFFFFFE;
+
+	lookups[ 2 ].description = "stops at an empty slot";
+	lookups[ 2 ].entry_hash = hash_d;
+
+	lookups[ 3 ].description = "missing entry";
+	lookups[ 3 ].entry_hash = hash_missing;
+
+	lookups[ 4 ].description = "every offset skipped";
+	lookups[ 4 ].entry_hash = hash_n;
+
+	lookups[ 5 ].description = "zero hash";
+	lookups[ 5 ].entry_hash = 0;
+
+	check_lookups( version_name, &ci, lookups, 6 );
+
+	if ( ci.directory == NULL || ci.directory[ 0 ] != 0 )
+	{
+		fail( version_name, "open", "the directory of a bare file name should be empty" );
+	}
+
+	close_cache_index( &ci );
+
+	// A full table has no empty slot. The probe has to give up after looking at each slot once.
+	test_slot full[ TEST_SLOTS ];
+	memset( full, 0, sizeof( full ) );
+	for ( unsigned int i = 0; i < TEST_SLOTS; ++i )
+	{
+		full[ i ].slot = i;
+		full[ i ].entry_hash = ( 5000 * TEST_SLOTS ) + i;
+		full[ i ].offsets[ 0 ] = 0x10 * ( i + 1 );
+	}
+
+	if ( write_index( version, TEST_SLOTS, TEST_SLOTS, cache_count, full, TEST_SLOTS ) == false || open_cache_index( TEST_INDEX_PATH, &ci, NULL ) != SC_OK )
+	{
+		fail( version_name, "full table", "the test index didn't open" );
+
+		return;
+	}
+
+	test_lookup full_lookups[ 2 ];
+	memset( full_lookups, 0, sizeof( full_lookups ) );
+
+	full_lookups[ 0 ].description = "full table, last slot";
+	full_lookups[ 0 ].entry_hash = ( 5000 * TEST_SLOTS ) + 6;
+	full_lookups[ 0 ].location_count = 1;
+	full_lookups[ 0 ].cache_names[ 0 ] = cache_names[ 0 ];
+	full_lookups[ 0 ].offsets[ 0 ] = 0x70;
+
+	full_lookups[ 1 ].description = "full table, missing entry";
+	full_lookups[ 1 ].entry_hash = hash_missing;
+
+	check_lookups( version_name, &ci, full_lookups, 2 );
+
+	close_cache_index( &ci );
+
+	// The header claims more slots than the file holds.
+	if ( write_index( version, TEST_SLOTS + 1, TEST_SLOTS, cache_count, slots, 4 ) == false )
+	{
+		fail( version_name, "truncated", "the test index couldn't be written" );
+	}
+	else if ( open_cache_index( TEST_INDEX_PATH, &ci, NULL ) != SC_FAIL )
+	{
+		fail( version_name, "truncated", "a truncated index opened" );
+
+		close_cache_index( &ci );
+	}
+}
+
+int main()
+{
+	static const wchar_t *cache_names_7[] = { L"thumbcache_32.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_1024.db", L"thumbcache_sr.db" };
+	static const wchar_t *cache_names_10[] = { L"thumbcache_16.db", L"thumbcache_32.db", L"thumbcache_48.db", L"thumbcache_96.db", L"thumbcache_256.db", L"thumbcache_768.db",
+											   L"thumbcache_1280.db", L"thumbcache_1920.db", L"thumbcache_2560.db", L"thumbcache_sr.db", L"thumbcache_wide.db", L"thumbcache_exif.db",
+											   L"thumbcache_wide_alternate.db", L"thumbcache_custom_stream.db" };
+
+	check_version( "Windows 7", CACHE_WINDOWS_7, cache_names_7, sizeof( cache_names_7 ) / sizeof( cache_names_7[ 0 ] ) );
+	check_version( "Windows 10", CACHE_WINDOWS_10, cache_names_10, sizeof( cache_names_10 ) / sizeof( cache_names_10[ 0 ] ) );
+
+	remove( TEST_INDEX_PATH_MB );
+
+	printf( "%s: %lu failures\n", ( failures == 0 ? "PASS" : "FAIL" ), failures );
+
+	return ( failures == 0 ? 0 : 1 );
+}
@@ -0,0 +1,555 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Command-line front end for the database reader. It has no user interface and builds on Linux.
+//
+// thumbs_cli [-v] [-o output_directory] [-c csv_file] database...
+// thumbs_cli -l entry_hash thumbcache_idx...
+//
+// With no options, the entries of each database are listed to stdout.
+// -l lists the caches and offsets of the entry with the hexadecimal entry_hash in each thumbcache index.
+// -v verifies the checksums of each thumbcache entry. Mismatches are reported as errors.
+// -o extracts every entry into output_directory.
+// -c writes the entries to csv_file using the same columns as the "Save Report" option.
+
+#include "thumbs_db.h"
+#include "thumbcache.h"
+#include "thumbcache_index.h"
+
+#include <errno.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef USE_IO_URING
+	#define SAVE_BATCH_SIZE	64	// Number of entries that are read together before they're written out.
+#else
+	#define SAVE_BATCH_SIZE	1	// Entries are read one at a time without io_uring, so only one is held.
+#endif
+
+struct cli_context
+{
+	const char *dbpath;			// Database currently being read. Used in error messages.
+	unsigned long error_count;
+};
+
+// Entries waiting to be saved. They're copies since the iterator reuses its entry.
+struct entry_batch
+{
+	fileinfo entries[ SAVE_BATCH_SIZE ];
+	fileinfo *entry_ptrs[ SAVE_BATCH_SIZE ];
+	entry_buffer buffers[ SAVE_BATCH_SIZE ];	// Reused by each batch.
+	unsigned long count;
+};
+
+void cli_report_error( void *context, const char *message )
+{
+	cli_context *cc = ( cli_context * )context;
+
+	++cc->error_count;
+
+	fprintf( stderr, "%s: %s\n", cc->dbpath, message );
+}
+
+// Encodes a wide character string as UTF-8. The returned string must be freed.
+char *wide_to_utf8( const wchar_t *string )
+{
+	unsigned long length = wcslen( string );
+	char *utf8_string = ( char * )malloc( sizeof( char ) * ( ( length * 4 ) + 1 ) );
+	char *p = utf8_string;
+
+	for ( unsigned long i = 0; i < length; ++i )
+	{
+		unsigned long c = ( unsigned long )string[ i ];
+
+		// Combine surrogate pairs if wchar_t is UTF-16.
+		if ( c >= 0xD800 && c <= 0xDBFF && i + 1 < length && ( unsigned long )string[ i + 1 ] >= 0xDC00 && ( unsigned long )string[ i + 1 ] <= 0xDFFF )
+		{
+			c = 0x10000 + ( ( c - 0xD800 ) << 10 ) + ( ( unsigned long )string[ ++i ] - 0xDC00 );
+		}
+
+		if ( c < 0x80 )
+		{
+			*p++ = ( char )c;
+		}
+		else if ( c < 0x800 )
+		{
+			*p++ = ( char )( 0xC0 | ( c >> 6 ) );
+			*p++ = ( char )( 0x80 | ( c & 0x3F ) );
+		}
+		else if ( c < 0x10000 )
+		{
+			*p++ = ( char )( 0xE0 | ( c >> 12 ) );
+			*p++ = ( char )( 0x80 | ( ( c >> 6 ) & 0x3F ) );
+			*p++ = ( char )( 0x80 | ( c & 0x3F ) );
+		}
+		else
+		{
+			*p++ = ( char )( 0xF0 | ( c >> 18 ) );
+			*p++ = ( char )( 0x80 | ( ( c >> 12 ) & 0x3F ) );
+			*p++ = ( char )( 0x80 | ( ( c >> 6 ) & 0x3F ) );
+			*p++ = ( char )( 0x80 | ( c & 0x3F ) );
+		}
+	}
+
+	*p = 0;	// Sanity.
+
+	return utf8_string;
+}
+
+// Writes the FILETIME as "M/D/YYYY (HH:MM:SS.mmm)" in UTC. Returns false if there's no date.
+bool format_filetime( long long filetime, char *buf, size_t buf_size )
+{
+	if ( filetime == 0 )
+	{
+		return false;
+	}
+
+	// FILETIME is the number of 100 nanosecond intervals since January 1, 1601.
+	time_t unix_time = ( time_t )( ( filetime - 116444736000000000LL ) / 10000000LL );
+	int milliseconds = ( int )( ( filetime / 10000LL ) % 1000 );
+
+	struct tm st;
+	if ( gmtime_r( &unix_time, &st ) == NULL )
+	{
+		return false;
+	}
+
+	snprintf( buf, buf_size, "%d/%d/%d (%02d:%02d:%02d.%d)", st.tm_mon + 1, st.tm_mday, st.tm_year + 1900, st.tm_hour, st.tm_min, st.tm_sec, milliseconds );
+
+	return true;
+}
+
+const char *get_system_string( unsigned char system )
+{
+	switch ( system )
+	{
+		case 1: { return "Windows Me/2000"; } break;
+		case 2: { return "Windows XP/2003"; } break;
+		case 3: { return "Windows Vista/2008/7/8/8.1"; } break;
+	}
+
+	return "Unknown";
+}
+
+// Writes a CSV field surrounded by quotes. Quotes within the field are doubled.
+void write_csv_string( FILE *f, const char *string )
+{
+	fputc( '\"', f );
+	for ( const char *p = string; *p != 0; ++p )
+	{
+		if ( *p == '\"' )
+		{
+			fputc( '\"', f );
+		}
+		fputc( *p, f );
+	}
+	fputc( '\"', f );
+}
+
+// Distinguish between Short SAT, SAT, and thumbcache entries.
+const char *get_location_string( fileinfo *fi )
+{
+	if ( fi->si->database_type == DATABASE_TYPE_CACHE )
+	{
+		return "cache";
+	}
+
+	return ( fi->size < fi->si->short_sect_cutoff ? "SSAT" : "SAT" );
+}
+
+// Writes the entry as a row using the same columns as the "Save Report" option.
+void write_csv_row( FILE *f, fileinfo *fi )
+{
+	char date[ 64 ];
+
+	char *utf8_filename = wide_to_utf8( fi->filename );
+	char *utf8_dbpath = wide_to_utf8( fi->si->dbpath );
+
+	fputs( "\r\n", f );
+	write_csv_string( f, utf8_filename );
+	fprintf( f, ",%lu,%lu in %s,", fi->size, fi->offset, get_location_string( fi ) );
+
+	if ( format_filetime( fi->date_modified, date, sizeof( date ) ) == true )
+	{
+		fprintf( f, "%s,%llu", date, ( unsigned long long )fi->date_modified );
+	}
+	else
+	{
+		fputc( ',', f );
+	}
+
+	// Only Me/2000 and XP/2003 databases have a catalog version.
+	if ( fi->si->system == 1 || fi->si->system == 2 )
+	{
+		fprintf( f, ",%d: ", fi->si->version );
+	}
+	else
+	{
+		fputc( ',', f );
+	}
+
+	fprintf( f, "%s,", get_system_string( fi->si->system ) );
+	write_csv_string( f, utf8_dbpath );
+
+	free( utf8_filename );
+	free( utf8_dbpath );
+}
+
+void list_entry( fileinfo *fi )
+{
+	char date[ 64 ];
+
+	char *utf8_filename = wide_to_utf8( fi->filename );
+	char *utf8_dbpath = wide_to_utf8( fi->si->dbpath );
+
+	if ( format_filetime( fi->date_modified, date, sizeof( date ) ) == false )
+	{
+		date[ 0 ] = 0;
+	}
+
+	printf( "%s\t%lu\t%lu in %s\t%s\t%s\t%s\n", utf8_filename, fi->size, fi->offset, get_location_string( fi ), date, get_system_string( fi->si->system ), utf8_dbpath );
+
+	free( utf8_filename );
+	free( utf8_dbpath );
+}
+
+// Writes an entry that's been read into the output directory. The extension is appended if the entry's name doesn't already have it.
+// Reconstructed CMYK JPEGs and raw bitmaps are written as they're stored. There's no image conversion like in the Windows version.
+bool save_entry( fileinfo *fi, entry_buffer *eb, const char *output_directory )
+{
+	bool saved = false;
+
+	if ( eb->data == NULL )
+	{
+		return false;
+	}
+
+	// Me and 2000 store the full path. We only want the file name.
+	wchar_t *filename = wcsrchr( fi->filename, L'\\' );
+	filename = ( filename != NULL ? filename + 1 : fi->filename );
+
+	char *utf8_filename = wide_to_utf8( filename );
+
+	// Don't let the name escape the output directory.
+	for ( char *p = utf8_filename; *p != 0; ++p )
+	{
+		if ( *p == '/' )
+		{
+			*p = '_';
+		}
+	}
+
+	const char *extension = "";
+	const char *ext = strrchr( utf8_filename, '.' );
+	if ( ( fi->flag & FIF_TYPE_JPG ) || ( fi->flag & FIF_TYPE_CMYK_JPG ) )
+	{
+		// The extension in the filename might not be the actual type. So we'll append .jpg to the end of it.
+		if ( ext == NULL || ( strcasecmp( ext, ".jpg" ) != 0 && strcasecmp( ext, ".jpeg" ) != 0 ) )
+		{
+			extension = ".jpg";
+		}
+	}
+	else if ( fi->flag & FIF_TYPE_PNG )
+	{
+		if ( ext == NULL || strcasecmp( ext, ".png" ) != 0 )
+		{
+			extension = ".png";
+		}
+	}
+
+	size_t fullpath_length = strlen( output_directory ) + strlen( utf8_filename ) + strlen( extension ) + 2;
+	char *fullpath = ( char * )malloc( sizeof( char ) * fullpath_length );
+	snprintf( fullpath, fullpath_length, "%s/%s%s", output_directory, utf8_filename, extension );
+
+	FILE *f = fopen( fullpath, "wb" );
+	if ( f != NULL )
+	{
+		if ( fwrite( eb->data + eb->header_offset, sizeof( char ), eb->size, f ) == eb->size )
+		{
+			saved = true;
+		}
+
+		fclose( f );
+	}
+	else
+	{
+		fprintf( stderr, "%s: %s\n", fullpath, strerror( errno ) );
+	}
+
+	free( fullpath );
+	free( utf8_filename );
+
+	return saved;
+}
+
+// Reads the batch's entries together and writes them out. Returns the number of entries that were saved.
+unsigned long save_batch( entry_batch *batch, const char *output_directory, database_callbacks *dc )
+{
+	unsigned long saved = 0;
+
+	read_entries( batch->entry_ptrs, batch->count, batch->buffers, dc );
+
+	for ( unsigned long i = 0; i < batch->count; ++i )
+	{
+		if ( save_entry( &batch->entries[ i ], &batch->buffers[ i ], output_directory ) == true )
+		{
+			++saved;
+		}
+
+		free( batch->entries[ i ].filename );
+	}
+
+	batch->count = 0;
+
+	return saved;
+}
+
+// Lists where the entry is found without reading any of the caches.
+void list_locations( const wchar_t *path, long long entry_hash, database_callbacks *dc )
+{
+	cache_index ci;
+	if ( open_cache_index( path, &ci, dc ) != SC_OK )
+	{
+		return;
+	}
+
+	cache_location locations[ MAX_CACHE_LOCATIONS ];
+	unsigned int location_count = find_cache_locations( &ci, entry_hash, locations );
+	if ( location_count == 0 )
+	{
+		dc->report_error( dc->context, "The entry is not in the index." );
+	}
+
+	for ( unsigned int i = 0; i < location_count; ++i )
+	{
+		wchar_t *cache_path = get_cache_location_path( &ci, &locations[ i ] );
+		char *utf8_cache_path = wide_to_utf8( cache_path );
+
+		printf( "%016llx\t%s\t%lu\n", ( unsigned long long )entry_hash, utf8_cache_path, locations[ i ].offset );
+
+		free( utf8_cache_path );
+		free( cache_path );
+	}
+
+	close_cache_index( &ci );
+}
+
+int main( int argc, char *argv[] )
+{
+	const char *output_directory = NULL;
+	const char *csv_path = NULL;
+	const char *lookup_hash = NULL;
+	int first_database = 1;
+
+	// Paths and names are converted using the user's locale.
+	setlocale( LC_ALL, "" );
+
+	for ( ; first_database < argc; ++first_database )
+	{
+		if ( strcmp( argv[ first_database ], "-v" ) == 0 )
+		{
+			set_checksum_verification( true );
+		}
+		else if ( strcmp( argv[ first_database ], "-o" ) == 0 && first_database + 1 < argc )
+		{
+			output_directory = argv[ ++first_database ];
+		}
+		else if ( strcmp( argv[ first_database ], "-c" ) == 0 && first_database + 1 < argc )
+		{
+			csv_path = argv[ ++first_database ];
+		}
+		else if ( strcmp( argv[ first_database ], "-l" ) == 0 && first_database + 1 < argc )
+		{
+			lookup_hash = argv[ ++first_database ];
+		}
+		else if ( strcmp( argv[ first_database ], "--" ) == 0 )
+		{
+			++first_database;
+			break;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if ( first_database >= argc )
+	{
+		fprintf( stderr, "usage: %s [-v] [-o output_directory] [-c csv_file] database...\n", argv[ 0 ] );
+		fprintf( stderr, "       %s -l entry_hash thumbcache_idx...\n", argv[ 0 ] );
+		return 2;
+	}
+
+	long long entry_hash = 0;
+	if ( lookup_hash != NULL )
+	{
+		char *end = NULL;
+		entry_hash = ( long long )strtoull( lookup_hash, &end, 16 );
+		if ( *lookup_hash == 0 || *end != 0 )
+		{
+			fprintf( stderr, "%s: The entry hash is not a hexadecimal value.\n", lookup_hash );
+			return 2;
+		}
+	}
+
+	if ( output_directory != NULL && mkdir( output_directory, 0755 ) != 0 && errno != EEXIST )
+	{
+		fprintf( stderr, "%s: %s\n", output_directory, strerror( errno ) );
+		return 1;
+	}
+
+	FILE *csv = NULL;
+	if ( csv_path != NULL )
+	{
+		csv = fopen( csv_path, "wb" );
+		if ( csv == NULL )
+		{
+			fprintf( stderr, "%s: %s\n", csv_path, strerror( errno ) );
+			return 1;
+		}
+
+		// Write the UTF-8 BOM and CSV column titles.
+		fputs( "\xEF\xBB\xBF" "Filename,Entry Size (bytes),Sector Index,Date Modified (UTC),FILETIME,System,Location", csv );
+	}
+
+	initialize_database_reader();
+
+	cli_context cc = { NULL, 0 };
+	database_callbacks dc = { &cc, NULL, NULL, NULL, cli_report_error };
+
+	unsigned long entry_count = 0;
+	unsigned long saved = 0;
+
+	entry_batch *batch = NULL;
+	if ( output_directory != NULL )
+	{
+		batch = ( entry_batch * )malloc( sizeof( entry_batch ) );
+		memset( batch, 0, sizeof( entry_batch ) );
+		for ( unsigned long i = 0; i < SAVE_BATCH_SIZE; ++i )
+		{
+			batch->entry_ptrs[ i ] = &batch->entries[ i ];
+		}
+	}
+
+	for ( int i = first_database; i < argc; ++i )
+	{
+		size_t path_length = mbstowcs( NULL, argv[ i ], 0 );
+		if ( path_length == ( size_t )-1 )
+		{
+			fprintf( stderr, "%s: The path could not be converted.\n", argv[ i ] );
+			++cc.error_count;
+			continue;
+		}
+
+		wchar_t *path = ( wchar_t * )malloc( sizeof( wchar_t ) * ( path_length + 1 ) );
+		mbstowcs( path, argv[ i ], path_length + 1 );
+
+		cc.dbpath = argv[ i ];
+
+		if ( lookup_hash != NULL )
+		{
+			list_locations( path, entry_hash, &dc );
+
+			cc.dbpath = NULL;
+
+			free( path );
+
+			continue;
+		}
+
+		// Each entry is written out as soon as it's read. Only a batch of entries is kept while they're being saved.
+		// It's a single entry unless the batch is read through io_uring.
+		entry_iterator ei;
+		if ( open_entry_iterator( path, &dc, &ei ) == SC_OK )
+		{
+			while ( next_entry( &ei ) == SC_OK )
+			{
+				++entry_count;
+
+				if ( csv != NULL )
+				{
+					write_csv_row( csv, &ei.fi );
+				}
+
+				if ( output_directory != NULL )
+				{
+					fileinfo *fi = &batch->entries[ batch->count++ ];
+					*fi = ei.fi;
+
+					unsigned long filename_length = wcslen( ei.fi.filename ) + 1;	// Include the NULL character.
+					fi->filename = ( wchar_t * )malloc( sizeof( wchar_t ) * filename_length );
+					wmemcpy( fi->filename, ei.fi.filename, filename_length );
+
+					if ( batch->count == SAVE_BATCH_SIZE )
+					{
+						saved += save_batch( batch, output_directory, &dc );
+					}
+				}
+
+				if ( csv == NULL && output_directory == NULL )
+				{
+					list_entry( &ei.fi );
+				}
+			}
+
+			// The entries share the iterator's database info.
+			if ( batch != NULL && batch->count > 0 )
+			{
+				saved += save_batch( batch, output_directory, &dc );
+			}
+
+			close_entry_iterator( &ei );
+		}
+
+		cc.dbpath = NULL;
+
+		free( path );
+	}
+
+	if ( csv != NULL )
+	{
+		if ( fclose( csv ) != 0 )
+		{
+			fprintf( stderr, "%s: %s\n", csv_path, strerror( errno ) );
+			++cc.error_count;
+		}
+	}
+
+	if ( output_directory != NULL )
+	{
+		fprintf( stderr, "%lu of %lu entries saved to %s\n", saved, entry_count, output_directory );
+	}
+
+	if ( batch != NULL )
+	{
+		for ( unsigned long i = 0; i < SAVE_BATCH_SIZE; ++i )
+		{
+			free( batch->buffers[ i ].buf );
+		}
+		free( batch );
+	}
+
+	uninitialize_database_reader();
+
+	return ( cc.error_count > 0 ? 1 : 0 );
+}
@@ -0,0 +1,2853 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "thumbs_db.h"
+#include "thumbcache.h"
+#include "crc64.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <process.h>
+#else
+	#include <unistd.h>
+#endif
+
+// Databases with a mapped view. The most recently used database is at the head.
+shared_info *g_map_head = NULL;
+shared_info *g_map_tail = NULL;
+unsigned long g_mapped_count = 0;
+unsigned long long g_mapped_size = 0;
+
+database_lock map_lock;		// Guards the list of mapped databases.
+
+void initialize_lock( database_lock *lock )
+{
+#ifdef _WIN32
+	InitializeCriticalSection( lock );
+#else
+	pthread_mutex_init( lock, NULL );
+#endif
+}
+
+void delete_lock( database_lock *lock )
+{
+#ifdef _WIN32
+	DeleteCriticalSection( lock );
+#else
+	pthread_mutex_destroy( lock );
+#endif
+}
+
+void enter_lock( database_lock *lock )
+{
+#ifdef _WIN32
+	EnterCriticalSection( lock );
+#else
+	pthread_mutex_lock( lock );
+#endif
+}
+
+void leave_lock( database_lock *lock )
+{
+#ifdef _WIN32
+	LeaveCriticalSection( lock );
+#else
+	pthread_mutex_unlock( lock );
+#endif
+}
+
+void initialize_database_reader()
+{
+	initialize_lock( &map_lock );
+
+	// Thumbcache checksums are verified from the worker threads.
+	initialize_crc64();
+}
+
+void uninitialize_database_reader()
+{
+	delete_lock( &map_lock );
+}
+
+void report_error( database_callbacks *dc, const char *message )
+{
+	if ( dc != NULL && dc->report_error != NULL )
+	{
+		dc->report_error( dc->context, message );
+	}
+}
+
+bool is_cancelled( database_callbacks *dc )
+{
+	return ( dc != NULL && dc->is_cancelled != NULL && dc->is_cancelled( dc->context ) == true );
+}
+
+// Converts a little-endian UTF-16 string of at most length characters into wide_string, which must hold length + 1 characters.
+// wchar_t is UTF-32 on Linux, so surrogate pairs are combined there.
+// Returns the number of characters, excluding the NULL character.
+unsigned long convert_utf16_string( const char *string, unsigned long length, wchar_t *wide_string )
+{
+	unsigned long wide_length = 0;
+
+	for ( unsigned long i = 0; i < length; ++i )
+	{
+		unsigned int c = ( unsigned char )string[ i * 2 ] | ( ( unsigned char )string[ ( i * 2 ) + 1 ] << 8 );
+		if ( c == 0 )
+		{
+			break;
+		}
+
+		if ( sizeof( wchar_t ) > 2 && c >= 0xD800 && c <= 0xDBFF && i + 1 < length )
+		{
+			unsigned int c2 = ( unsigned char )string[ ( i + 1 ) * 2 ] | ( ( unsigned char )string[ ( ( i + 1 ) * 2 ) + 1 ] << 8 );
+			if ( c2 >= 0xDC00 && c2 <= 0xDFFF )
+			{
+				c = 0x10000 + ( ( c - 0xD800 ) << 10 ) + ( c2 - 0xDC00 );
+				++i;
+			}
+		}
+
+		wide_string[ wide_length++ ] = ( wchar_t )c;
+	}
+
+	wide_string[ wide_length ] = 0;	// Sanity.
+
+	return wide_length;
+}
+
+// Copies a little-endian UTF-16 string of at most length characters into a new wide character string.
+wchar_t *copy_utf16_string( const char *string, unsigned long length )
+{
+	wchar_t *wide_string = ( wchar_t * )malloc( sizeof( wchar_t ) * ( length + 1 ) );
+	convert_utf16_string( string, length, wide_string );
+
+	return wide_string;
+}
+
+// Allocations are aligned to 8 bytes.
+void *arena_alloc( shared_info *si, unsigned long size )
+{
+	size = ( size + 7 ) & ~7UL;
+
+	arena_block *block = si->arena;
+	if ( block == NULL || block->size - block->used < size )
+	{
+		unsigned long block_size = ( size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE );
+
+		// The header is a multiple of 8 bytes, so the data that follows it stays aligned.
+		block = ( arena_block * )malloc( sizeof( arena_block ) + block_size );
+		block->next = si->arena;
+		block->size = block_size;
+		block->used = 0;
+		si->arena = block;
+	}
+
+	void *p = ( char * )( block + 1 ) + block->used;
+	block->used += size;
+
+	return p;
+}
+
+// Gives back the end of the most recent allocation if it wasn't all used.
+void arena_shrink( shared_info *si, void *p, unsigned long old_size, unsigned long new_size )
+{
+	arena_block *block = si->arena;
+	old_size = ( old_size + 7 ) & ~7UL;
+	new_size = ( new_size + 7 ) & ~7UL;
+
+	if ( block != NULL && ( char * )p + old_size == ( char * )( block + 1 ) + block->used )
+	{
+		block->used -= ( old_size - new_size );
+	}
+}
+
+void free_arena( shared_info *si )
+{
+	while ( si->arena != NULL )
+	{
+		arena_block *next = si->arena->next;
+		free( si->arena );
+		si->arena = next;
+	}
+}
+
+// Same as copy_utf16_string, but the string is held by the database's arena.
+wchar_t *copy_utf16_string_arena( shared_info *si, const char *string, unsigned long length )
+{
+	wchar_t *wide_string = ( wchar_t * )arena_alloc( si, sizeof( wchar_t ) * ( length + 1 ) );
+	unsigned long wide_length = convert_utf16_string( string, length, wide_string );
+
+	arena_shrink( si, wide_string, sizeof( wchar_t ) * ( length + 1 ), sizeof( wchar_t ) * ( wide_length + 1 ) );
+
+	return wide_string;
+}
+
+// Removes the database from the list of mapped databases and unmaps its view.
+// map_lock must be held.
+void unlink_database_map( shared_info *si )
+{
+	if ( si->map_prev != NULL )
+	{
+		si->map_prev->map_next = si->map_next;
+	}
+	else
+	{
+		g_map_head = si->map_next;
+	}
+
+	if ( si->map_next != NULL )
+	{
+		si->map_next->map_prev = si->map_prev;
+	}
+	else
+	{
+		g_map_tail = si->map_prev;
+	}
+
+	si->map_prev = NULL;
+	si->map_next = NULL;
+
+	--g_mapped_count;
+	g_mapped_size -= si->fm.size;
+
+	unmap_file( &si->fm );
+}
+
+// Unmaps the least recently used views that aren't in use until we're within our limits.
+// map_lock must be held.
+void evict_database_maps()
+{
+	shared_info *si = g_map_tail;
+	while ( si != NULL && ( g_mapped_count > MAX_MAPPED_DATABASES || g_mapped_size > MAX_MAPPED_SIZE ) )
+	{
+		shared_info *prev = si->map_prev;
+
+		if ( si->map_refs == 0 )
+		{
+			unlink_database_map( si );
+		}
+
+		si = prev;
+	}
+}
+
+// Returns the database's view, mapping it if it's not already mapped.
+// Each successful call must be paired with a call to release_database_map.
+file_map *acquire_database_map( shared_info *si )
+{
+	file_map *fm = NULL;
+
+	enter_lock( &map_lock );
+
+	if ( si->fm.base == NULL )
+	{
+		if ( map_file( &si->fm, si->dbpath ) == true && si->fm.base != NULL )
+		{
+			++g_mapped_count;
+			g_mapped_size += si->fm.size;
+
+			// Add it to the head of the list.
+			si->map_prev = NULL;
+			si->map_next = g_map_head;
+			if ( g_map_head != NULL )
+			{
+				g_map_head->map_prev = si;
+			}
+			g_map_head = si;
+			if ( g_map_tail == NULL )
+			{
+				g_map_tail = si;
+			}
+		}
+	}
+	else if ( si != g_map_head )
+	{
+		// Move it to the head of the list.
+		si->map_prev->map_next = si->map_next;
+		if ( si->map_next != NULL )
+		{
+			si->map_next->map_prev = si->map_prev;
+		}
+		else
+		{
+			g_map_tail = si->map_prev;
+		}
+
+		si->map_prev = NULL;
+		si->map_next = g_map_head;
+		g_map_head->map_prev = si;
+		g_map_head = si;
+	}
+
+	if ( si->fm.base != NULL )
+	{
+		++si->map_refs;
+		fm = &si->fm;
+
+		evict_database_maps();
+	}
+
+	leave_lock( &map_lock );
+
+	return fm;
+}
+
+// The view can be evicted once there are no more references to it.
+void release_database_map( shared_info *si )
+{
+	enter_lock( &map_lock );
+
+	if ( si->map_refs > 0 )
+	{
+		--si->map_refs;
+	}
+
+	evict_database_maps();
+
+	leave_lock( &map_lock );
+}
+
+// Unmaps the view when the shared_info is about to be freed.
+void close_database_map( shared_info *si )
+{
+	enter_lock( &map_lock );
+
+	if ( si->fm.base != NULL )
+	{
+		unlink_database_map( si );
+	}
+
+	leave_lock( &map_lock );
+}
+
+void free_chains( dllrbt_tree *chains )
+{
+	node_type *node = dllrbt_get_head( chains );
+	while ( node != NULL )
+	{
+		sector_chain *chain = ( sector_chain * )node->val;
+		free( chain->sectors );
+		free( chain );
+
+		node = node->next;
+	}
+
+	dllrbt_delete_recursively( chains );
+}
+
+void cleanup_shared_info( shared_info **si )
+{
+	close_database_map( *si );
+
+	// The short stream container's chain belongs to the cache if chains are being cached.
+	if ( ( *si )->short_stream_chain != NULL && ( *si )->short_stream_chain->cached == false )
+	{
+		free( ( *si )->short_stream_chain->sectors );
+		free( ( *si )->short_stream_chain );
+	}
+
+	free( ( *si )->ssat );
+	free( ( *si )->sat );
+	free( ( *si )->dbpath );
+
+	if ( ( *si )->sat_chains != NULL )
+	{
+		free_chains( ( *si )->sat_chains );
+	}
+	if ( ( *si )->ssat_chains != NULL )
+	{
+		free_chains( ( *si )->ssat_chains );
+	}
+	free( ( *si )->sat_visited );
+	free( ( *si )->ssat_visited );
+	delete_lock( &( *si )->chain_lock );
+
+	// Every entry and name in the arena goes with it.
+	free_arena( *si );
+
+	free( *si );
+	*si = NULL;
+}
+
+void free_fileinfo( fileinfo *fi )
+{
+	shared_info *si = fi->si;
+
+	// Anything that was allocated on its own is freed now. The rest goes with the arena.
+	if ( !( fi->flag & FIF_ARENA_NAME ) )
+	{
+		free( fi->filename );
+	}
+
+	if ( !( fi->flag & FIF_ARENA_ENTRY ) )
+	{
+		free( fi );
+	}
+
+	if ( si != NULL )
+	{
+		--( si->count );
+
+		if ( si->count == 0 )
+		{
+			cleanup_shared_info( &si );
+		}
+	}
+}
+
+// Returns a pointer to the sector at index within the mapped database.
+// available is set to the number of bytes (up to length) that can be read before the end of the file is reached.
+char *get_sector( file_map *fm, unsigned short sect_size, long index, unsigned long length, unsigned long &available )
+{
+	available = 0;
+
+	if ( index < 0 || fm->base == NULL )
+	{
+		return ( char * )fm->base;
+	}
+
+	// The first sector follows the header, which is the size of a sector.
+	unsigned long long offset = ( unsigned long long )sect_size + ( ( unsigned long long )index * sect_size );
+	if ( offset >= fm->size )
+	{
+		return ( char * )fm->base;
+	}
+
+	available = ( offset + length > fm->size ? ( unsigned long )( fm->size - offset ) : length );
+
+	return ( char * )fm->base + offset;
+}
+
+int chain_compare( void *a, void *b )
+{
+	if ( a > b )
+	{
+		return 1;
+	}
+
+	if ( a < b )
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+// Follows the chain that begins at first_sect until it ends, leaves the table, or loops back on itself.
+// visited must be all zero. It's cleared again before returning.
+sector_chain *resolve_chain( const int *table, unsigned long table_count, unsigned char *visited, long first_sect, bool is_short )
+{
+	sector_chain *chain = ( sector_chain * )malloc( sizeof( sector_chain ) );
+	chain->sectors = NULL;
+	chain->count = 0;
+	chain->error = NULL;
+	chain->cached = false;
+
+	unsigned long sectors_size = 0;
+	long index = first_sect;
+
+	// The chain should terminate with -2.
+	while ( index != -2 )
+	{
+		if ( index < 0 )
+		{
+			chain->error = ( is_short == true ? "Invalid Short SAT termination index." : "Invalid SAT termination index." );
+			break;
+		}
+
+		// Each index should be less than the size of the table.
+		if ( ( unsigned long )index >= table_count )
+		{
+			chain->error = ( is_short == true ? "Short SAT index out of bounds." : "SAT index out of bounds." );
+			break;
+		}
+
+		// A sector can only appear once in a chain.
+		if ( visited[ index >> 3 ] & ( 1 << ( index & 7 ) ) )
+		{
+			chain->error = ( is_short == true ? "The Short SAT chain loops back on itself." : "The SAT chain loops back on itself." );
+			break;
+		}
+
+		visited[ index >> 3 ] |= ( 1 << ( index & 7 ) );
+
+		if ( chain->count == sectors_size )
+		{
+			sectors_size = ( sectors_size == 0 ? 16 : sectors_size * 2 );
+			chain->sectors = ( int * )realloc( chain->sectors, sizeof( int ) * sectors_size );
+		}
+		chain->sectors[ chain->count++ ] = index;
+
+		// Each index points to the next index.
+		index = table[ index ];
+	}
+
+	for ( unsigned long i = 0; i < chain->count; ++i )
+	{
+		visited[ chain->sectors[ i ] >> 3 ] = 0;
+	}
+
+	return chain;
+}
+
+// Returns the chain of the stream that begins at first_sect. It's resolved the first time it's used.
+// release_chain must be called once the chain is no longer needed.
+sector_chain *get_chain( shared_info *si, long first_sect, bool is_short )
+{
+	int *table = ( is_short == true ? si->ssat : si->sat );
+	if ( table == NULL )
+	{
+		return NULL;
+	}
+
+	unsigned long table_count = ( is_short == true ? si->num_ssat_sects : si->num_sat_sects ) * ( si->sect_size / sizeof( int ) );
+	dllrbt_tree **chains = ( is_short == true ? &si->ssat_chains : &si->sat_chains );
+	unsigned char **visited = ( is_short == true ? &si->ssat_visited : &si->sat_visited );
+
+	sector_chain *chain = NULL;
+
+	enter_lock( &si->chain_lock );
+
+	if ( si->cache_chains == true && *chains != NULL )
+	{
+		chain = ( sector_chain * )dllrbt_find( *chains, ( void * )( size_t )first_sect, true );
+	}
+
+	if ( chain == NULL )
+	{
+		if ( *visited == NULL )
+		{
+			*visited = ( unsigned char * )malloc( sizeof( unsigned char ) * ( ( table_count + 7 ) / 8 ) );
+			memset( *visited, 0, sizeof( unsigned char ) * ( ( table_count + 7 ) / 8 ) );
+		}
+
+		chain = resolve_chain( table, table_count, *visited, first_sect, is_short );
+
+		if ( si->cache_chains == true )
+		{
+			if ( *chains == NULL )
+			{
+				*chains = dllrbt_create( chain_compare );
+			}
+
+			if ( dllrbt_insert( *chains, ( void * )( size_t )first_sect, chain ) == DLLRBT_STATUS_OK )
+			{
+				chain->cached = true;
+			}
+		}
+	}
+
+	leave_lock( &si->chain_lock );
+
+	return chain;
+}
+
+// Frees the chain unless it belongs to the cache.
+void release_chain( sector_chain *chain )
+{
+	if ( chain != NULL && chain->cached == false )
+	{
+		free( chain->sectors );
+		free( chain );
+	}
+}
+
+// Describes why the chain is shorter than the stream that uses it.
+const char *get_chain_error( sector_chain *chain, bool is_short )
+{
+	if ( chain != NULL && chain->error != NULL )
+	{
+		return chain->error;
+	}
+
+	return ( is_short == true ? "Invalid Short SAT termination index." : "Invalid SAT termination index." );
+}
+
+// Copies from the short stream container. It's read in place through the root entry's chain of sectors.
+// Anything beyond what could be read from the file is zero filled.
+void read_short_stream( file_map *fm, shared_info *si, unsigned long offset, char *buf, unsigned long length )
+{
+	unsigned long sect_size = si->sect_size;
+
+	while ( length > 0 )
+	{
+		unsigned long sector_offset = offset % sect_size;
+		unsigned long run_length = sect_size - sector_offset;
+		if ( run_length > length )
+		{
+			run_length = length;
+		}
+
+		unsigned long read = 0;
+		if ( offset < si->short_stream_readable && fm != NULL )
+		{
+			unsigned long readable = si->short_stream_readable - offset;
+
+			char *sector = get_sector( fm, si->sect_size, si->short_stream_chain->sectors[ offset / sect_size ], sector_offset + ( run_length < readable ? run_length : readable ), read );
+			read = ( read > sector_offset ? read - sector_offset : 0 );
+			memcpy( buf, sector + sector_offset, read );
+		}
+		memset( buf + read, 0, run_length - read );
+
+		buf += run_length;
+		offset += run_length;
+		length -= run_length;
+	}
+}
+
+// Copies length bytes, beginning offset bytes into the stream, into buf.
+// The sector that holds any offset is found directly from the chain. Sectors that are physically consecutive are copied as a single run.
+// total is set to the number of bytes that were copied.
+char read_chain( file_map *fm, shared_info *g_si, sector_chain *chain, bool is_short, unsigned long offset, char *buf, unsigned long length, unsigned long &total, const char *eof_message, database_callbacks *dc )
+{
+	unsigned long sector_size = ( is_short == true ? 64 : g_si->sect_size );
+	unsigned long position = offset / sector_size;		// Position of the sector within the chain.
+	unsigned long sector_offset = offset % sector_size;	// Only the first sector can be read from somewhere other than its beginning.
+
+	total = 0;
+
+	while ( total < length )
+	{
+		// Stop processing and exit the thread.
+		if ( is_cancelled( dc ) == true )
+		{
+			return SC_QUIT;
+		}
+
+		// The chain ended before the stream did.
+		if ( chain == NULL || position >= chain->count )
+		{
+			report_error( dc, get_chain_error( chain, is_short ) );
+			return SC_FAIL;
+		}
+
+		// Extend the run for as long as the next sector in the chain immediately follows the current one.
+		long run_start = chain->sectors[ position ];
+		unsigned long run_length = sector_size - sector_offset;
+		while ( total + run_length < length && position + 1 < chain->count && chain->sectors[ position + 1 ] == chain->sectors[ position ] + 1 )
+		{
+			++position;
+			run_length += sector_size;
+		}
+
+		if ( total + run_length > length )
+		{
+			run_length = length - total;
+		}
+
+		if ( is_short == true )
+		{
+			// The short sectors have to be within the container.
+			unsigned long long container_offset = ( ( unsigned long long )run_start * 64 ) + sector_offset;
+			if ( container_offset + run_length > g_si->short_stream_length )
+			{
+				report_error( dc, "Short SAT index out of bounds." );
+				return SC_FAIL;
+			}
+
+			read_short_stream( fm, g_si, ( unsigned long )container_offset, buf + total, run_length );
+			total += run_length;
+		}
+		else
+		{
+			unsigned long read = 0;
+			char *sector = get_sector( fm, g_si->sect_size, run_start, sector_offset + run_length, read );
+			read = ( read > sector_offset ? read - sector_offset : 0 );
+			memcpy( buf + total, sector + sector_offset, read );
+			total += read;
+
+			if ( read < run_length )
+			{
+				report_error( dc, eof_message );
+				return SC_FAIL;
+			}
+		}
+
+		sector_offset = 0;
+		++position;
+	}
+
+	return SC_OK;
+}
+
+// Copies a stream that's stored in the SAT into buf.
+// total is set to the number of bytes that were copied.
+char read_sat_stream( file_map *fm, shared_info *g_si, long sat_index, char *buf, unsigned long length, unsigned long &total, const char *eof_message, database_callbacks *dc )
+{
+	sector_chain *chain = get_chain( g_si, sat_index, false );
+
+	char status = read_chain( fm, g_si, chain, false, 0, buf, length, total, eof_message, dc );
+
+	release_chain( chain );
+
+	return status;
+}
+
+// Copies a stream that's stored in the short stream container into buf.
+// total is set to the number of bytes that were copied.
+char read_ssat_stream( file_map *fm, shared_info *g_si, long ssat_index, char *buf, unsigned long length, unsigned long &total, database_callbacks *dc )
+{
+	sector_chain *chain = get_chain( g_si, ssat_index, true );
+
+	char status = read_chain( fm, g_si, chain, true, 0, buf, length, total, NULL, dc );
+
+	release_chain( chain );
+
+	return status;
+}
+
+// Reconstructs the JPEG header if the stream has a second header, and sets the entry's type if it hasn't been set.
+// total is the number of bytes of the stream that are in buf.
+char *finish_entry( fileinfo *fi, char *buf, unsigned long total, unsigned long &size, unsigned long &header_offset )
+{
+	header_offset = 0;
+	if ( total > sizeof( unsigned int ) )
+	{
+		unsigned int header_length = 0;
+		memcpy( &header_length, buf, sizeof( unsigned int ) );
+		header_offset = header_length;
+
+		if ( header_offset > total )
+		{
+			header_offset = 0;
+		}
+	}
+
+	size = total - header_offset;
+
+	// See if there's a second header.
+	// The first header will look like this:
+	// Header length (4 bytes) - I wonder if this value also dictates the content type?
+	// Some value (4 bytes)
+	// Content length (4 bytes)
+	if ( size > 2 && memcmp( buf + header_offset, "\xFF\xD8", 2 ) != 0 )
+	{
+		// Second header exists. Reconstruct the image.
+		// The second header will look like this:
+		// Some value (4 bytes)
+		// Content length (4 bytes)
+		// Image width (4 bytes)
+		// Image height (4 bytes)
+		unsigned int second_header = 0;
+		memcpy( &second_header, buf + header_offset, ( size < sizeof( unsigned int ) ? size : sizeof( unsigned int ) ) );
+		if ( second_header == 1 && total > 52 )
+		{
+			// Move the image data and the 22 bytes we keep from the header before the tables are written over them.
+			memmove( buf + 396, buf + 52, total - 52 );
+			memmove( buf + 158, buf + 30, 22 );
+
+			memcpy( buf, jfif_header, 20 );
+			memcpy( buf + 20, quantization, 138 );
+			memcpy( buf + 180, huffman_table, 216 );
+
+			header_offset = 0;
+
+			size = total + 374 - 30;
+
+			fi->flag |= FIF_TYPE_CMYK_JPG;
+		}
+	}
+
+	// Set the extension if none has been set.
+	if ( !( fi->flag & 0x0F ) )	// Mask the first 4 bits to see if an extension has been set.
+	{
+		// Detect the file extension and copy it into the filename string.
+		if ( size > 4 && memcmp( buf + header_offset, FILE_TYPE_JPEG, 4 ) == 0 )		// First 4 bytes
+		{
+			fi->flag |= FIF_TYPE_JPG;
+		}
+		else if ( size > 8 && memcmp( buf + header_offset, FILE_TYPE_PNG, 8 ) == 0 )	// First 8 bytes
+		{
+			fi->flag |= FIF_TYPE_PNG;
+		}
+		else
+		{
+			fi->flag |= FIF_TYPE_UNKNOWN;
+		}
+	}
+
+	return buf;
+}
+
+// Reads the entry's stream into buf and reconstructs its JPEG header if it has a second header.
+// buf is only reallocated when it's too small, so it can be reused from one entry to the next.
+// Returns NULL if the entry has no stream that can be read.
+char *read_entry( fileinfo *fi, char *&buf, unsigned long &buf_size, unsigned long &size, unsigned long &header_offset, database_callbacks *dc )
+{
+	unsigned long total = 0;
+	bool stream_read = false;
+
+	if ( fi == NULL || ( fi != NULL && fi->si == NULL ) )
+	{
+		return NULL;
+	}
+
+	if ( fi->si->database_type == DATABASE_TYPE_CACHE )
+	{
+		return read_cache_entry( fi, buf, buf_size, size, header_offset, dc );
+	}
+
+	if ( fi->entry_type == 2 )
+	{
+		// Leave enough room to reconstruct the JPEG header in place.
+		unsigned long required_size = fi->size + 374 - 30;
+
+		// See if the stream is in the SAT.
+		if ( fi->size >= fi->si->short_sect_cutoff && fi->si->sat != NULL )
+		{
+			// Get the cached view of the database. It'll be mapped if it isn't already.
+			file_map *fm = acquire_database_map( fi->si );
+			if ( fm == NULL )
+			{
+				return NULL;
+			}
+
+			sector_chain *chain = get_chain( fi->si, fi->offset, false );
+
+			// A corrupt entry can claim to be much larger than its chain. We don't need more room than the chain can fill.
+			unsigned long length = fi->size;
+			if ( chain != NULL && ( unsigned long long )chain->count * fi->si->sect_size < length )
+			{
+				length = chain->count * fi->si->sect_size;
+				required_size = length + 374 - 30;
+			}
+
+			if ( required_size > buf_size )
+			{
+				free( buf );
+				buf = ( char * )malloc( sizeof( char ) * required_size );
+				buf_size = required_size;
+			}
+			memset( buf, 0, sizeof( char ) * length );
+
+			// Any partial stream that was read before an error is still returned.
+			if ( read_chain( fm, fi->si, chain, false, 0, buf, length, total, "Premature end of file encountered while extracting the file.", dc ) == SC_OK && length < fi->size )
+			{
+				report_error( dc, get_chain_error( chain, false ) );
+			}
+
+			release_chain( chain );
+
+			release_database_map( fi->si );
+
+			stream_read = true;
+		}
+		else if ( fi->si->short_stream_chain != NULL && fi->si->ssat != NULL )	// Stream is in the short stream.
+		{
+			// The short stream container is read from the view.
+			file_map *fm = acquire_database_map( fi->si );
+			if ( fm == NULL )
+			{
+				return NULL;
+			}
+
+			if ( required_size > buf_size )
+			{
+				free( buf );
+				buf = ( char * )malloc( sizeof( char ) * required_size );
+				buf_size = required_size;
+			}
+			memset( buf, 0, sizeof( char ) * fi->size );
+
+			read_ssat_stream( fm, fi->si, fi->offset, buf, fi->size, total, dc );
+
+			release_database_map( fi->si );
+
+			// The short stream is zero filled, so the whole entry is used.
+			total = fi->size;
+
+			stream_read = true;
+		}
+	}
+
+	if ( stream_read == false )
+	{
+		return NULL;
+	}
+
+	return finish_entry( fi, buf, total, size, header_offset );
+}
+
+// Extract the file from the SAT or short stream container. The returned buffer must be freed.
+char *extract_entry( fileinfo *fi, unsigned long &size, unsigned long &header_offset, database_callbacks *dc )
+{
+	char *buf = NULL;
+	unsigned long buf_size = 0;
+
+	if ( read_entry( fi, buf, buf_size, size, header_offset, dc ) == NULL )
+	{
+		free( buf );
+		buf = NULL;
+	}
+
+	return buf;
+}
+
+#ifdef USE_IO_URING
+// Grows the entry's buffer and adds a request for each run of consecutive sectors in its chain.
+// Returns false if the entry can't be read this way. It's left for read_entry, which will report why.
+bool queue_entry_reads( fileinfo *fi, entry_buffer *eb, read_request *&requests, unsigned long &request_count, unsigned long &requests_size )
+{
+	sector_chain *chain = get_chain( fi->si, fi->offset, false );
+	if ( chain == NULL || ( unsigned long long )chain->count * fi->si->sect_size < fi->size )
+	{
+		release_chain( chain );
+
+		return false;
+	}
+
+	// Leave enough room to reconstruct the JPEG header in place.
+	unsigned long required_size = fi->size + 374 - 30;
+	if ( required_size > eb->buf_size )
+	{
+		free( eb->buf );
+		eb->buf = ( char * )malloc( sizeof( char ) * required_size );
+		eb->buf_size = required_size;
+	}
+
+	unsigned long total = 0;
+	unsigned long position = 0;
+	while ( total < fi->size )
+	{
+		// Extend the run for as long as the next sector in the chain immediately follows the current one.
+		long run_start = chain->sectors[ position ];
+		unsigned long run_length = fi->si->sect_size;
+		while ( total + run_length < fi->size && position + 1 < chain->count && chain->sectors[ position + 1 ] == chain->sectors[ position ] + 1 )
+		{
+			++position;
+			run_length += fi->si->sect_size;
+		}
+
+		if ( total + run_length > fi->size )
+		{
+			run_length = fi->size - total;
+		}
+
+		if ( request_count == requests_size )
+		{
+			requests_size = ( requests_size == 0 ? 64 : requests_size * 2 );
+			requests = ( read_request * )realloc( requests, sizeof( read_request ) * requests_size );
+		}
+
+		// The first sector follows the header, which is the size of a sector.
+		read_request *request = &requests[ request_count++ ];
+		request->offset = ( unsigned long long )fi->si->sect_size + ( ( unsigned long long )run_start * fi->si->sect_size );
+		request->buf = eb->buf + total;
+		request->length = run_length;
+		request->read = 0;
+
+		total += run_length;
+		++position;
+	}
+
+	release_chain( chain );
+
+	return true;
+}
+#endif
+
+// Reads a batch of entries, each into its own buffer. The buffers are reused from one batch to the next.
+// When built with USE_IO_URING, every read of the entries that are stored in the SAT is submitted at once and completes in any order.
+// Entries that can't be read that way, and every entry otherwise, are read one after another from the mapped view.
+char read_entries( fileinfo **entries, unsigned long count, entry_buffer *ebs, database_callbacks *dc )
+{
+	if ( entries == NULL || ebs == NULL )
+	{
+		return SC_FAIL;
+	}
+
+#ifdef USE_IO_URING
+	read_request *requests = NULL;
+	unsigned long request_count = 0;
+	unsigned long requests_size = 0;
+
+	// The first request of each entry that was queued. The entry's last request is just before the next entry's first.
+	unsigned long *first_request = ( unsigned long * )malloc( sizeof( unsigned long ) * ( count + 1 ) );
+	bool *queued = ( bool * )malloc( sizeof( bool ) * count );
+
+	// The reads are all made from one file. Entries from another database are read from their mapped view.
+	shared_info *batch_si = NULL;
+#endif
+
+	char status = SC_OK;
+
+	for ( unsigned long i = 0; i < count; ++i )
+	{
+		fileinfo *fi = entries[ i ];
+		entry_buffer *eb = &ebs[ i ];
+
+		eb->data = NULL;
+		eb->size = 0;
+		eb->header_offset = 0;
+
+#ifdef USE_IO_URING
+		first_request[ i ] = request_count;
+		queued[ i ] = false;
+#endif
+
+		if ( status == SC_QUIT || is_cancelled( dc ) == true )
+		{
+			status = SC_QUIT;
+			continue;
+		}
+
+#ifdef USE_IO_URING
+		if ( fi != NULL && fi->si != NULL && fi->entry_type == 2 && fi->size >= fi->si->short_sect_cutoff && fi->si->sat != NULL && ( batch_si == NULL || batch_si == fi->si ) )
+		{
+			if ( queue_entry_reads( fi, eb, requests, request_count, requests_size ) == true )
+			{
+				batch_si = fi->si;
+				queued[ i ] = true;
+
+				continue;
+			}
+		}
+#endif
+
+		eb->data = read_entry( fi, eb->buf, eb->buf_size, eb->size, eb->header_offset, dc );
+	}
+
+#ifdef USE_IO_URING
+	first_request[ count ] = request_count;
+
+	bool batch_read = false;
+	if ( status != SC_QUIT && request_count > 0 )
+	{
+		batch_read = read_ranges( batch_si->dbpath, requests, request_count );
+	}
+
+	for ( unsigned long i = 0; i < count; ++i )
+	{
+		if ( queued[ i ] == false || status == SC_QUIT )
+		{
+			continue;
+		}
+
+		entry_buffer *eb = &ebs[ i ];
+
+		bool complete = batch_read;
+		for ( unsigned long j = first_request[ i ]; j < first_request[ i + 1 ] && complete == true; ++j )
+		{
+			complete = ( requests[ j ].read == requests[ j ].length );
+		}
+
+		if ( complete == true )
+		{
+			eb->data = finish_entry( entries[ i ], eb->buf, entries[ i ]->size, eb->size, eb->header_offset );
+		}
+		else	// Let read_entry deal with the end of the file.
+		{
+			eb->data = read_entry( entries[ i ], eb->buf, eb->buf_size, eb->size, eb->header_offset, dc );
+		}
+	}
+
+	free( queued );
+	free( first_request );
+	free( requests );
+#endif
+
+	return status;
+}
+
+// The entry number needs to be multiplied by 10 if the version is 1.
+unsigned long long get_catalog_sid_number( unsigned short version, unsigned int entry_num )
+{
+	return ( version == 1 ? ( unsigned long long )entry_num * 10 : entry_num );
+}
+
+// There's no documentation on this and it's difficult to find test cases. Anyone want to install Windows Me? I didn't think so.
+// I can't refine this until I get test cases, but this should suffice for now.
+unsigned char get_catalog_system( unsigned short version, const wchar_t *filename )
+{
+	switch ( version )
+	{
+		case 4:	// 2000?
+		{
+			return 1;	// Me, 2000
+		}
+		break;
+
+		case 1: // Windows Media Center edition (XP, Vista, 7) has ehthumbs.db, ehthumbs_vista.db, Image.db, Video.db, etc. Are there version 1 databases not found on WMC systems?
+		case 5:	// XP - no SP?
+		case 6:	// XP - SP1?
+		case 7:	// XP - SP2+?
+		{
+			return 2;	// XP, 2003
+		}
+		break;
+	}
+
+	// Fall back to our old method of detection.
+	// See if the filename contains a path. ":\" should be enough to signify a path.
+	if ( filename != NULL && wcslen( filename ) > 2 && filename[ 1 ] == L':' && filename[ 2 ] == L'\\' )
+	{
+		return 1;	// Me, 2000
+	}
+
+	return 2;	// XP, 2003
+}
+
+#define SID_NONE	0xFFFFFFFFFFFFFFFFULL	// The name isn't a sid.
+
+// Finds directory entries by the number in their sid. It's an open addressing table. Entries that share a sid are linked in the order they appear.
+struct sid_index
+{
+	unsigned long long *slot_keys;	// SID_NONE if the slot is empty.
+	unsigned long *slot_entries;	// First entry with the slot's sid, plus one. 0 if there isn't one.
+	unsigned long slot_count;		// Always a power of 2.
+	unsigned long key_count;		// Number of slots that have a key.
+
+	unsigned long long *entry_keys;	// The sid of each entry.
+	unsigned long *next_entries;	// Next entry with the same sid, plus one. 0 if there isn't one.
+	unsigned long entry_count;
+};
+
+// The sid of a catalog entry's stream is the number from get_catalog_sid_number with its digits reversed.
+// Returns the number that the name was made from, or SID_NONE if no entry number can produce it.
+// Comparing these numbers gives the same result as comparing the names.
+unsigned long long get_sid_number( const wchar_t *name )
+{
+	unsigned long length = wcslen( name );
+
+	// The largest sid has 11 digits. Digits are reversed, so the last one can't be 0 unless it's the only one.
+	if ( length == 0 || length > 11 || ( length > 1 && name[ length - 1 ] == L'0' ) )
+	{
+		return SID_NONE;
+	}
+
+	unsigned long long sid_num = 0;
+	while ( length > 0 )
+	{
+		wchar_t c = name[ --length ];
+		if ( c < L'0' || c > L'9' )
+		{
+			return SID_NONE;
+		}
+
+		sid_num = ( sid_num * 10 ) + ( c - L'0' );
+	}
+
+	return sid_num;
+}
+
+unsigned long get_sid_slot( sid_index *index, unsigned long long sid_num )
+{
+	unsigned long mask = index->slot_count - 1;
+	unsigned long slot = ( unsigned long )( ( sid_num * 0x9E3779B97F4A7C15ULL ) >> 32 ) & mask;
+
+	// Keys are never removed from the slots, so the first empty slot ends the search.
+	while ( index->slot_keys[ slot ] != SID_NONE && index->slot_keys[ slot ] != sid_num )
+	{
+		slot = ( slot + 1 ) & mask;
+	}
+
+	return slot;
+}
+
+void resize_sid_index( sid_index *index, unsigned long slot_count )
+{
+	unsigned long long *old_keys = index->slot_keys;
+	unsigned long *old_entries = index->slot_entries;
+	unsigned long old_count = index->slot_count;
+
+	index->slot_keys = ( unsigned long long * )malloc( sizeof( unsigned long long ) * slot_count );
+	index->slot_entries = ( unsigned long * )malloc( sizeof( unsigned long ) * slot_count );
+	index->slot_count = slot_count;
+	memset( index->slot_keys, 0xFF, sizeof( unsigned long long ) * slot_count );	// SID_NONE
+	memset( index->slot_entries, 0, sizeof( unsigned long ) * slot_count );
+
+	for ( unsigned long i = 0; i < old_count; ++i )
+	{
+		if ( old_keys[ i ] != SID_NONE )
+		{
+			unsigned long slot = get_sid_slot( index, old_keys[ i ] );
+			index->slot_keys[ slot ] = old_keys[ i ];
+			index->slot_entries[ slot ] = old_entries[ i ];
+		}
+	}
+
+	free( old_keys );
+	free( old_entries );
+}
+
+// Sets the sid of the entry at position and adds it to the entries that share that sid. They're kept in position order.
+void add_sid_entry( sid_index *index, unsigned long position, unsigned long long sid_num )
+{
+	index->entry_keys[ position ] = sid_num;
+	index->next_entries[ position ] = 0;
+
+	if ( sid_num == SID_NONE )
+	{
+		return;
+	}
+
+	// Keep the slots at most half full.
+	if ( ( index->key_count + 1 ) * 2 > index->slot_count )
+	{
+		resize_sid_index( index, index->slot_count * 2 );
+	}
+
+	unsigned long slot = get_sid_slot( index, sid_num );
+	if ( index->slot_keys[ slot ] == SID_NONE )
+	{
+		index->slot_keys[ slot ] = sid_num;
+		++index->key_count;
+	}
+
+	unsigned long *link = &index->slot_entries[ slot ];
+	while ( *link != 0 && *link - 1 < position )
+	{
+		link = &index->next_entries[ *link - 1 ];
+	}
+
+	index->next_entries[ position ] = *link;
+	*link = position + 1;
+}
+
+void remove_sid_entry( sid_index *index, unsigned long position )
+{
+	unsigned long long sid_num = index->entry_keys[ position ];
+	if ( sid_num == SID_NONE )
+	{
+		return;
+	}
+
+	unsigned long *link = &index->slot_entries[ get_sid_slot( index, sid_num ) ];
+	while ( *link != 0 && *link - 1 != position )
+	{
+		link = &index->next_entries[ *link - 1 ];
+	}
+
+	if ( *link != 0 )
+	{
+		*link = index->next_entries[ position ];
+	}
+
+	index->entry_keys[ position ] = SID_NONE;
+	index->next_entries[ position ] = 0;
+}
+
+// Returns the position of the first entry with the sid, or entry_count if there isn't one.
+unsigned long find_sid_entry( sid_index *index, unsigned long long sid_num )
+{
+	unsigned long slot = get_sid_slot( index, sid_num );
+
+	return ( index->slot_entries[ slot ] != 0 ? index->slot_entries[ slot ] - 1 : index->entry_count );
+}
+
+// Makes room for entry_count positions. They're added with add_sid_entry.
+void create_sid_index( sid_index *index, unsigned long entry_count )
+{
+	index->slot_keys = NULL;
+	index->slot_entries = NULL;
+	index->slot_count = 0;
+	index->key_count = 0;
+	index->entry_count = entry_count;
+	index->entry_keys = ( unsigned long long * )malloc( sizeof( unsigned long long ) * entry_count );
+	index->next_entries = ( unsigned long * )malloc( sizeof( unsigned long ) * entry_count );
+
+	unsigned long slot_count = 16;
+	while ( slot_count < entry_count * 2 )
+	{
+		slot_count *= 2;
+	}
+	resize_sid_index( index, slot_count );
+}
+
+// Indexes the entries by the number in their names. The names are only parsed once.
+void build_sid_index( sid_index *index, fileinfo **entries, unsigned long entry_count )
+{
+	create_sid_index( index, entry_count );
+
+	for ( unsigned long i = 0; i < entry_count; ++i )
+	{
+		add_sid_entry( index, i, get_sid_number( entries[ i ]->filename ) );
+	}
+}
+
+void free_sid_index( sid_index *index )
+{
+	free( index->slot_keys );
+	free( index->slot_entries );
+	free( index->entry_keys );
+	free( index->next_entries );
+}
+
+// Entries that exist in the catalog will be updated.
+// Me, and 2000 will have full paths.
+// XP and 2003 will just have the file name.
+// Windows Vista, 2008, and 7 don't appear to have catalogs.
+char update_catalog_entries( file_map *fm, shared_info *si, fileinfo **entries, unsigned long entry_count, directory_header dh, database_callbacks *dc )
+{
+	if ( si == NULL || entries == NULL || entry_count == 0 )
+	{
+		return SC_FAIL;	// Fail silently. Don't do shared_info cleanup.
+	}
+
+	char *buf = NULL;
+	unsigned long total = 0;
+	char status = SC_OK;
+
+	if ( dh.stream_length >= si->short_sect_cutoff && si->sat != NULL )
+	{
+		buf = ( char * )malloc( sizeof( char ) * dh.stream_length );
+		memset( buf, 0, sizeof( char ) * dh.stream_length );
+
+		// Whatever was read before an error is still processed.
+		status = read_sat_stream( fm, si, dh.first_stream_sect, buf, dh.stream_length, total, "Premature end of file encountered while updating the directory.", dc );
+	}
+	else if ( si->short_stream_chain != NULL && si->ssat != NULL )
+	{
+		buf = ( char * )malloc( sizeof( char ) * dh.stream_length );
+		memset( buf, 0, sizeof( char ) * dh.stream_length );
+
+		status = read_ssat_stream( fm, si, dh.first_stream_sect, buf, dh.stream_length, total, dc );
+	}
+
+	if ( status == SC_QUIT )
+	{
+		free( buf );
+		return SC_QUIT;	// Quit silently. Don't do shared_info cleanup.
+	}
+
+	if ( buf != NULL && dh.stream_length > ( 2 * sizeof( unsigned short ) ) )
+	{
+		// 2 byte offset, 2 byte version, 4 bytes number of entries.
+		unsigned short header_length = 0;
+		memcpy( &header_length, buf, sizeof( unsigned short ) );
+		memcpy( &si->version, buf + sizeof( unsigned short ), sizeof( unsigned short ) );
+
+		unsigned long offset = header_length;
+
+		// Entries are usually in the same order as the directory. cursor is the entry we expect to update next.
+		unsigned long cursor = 0;
+		unsigned long last_cursor = entry_count;	// Where to resume if we run off the end of the entries.
+
+		// Entries that aren't where we expect them are looked up by their sid.
+		sid_index index;
+		build_sid_index( &index, entries, entry_count );
+
+		// Entry length (4 bytes), entry number (4 bytes), and date modified (8 bytes).
+		unsigned long entry_header_length = ( si->sect_size == 4096 ? 20 : 16 );
+
+		while ( offset + entry_header_length <= dh.stream_length )
+		{
+			// Stop processing and exit the thread.
+			if ( is_cancelled( dc ) == true )
+			{
+				free_sid_index( &index );
+				free( buf );
+				return SC_QUIT;	// Quit silently. Don't do shared_info cleanup.
+			}
+
+			// We may have to scan the entries for the next item. Reset it to the last item before the scan.
+			if ( cursor >= entry_count )
+			{
+				if ( last_cursor < entry_count )
+				{
+					cursor = last_cursor;
+				}
+				else
+				{
+					break;	// If no last info was set, then we can't continue.
+				}
+			}
+
+			unsigned int entry_length = 0;
+			memcpy( &entry_length, buf + offset, sizeof( unsigned int ) );
+			offset += sizeof( unsigned int );
+			unsigned int entry_num = 0;
+			memcpy( &entry_num, buf + offset, sizeof( unsigned int ) );
+			offset += sizeof( unsigned int );
+			long long date_modified = 0;
+			memcpy( &date_modified, buf + offset, sizeof( long long ) );
+			offset += sizeof( long long );
+
+			// It seems that version 4 databases have an additional value before the filename.
+			if ( si->sect_size == 4096 )
+			{
+				offset += sizeof( unsigned int );	// Padding?
+
+				entry_length -= sizeof( unsigned int );
+			}
+
+			unsigned long name_length = entry_length - 0x14;
+
+			if ( name_length > dh.stream_length || offset + name_length > dh.stream_length )
+			{
+				free_sid_index( &index );
+				free( buf );
+				report_error( dc, "Invalid directory entry." );
+				return SC_FAIL;
+			}
+
+			wchar_t *original_name = copy_utf16_string_arena( si, buf + offset, name_length / 2 );
+
+			// We need to verify that the entry number and sid match.
+			// The catalog entries generally appear to be in order, but the actual content in our list might not be. I've seen this in ehthumbs.db files.
+			unsigned long long sid_num = get_catalog_sid_number( si->version, entry_num );
+
+			fileinfo *fi = entries[ cursor ];
+			if ( index.entry_keys[ cursor ] != sid_num )
+			{
+				last_cursor = cursor;
+
+				unsigned long position = find_sid_entry( &index, sid_num );
+				if ( position < entry_count )
+				{
+					cursor = position;
+					fi = entries[ position ];
+				}
+			}
+
+			// The directory name stays in the arena until the database is closed.
+			fi->date_modified = date_modified;
+			fi->filename = original_name;
+
+			// The entry is now known by its original name.
+			remove_sid_entry( &index, cursor );
+			add_sid_entry( &index, cursor, get_sid_number( fi->filename ) );
+
+			si->system = get_catalog_system( si->version, fi->filename );
+
+			++cursor;
+
+			offset += ( name_length + 4 );
+		}
+
+		free_sid_index( &index );
+	}
+
+	free( buf );
+
+	return SC_OK;
+}
+
+// Finds the sectors of the short stream container. Nothing is copied. Its streams are read from the view when they're used.
+// This is always located in the SAT.
+char open_short_stream_container( file_map *fm, directory_header dh, shared_info *g_si, database_callbacks *dc )
+{
+	if ( g_si == NULL || ( g_si != NULL && g_si->sat == NULL ) )
+	{
+		return SC_FAIL;	// Fail silently. Don't do shared_info cleanup.
+	}
+
+	// Make sure we have a short stream container.
+	if ( dh.stream_length <= 0 || dh.first_stream_sect < 0 )
+	{
+		return SC_OK;
+	}
+
+	sector_chain *chain = get_chain( g_si, dh.first_stream_sect, false );
+	if ( chain == NULL )
+	{
+		return SC_FAIL;
+	}
+
+	g_si->short_stream_chain = chain;
+	g_si->short_stream_length = dh.stream_length;
+	g_si->short_stream_readable = 0;
+
+	// See how much of the container is in the file. The rest is read as zeros.
+	for ( unsigned long position = 0; g_si->short_stream_readable < dh.stream_length; ++position )
+	{
+		// Stop processing and exit the thread.
+		if ( is_cancelled( dc ) == true )
+		{
+			return SC_QUIT;
+		}
+
+		// The chain ended before the stream did.
+		if ( position >= chain->count )
+		{
+			report_error( dc, get_chain_error( chain, false ) );
+			return SC_FAIL;
+		}
+
+		unsigned long length = dh.stream_length - g_si->short_stream_readable;
+		if ( length > g_si->sect_size )
+		{
+			length = g_si->sect_size;
+		}
+
+		unsigned long read = 0;
+		get_sector( fm, g_si->sect_size, chain->sectors[ position ], length, read );
+		g_si->short_stream_readable += read;
+
+		if ( read < length )
+		{
+			report_error( dc, "Premature end of file encountered while building the short stream container." );
+			return SC_FAIL;
+		}
+	}
+
+	return SC_OK;
+}
+
+// Positions the cursor at the first directory sector.
+void start_directory( shared_info *si, directory_cursor *dcur )
+{
+	dcur->chain = get_chain( si, si->first_dir_sect, false );
+	dcur->position = 0;
+	dcur->sector = NULL;
+	dcur->read = 0;
+	dcur->item = 0;
+	dcur->terminated = false;
+	dcur->done = false;
+}
+
+void end_directory( directory_cursor *dcur )
+{
+	release_chain( dcur->chain );
+	dcur->chain = NULL;
+}
+
+// Sets dh to the next valid directory entry. The entry points into the mapped view.
+// Returns SC_FAIL once there are no more entries. terminated is set if the directory ended normally.
+char next_directory_entry( shared_info *si, directory_cursor *dcur, directory_header **dh, database_callbacks *dc )
+{
+	*dh = NULL;
+
+	// The number of directory list sectors is not known for Version 3 databases. The chain tells us where it ends.
+	while ( dcur->done == false && dcur->chain != NULL )
+	{
+		if ( dcur->sector == NULL )
+		{
+			// Stop processing and exit the thread.
+			if ( is_cancelled( dc ) == true )
+			{
+				return SC_QUIT;
+			}
+
+			if ( dcur->position >= dcur->chain->count )
+			{
+				// The directory list should terminate with -2.
+				if ( dcur->chain->error == NULL )
+				{
+					dcur->terminated = true;
+				}
+				else
+				{
+					report_error( dc, dcur->chain->error );
+				}
+
+				dcur->done = true;
+				break;
+			}
+
+			// The directory entries are read directly from the mapped sector.
+			dcur->sector = get_sector( &si->fm, si->sect_size, dcur->chain->sectors[ dcur->position ], si->sect_size, dcur->read );
+			dcur->item = 0;
+		}
+
+		// There are 4 directory items per 512 byte sector.
+		while ( dcur->item < ( si->sect_size / 128 ) )
+		{
+			if ( dcur->read < ( dcur->item + 1 ) * sizeof( directory_header ) )
+			{
+				report_error( dc, "Premature end of file encountered while building the directory." );
+				dcur->done = true;
+				return SC_FAIL;
+			}
+
+			directory_header *entry = ( directory_header * )( dcur->sector + ( dcur->item * sizeof( directory_header ) ) );
+			++dcur->item;
+
+			// Skip invalid entries.
+			if ( entry->entry_type != 0 )
+			{
+				*dh = entry;
+				return SC_OK;
+			}
+		}
+
+		dcur->sector = NULL;
+		++dcur->position;
+	}
+
+	return SC_FAIL;
+}
+
+// Vista and above name each entry after the hash of its filename. It should be formatted like: 256_0123456789ABCDEF
+// Returns 0 if the name doesn't have a hash.
+long long get_entry_hash( const wchar_t *name )
+{
+	const wchar_t *hash = wcschr( name, L'_' );
+	if ( hash == NULL || wcslen( ++hash ) > 16 )
+	{
+		return 0;
+	}
+
+	unsigned long long entry_hash = 0;
+	for ( ; *hash != L'\0'; ++hash )
+	{
+		wchar_t c = *hash;
+		if ( c >= L'0' && c <= L'9' )
+		{
+			entry_hash = ( entry_hash << 4 ) | ( c - L'0' );
+		}
+		else if ( c >= L'a' && c <= L'f' )
+		{
+			entry_hash = ( entry_hash << 4 ) | ( c - L'a' + 10 );
+		}
+		else if ( c >= L'A' && c <= L'F' )
+		{
+			entry_hash = ( entry_hash << 4 ) | ( c - L'A' + 10 );
+		}
+		else
+		{
+			break;	// Only the digits before it count.
+		}
+	}
+
+	return ( long long )entry_hash;
+}
+
+// Builds a list of directory entries.
+// This list is found by traversing the SAT.
+// The directory is stored as a red-black tree in the database, but we can simply iterate through it in order.
+// Each entry is passed to add_entry as soon as it's found. The catalog then updates the names and dates of those entries.
+char build_directory( shared_info *g_si, database_callbacks *dc )
+{
+	if ( g_si == NULL || g_si->sat == NULL || g_si->fm.base == NULL )
+	{
+		return SC_FAIL;
+	}
+
+	file_map *fm = &g_si->fm;
+
+	bool root_found = false;
+	directory_header root_dh = { 0 };
+
+	bool catalog_found = false;
+	directory_header catalog_dh = { 0 };
+
+	// The entries in directory order. The catalog needs them to match up its names.
+	fileinfo **entries = NULL;
+	unsigned long entry_count = 0;
+	unsigned long entries_size = 0;
+
+	directory_cursor dcur;
+	start_directory( g_si, &dcur );
+
+	directory_header *dh = NULL;
+	char status = SC_OK;
+
+	while ( ( status = next_directory_entry( g_si, &dcur, &dh, dc ) ) == SC_OK )
+	{
+		if ( dh->entry_type == 5 )
+		{
+			root_dh = *dh;			// Save the root entry
+			root_found = true;
+			continue;
+		}
+
+		wchar_t *filename = copy_utf16_string_arena( g_si, ( char * )dh->sid, 31 );
+
+		if ( catalog_found == false && wcscmp( filename, L"Catalog" ) == 0 )
+		{
+			// It was the most recent allocation, so we can give it back.
+			arena_shrink( g_si, filename, sizeof( wchar_t ) * ( wcslen( filename ) + 1 ), 0 );
+
+			catalog_dh = *dh;		// Save the catalog entry
+			catalog_found = true;	// Short circuit the condition above.
+			continue;
+		}
+
+		// dh->create_time never seems to be set.
+		fileinfo *fi = ( fileinfo * )arena_alloc( g_si, sizeof( fileinfo ) );
+		fi->filename = filename;
+		memcpy( &fi->date_modified, dh->modify_time, 8 );
+		fi->offset = dh->first_stream_sect;
+		fi->size = dh->stream_length;
+		fi->entry_type = dh->entry_type;
+		fi->flag = FIF_ARENA_ENTRY | FIF_ARENA_NAME;	// Both are freed with the database.
+		fi->si = g_si;
+		fi->si->version = 0;	// Unknown until/if we process a catalog entry.
+		fi->si->system = 0;		// Unknown until/if we process a catalog entry.
+		++( fi->si->count );	// Increment the number of entries.
+		fi->entry_hash = get_entry_hash( filename );	// Parsed once here so that it's never parsed again.
+
+		// Store the fileinfo in the list (first in, first out)
+		if ( entry_count == entries_size )
+		{
+			entries_size = ( entries_size == 0 ? 64 : entries_size * 2 );
+			entries = ( fileinfo ** )realloc( entries, sizeof( fileinfo * ) * entries_size );
+		}
+		entries[ entry_count++ ] = fi;
+
+		if ( dc != NULL && dc->add_entry != NULL )
+		{
+			dc->add_entry( dc->context, fi );
+		}
+	}
+
+	end_directory( &dcur );
+
+	if ( status == SC_QUIT )
+	{
+		free( entries );
+
+		return SC_QUIT;	// Any entries that were added belong to the caller.
+	}
+
+	if ( dcur.terminated == true )
+	{
+		if ( entry_count > 0 )
+		{
+			g_si->system = 3;	// Assume the system is Vista/2008/7
+		}
+		else
+		{
+			report_error( dc, "No entries were found." );
+		}
+	}
+
+	status = SC_OK;
+
+	if ( entry_count > 0 )
+	{
+		if ( root_found == true )
+		{
+			status = open_short_stream_container( fm, root_dh, g_si, dc );
+		}
+
+		if ( status != SC_QUIT && catalog_found == true )
+		{
+			status = update_catalog_entries( fm, g_si, entries, entry_count, catalog_dh, dc );
+
+			if ( status != SC_QUIT && dc != NULL && dc->entries_updated != NULL )
+			{
+				dc->entries_updated( dc->context, g_si );
+			}
+		}
+	}
+
+	free( entries );
+
+	return ( status == SC_QUIT ? SC_QUIT : SC_OK );
+}
+
+// Builds the Short SAT.
+// This table is a stream in the SAT.
+char build_ssat( file_map *fm, shared_info *g_si, database_callbacks *dc )
+{
+	if ( g_si == NULL || g_si->sat == NULL )
+	{
+		return SC_FAIL;
+	}
+
+	unsigned long total = 0;
+	unsigned long ssat_size = g_si->num_ssat_sects * g_si->sect_size;
+
+	g_si->ssat = ( int * )malloc( ssat_size );
+	memset( g_si->ssat, -1, ssat_size );
+
+	return read_sat_stream( fm, g_si, g_si->first_ssat_sect, ( char * )g_si->ssat, ssat_size, total, "Premature end of file encountered while building the Short SAT.", dc );
+}
+
+// Builds the SAT.
+// We concatenate each sector listed in the MSAT to build the SAT.
+char build_sat( file_map *fm, shared_info *g_si, int *msat, database_callbacks *dc )
+{
+	if ( g_si == NULL )
+	{
+		return SC_FAIL;
+	}
+
+	unsigned long read = 0, total = 0;
+	unsigned long sat_size = g_si->num_sat_sects * g_si->sect_size;
+
+	g_si->sat = ( int * )malloc( sat_size );
+	memset( g_si->sat, -1, sat_size );
+
+	// Save each sector in the Master SAT.
+	for ( unsigned long msat_index = 0; msat_index < g_si->num_sat_sects; msat_index++ )
+	{
+		// Stop processing and exit the thread.
+		if ( is_cancelled( dc ) == true )
+		{
+			return SC_QUIT;
+		}
+
+		// We shouldn't get here before the for loop completes.
+		if ( msat[ msat_index ] < 0 )
+		{
+			report_error( dc, "Invalid Master SAT termination index." );
+			return SC_FAIL;
+		}
+
+		char *sector = get_sector( fm, g_si->sect_size, msat[ msat_index ], g_si->sect_size, read );
+		memcpy( ( char * )g_si->sat + total, sector, read );
+		total += read;
+
+		if ( read < g_si->sect_size )
+		{
+			report_error( dc, "Premature end of file encountered while building the SAT." );
+			return SC_FAIL;
+		}
+	}
+
+	return SC_OK;
+}
+
+// Builds the MSAT.
+// This is only used to build the SAT and nothing more.
+char build_msat( file_map *fm, shared_info *g_si, int *msat, unsigned long msat_size, database_callbacks *dc )
+{
+	if ( g_si == NULL )
+	{
+		return SC_FAIL;
+	}
+
+	unsigned long read = 0, total = 436;	// If the sector size is 4096 bytes, then the remaining 3585 bytes are filled with 0.
+	long last_sector = g_si->first_dis_sect;	// Index of the next DISAT (double indirect sector allocation table)
+
+	memset( msat, -1, msat_size );
+
+	// The first MSAT (contained within the 512 byte header) is 436 bytes. Every other MSAT will be 512 or 4096 bytes.
+	if ( fm->size < 76 + 436 )
+	{
+		report_error( dc, "Premature end of file encountered while building the Master SAT." );
+		return SC_FAIL;
+	}
+
+	// The master sector allocation table begins at offset 76.
+	memcpy( msat, fm->base + 76, 436 );
+
+	// If there are DISATs, then we'll add them to the MSAT list.
+	for ( unsigned long i = 0; i < g_si->num_dis_sects; i++ )
+	{
+		// Stop processing and exit the thread.
+		if ( is_cancelled( dc ) == true )
+		{
+			return SC_QUIT;
+		}
+
+		char *sector = get_sector( fm, g_si->sect_size, last_sector, g_si->sect_size, read );
+
+		// Read the first 127 or 1023 SAT sectors (508 or 4092 bytes) in the DISAT.
+		// The last index in the DISAT contains a pointer to the next DISAT. That's assuming there's any more DISATs left.
+		if ( read < g_si->sect_size )
+		{
+			report_error( dc, "Premature end of file encountered while building the Master SAT." );
+			return SC_FAIL;
+		}
+
+		memcpy( ( char * )msat + total, sector, g_si->sect_size - sizeof( int ) );
+		total += ( g_si->sect_size - sizeof( int ) );
+
+		// Get the index of the next DISAT.
+		int next_sector = 0;
+		memcpy( &next_sector, sector + ( g_si->sect_size - sizeof( int ) ), sizeof( int ) );
+		last_sector = next_sector;
+	}
+
+	return SC_OK;
+}
+
+// Maps the database, validates its header, and builds its allocation tables.
+// On success, si holds a reference to the mapped view until close_database is called.
+char open_database( const wchar_t *path, database_callbacks *dc, shared_info **si )
+{
+	if ( path == NULL || si == NULL )
+	{
+		return SC_FAIL;
+	}
+
+	*si = NULL;
+
+	// This information is shared between entries within the database.
+	shared_info *g_si = ( shared_info * )malloc( sizeof( shared_info ) );
+	memset( g_si, 0, sizeof( shared_info ) );
+	initialize_lock( &g_si->chain_lock );
+	g_si->cache_chains = true;
+
+	unsigned long path_length = wcslen( path ) + 1;	// Include NULL character.
+	g_si->dbpath = ( wchar_t * )malloc( sizeof( wchar_t ) * path_length );
+	memcpy( g_si->dbpath, path, sizeof( wchar_t ) * path_length );
+
+	// Attempt to map our database file. Every sector is read directly from the view.
+	file_map *fm = acquire_database_map( g_si );
+	if ( fm == NULL )
+	{
+		cleanup_shared_info( &g_si );
+
+		// Empty files can't be mapped.
+		report_error( dc, "The database file failed to open." );
+
+		return SC_FAIL;
+	}
+
+	// Vista and newer keep their thumbnails in thumbcache files.
+	if ( fm->size >= 4 && memcmp( fm->base, "CMMM", 4 ) == 0 )
+	{
+		if ( open_cache( fm, g_si, dc ) != SC_OK )
+		{
+			cleanup_shared_info( &g_si );
+
+			return SC_FAIL;
+		}
+
+		*si = g_si;
+
+		return SC_OK;
+	}
+	else if ( fm->size >= 4 && memcmp( fm->base, "IMMM", 4 ) == 0 )
+	{
+		cleanup_shared_info( &g_si );
+
+		report_error( dc, "The file is a thumbcache index, which has no thumbnails." );
+
+		return SC_FAIL;
+	}
+
+	if ( fm->size < sizeof( database_header ) )
+	{
+		cleanup_shared_info( &g_si );
+
+		report_error( dc, "Premature end of file encountered while reading the header." );
+
+		return SC_FAIL;
+	}
+
+	// Get the header information for this database.
+	database_header *dh = ( database_header * )fm->base;
+
+	// Make sure it's a thumbs database and the stucture was filled correctly.
+	if ( memcmp( dh->magic_identifier, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1", 8 ) != 0 )
+	{
+		cleanup_shared_info( &g_si );
+
+		report_error( dc, "The file is not a thumbs database." );
+
+		return SC_FAIL;
+	}
+
+	// These values are the minimum at which we can multiply the sector size (512) and not go out of range.
+	if ( dh->num_sat_sects > 0x7FFFFF || dh->num_ssat_sects > 0x7FFFFF || dh->num_dis_sects > 0x810203 )
+	{
+		cleanup_shared_info( &g_si );
+
+		report_error( dc, "The total sector allocation table size is too large." );
+
+		return SC_FAIL;
+	}
+
+	// The sector size is equivalent to the 2 to the power of sector_shift. Version 3 = 2^9 = 512. Version 4 = 2^12 = 4096. We'll default to 512 if it's not version 4.
+	unsigned short sect_size = ( dh->dll_version == 0x0004 && dh->sector_shift == 0x000C ? 4096 : 512 );
+
+	// These can exceed 32 bits for 4096 byte sectors.
+	unsigned long long msat_size = sizeof( int ) * ( 109 + ( ( unsigned long long )dh->num_dis_sects * ( ( sect_size / sizeof( int ) ) - 1 ) ) );
+	unsigned long long sat_size = ( unsigned long long )dh->num_sat_sects * sect_size;
+	unsigned long long ssat_size = ( unsigned long long )dh->num_ssat_sects * sect_size;
+
+	// This is a simple check to make sure we don't allocate too much memory.
+	if ( msat_size + sat_size + ssat_size > fm->size )
+	{
+		cleanup_shared_info( &g_si );
+
+		report_error( dc, "The total sector allocation table size exceeds the size of the database." );
+
+		return SC_FAIL;
+	}
+
+	g_si->sect_size = sect_size;
+	g_si->first_dir_sect = dh->first_dir_sect;
+	g_si->first_dis_sect = dh->first_dis_sect;
+	g_si->first_ssat_sect = dh->first_ssat_sect;
+	g_si->num_ssat_sects = dh->num_ssat_sects;
+	g_si->num_dis_sects = dh->num_dis_sects;
+	g_si->num_sat_sects = dh->num_sat_sects;
+	g_si->short_sect_cutoff = dh->short_sect_cutoff;
+
+	// We only need the MSAT to build the SAT.
+	int *msat = ( int * )malloc( ( size_t )msat_size );
+
+	// Short-circuit the remaining functions if the status code is quit. The functions must be called in this order.
+	// A failure leaves whatever could be read in the tables, so we keep going.
+	char status = build_msat( fm, g_si, msat, ( unsigned long )msat_size, dc );
+	if ( status != SC_QUIT )
+	{
+		status = build_sat( fm, g_si, msat, dc );
+	}
+	if ( status != SC_QUIT )
+	{
+		status = build_ssat( fm, g_si, dc );
+	}
+
+	free( msat );
+
+	if ( status == SC_QUIT )
+	{
+		cleanup_shared_info( &g_si );
+
+		return SC_QUIT;
+	}
+
+	*si = g_si;
+
+	return SC_OK;
+}
+
+// Releases the reference to the view that open_database took.
+// The shared_info is freed if no entries were added, otherwise it belongs to the entries.
+void close_database( shared_info **si )
+{
+	if ( si == NULL || *si == NULL )
+	{
+		return;
+	}
+
+	release_database_map( *si );
+
+	if ( ( *si )->count == 0 )
+	{
+		cleanup_shared_info( si );
+	}
+
+	*si = NULL;
+}
+
+// Reads the database and passes each of its entries to add_entry.
+char read_database( const wchar_t *path, database_callbacks *dc )
+{
+	shared_info *si = NULL;
+
+	char status = open_database( path, dc, &si );
+	if ( status == SC_OK )
+	{
+		status = ( si->database_type == DATABASE_TYPE_CACHE ? build_cache_entries( si, dc ) : build_directory( si, dc ) );
+
+		close_database( &si );
+	}
+
+	return status;
+}
+
+#ifdef _WIN32
+	typedef HANDLE database_event;
+	typedef HANDLE database_thread;
+#else
+	struct database_event
+	{
+		pthread_mutex_t mutex;
+		pthread_cond_t condition;
+		bool signaled;
+	};
+	typedef pthread_t database_thread;
+#endif
+
+// A call to one of the callbacks. Only one of the values is set.
+struct database_report
+{
+	fileinfo *fi;				// add_entry
+	shared_info *si;			// entries_updated
+	char *message;				// report_error
+};
+
+// Holds what one database reports until it can be passed on in order.
+struct database_result
+{
+	const wchar_t *path;
+	database_callbacks *dc;		// The caller's callbacks. The worker only uses is_cancelled.
+
+	database_report *reports;	// In the order they were made.
+	unsigned long report_count;
+	unsigned long reports_size;
+
+	database_event done;		// Signaled once the database has been read.
+};
+
+// Databases that are waiting for a worker.
+struct database_queue
+{
+	database_result *results;
+	unsigned long count;
+	unsigned long next;			// Next database to be read.
+	database_lock lock;
+};
+
+void initialize_event( database_event *event )
+{
+#ifdef _WIN32
+	*event = CreateEvent( NULL, TRUE, FALSE, NULL );
+#else
+	pthread_mutex_init( &event->mutex, NULL );
+	pthread_cond_init( &event->condition, NULL );
+	event->signaled = false;
+#endif
+}
+
+void delete_event( database_event *event )
+{
+#ifdef _WIN32
+	CloseHandle( *event );
+#else
+	pthread_cond_destroy( &event->condition );
+	pthread_mutex_destroy( &event->mutex );
+#endif
+}
+
+void set_event( database_event *event )
+{
+#ifdef _WIN32
+	SetEvent( *event );
+#else
+	pthread_mutex_lock( &event->mutex );
+	event->signaled = true;
+	pthread_cond_signal( &event->condition );
+	pthread_mutex_unlock( &event->mutex );
+#endif
+}
+
+void wait_event( database_event *event )
+{
+#ifdef _WIN32
+	WaitForSingleObject( *event, INFINITE );
+#else
+	pthread_mutex_lock( &event->mutex );
+	while ( event->signaled == false )
+	{
+		pthread_cond_wait( &event->condition, &event->mutex );
+	}
+	pthread_mutex_unlock( &event->mutex );
+#endif
+}
+
+unsigned long get_processor_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO system_info;
+	GetSystemInfo( &system_info );
+	return system_info.dwNumberOfProcessors;
+#else
+	long processor_count = sysconf( _SC_NPROCESSORS_ONLN );
+	return ( processor_count > 0 ? processor_count : 1 );
+#endif
+}
+
+database_report *add_report( database_result *dr )
+{
+	if ( dr->report_count == dr->reports_size )
+	{
+		dr->reports_size = ( dr->reports_size == 0 ? 64 : dr->reports_size * 2 );
+		dr->reports = ( database_report * )realloc( dr->reports, sizeof( database_report ) * dr->reports_size );
+	}
+
+	database_report *report = &dr->reports[ dr->report_count++ ];
+	memset( report, 0, sizeof( database_report ) );
+
+	return report;
+}
+
+void collect_entry( void *context, fileinfo *fi )
+{
+	add_report( ( database_result * )context )->fi = fi;
+}
+
+void collect_entries_updated( void *context, shared_info *si )
+{
+	add_report( ( database_result * )context )->si = si;
+}
+
+bool forward_is_cancelled( void *context )
+{
+	return is_cancelled( ( ( database_result * )context )->dc );
+}
+
+void collect_error( void *context, const char *message )
+{
+	database_report *report = add_report( ( database_result * )context );
+
+	unsigned long message_length = strlen( message ) + 1;	// Include the NULL character.
+	report->message = ( char * )malloc( sizeof( char ) * message_length );
+	memcpy( report->message, message, message_length );
+}
+
+// Reads databases from the queue until it's empty.
+void read_queued_databases( database_queue *dq )
+{
+	while ( true )
+	{
+		enter_lock( &dq->lock );
+		unsigned long index = dq->next;
+		if ( index < dq->count )
+		{
+			++dq->next;
+		}
+		leave_lock( &dq->lock );
+
+		if ( index >= dq->count )
+		{
+			break;
+		}
+
+		database_result *dr = &dq->results[ index ];
+
+		if ( is_cancelled( dr->dc ) == false )
+		{
+			database_callbacks dc;
+			dc.context = ( void * )dr;
+			dc.add_entry = collect_entry;
+			dc.entries_updated = collect_entries_updated;
+			dc.is_cancelled = forward_is_cancelled;
+			dc.report_error = collect_error;
+
+			read_database( dr->path, &dc );
+		}
+
+		set_event( &dr->done );
+	}
+}
+
+#ifdef _WIN32
+unsigned __stdcall database_worker( void *pArguments )
+{
+	read_queued_databases( ( database_queue * )pArguments );
+
+	_endthreadex( 0 );
+	return 0;
+}
+#else
+void *database_worker( void *pArguments )
+{
+	read_queued_databases( ( database_queue * )pArguments );
+
+	return NULL;
+}
+#endif
+
+// Reads each database on a pool of worker threads.
+// Entries and errors are passed to dc from the calling thread in the same order as the paths, as if they had been read one after another.
+// A thread_count of 0 uses one thread per processor.
+char read_databases( const wchar_t **paths, unsigned long path_count, database_callbacks *dc, unsigned long thread_count )
+{
+	if ( paths == NULL || path_count == 0 )
+	{
+		return SC_FAIL;
+	}
+
+	if ( thread_count == 0 )
+	{
+		thread_count = get_processor_count();
+	}
+
+	// Each database that's being read holds a mapped view. Don't read more at once than the pool can keep mapped.
+	if ( thread_count > MAX_MAPPED_DATABASES )
+	{
+		thread_count = MAX_MAPPED_DATABASES;
+	}
+
+	if ( thread_count > path_count )
+	{
+		thread_count = path_count;
+	}
+
+	database_queue dq;
+	dq.results = ( database_result * )malloc( sizeof( database_result ) * path_count );
+	memset( dq.results, 0, sizeof( database_result ) * path_count );
+	dq.count = path_count;
+	dq.next = 0;
+	initialize_lock( &dq.lock );
+
+	for ( unsigned long i = 0; i < path_count; ++i )
+	{
+		dq.results[ i ].path = paths[ i ];
+		dq.results[ i ].dc = dc;
+		initialize_event( &dq.results[ i ].done );
+	}
+
+	database_thread *threads = ( database_thread * )malloc( sizeof( database_thread ) * thread_count );
+	unsigned long threads_created = 0;
+
+	for ( unsigned long i = 0; i < thread_count; ++i )
+	{
+#ifdef _WIN32
+		threads[ threads_created ] = ( HANDLE )_beginthreadex( NULL, 0, &database_worker, ( void * )&dq, 0, NULL );
+		if ( threads[ threads_created ] != NULL )
+#else
+		if ( pthread_create( &threads[ threads_created ], NULL, &database_worker, ( void * )&dq ) == 0 )
+#endif
+		{
+			++threads_created;
+		}
+	}
+
+	// Read them ourselves if no worker could be started.
+	if ( threads_created == 0 )
+	{
+		read_queued_databases( &dq );
+	}
+
+	char status = SC_OK;
+
+	// Pass on the results in order. Later databases continue to be read while we wait on an earlier one.
+	for ( unsigned long i = 0; i < path_count; ++i )
+	{
+		database_result *dr = &dq.results[ i ];
+
+		wait_event( &dr->done );
+
+		if ( status != SC_QUIT && is_cancelled( dc ) == true )
+		{
+			status = SC_QUIT;
+		}
+
+		for ( unsigned long j = 0; j < dr->report_count; ++j )
+		{
+			database_report *report = &dr->reports[ j ];
+
+			if ( report->fi != NULL )
+			{
+				if ( status != SC_QUIT && dc != NULL && dc->add_entry != NULL )
+				{
+					dc->add_entry( dc->context, report->fi );
+				}
+				else	// Nobody is going to take the entry.
+				{
+					free_fileinfo( report->fi );
+				}
+			}
+			else if ( report->si != NULL )
+			{
+				if ( status != SC_QUIT && dc != NULL && dc->entries_updated != NULL )
+				{
+					dc->entries_updated( dc->context, report->si );
+				}
+			}
+			else if ( report->message != NULL )
+			{
+				if ( status != SC_QUIT )
+				{
+					report_error( dc, report->message );
+				}
+
+				free( report->message );
+			}
+		}
+
+		free( dr->reports );
+	}
+
+	for ( unsigned long i = 0; i < threads_created; ++i )
+	{
+#ifdef _WIN32
+		WaitForSingleObject( threads[ i ], INFINITE );
+		CloseHandle( threads[ i ] );
+#else
+		pthread_join( threads[ i ], NULL );
+#endif
+	}
+
+	free( threads );
+
+	for ( unsigned long i = 0; i < path_count; ++i )
+	{
+		delete_event( &dq.results[ i ].done );
+	}
+
+	delete_lock( &dq.lock );
+	free( dq.results );
+
+	return status;
+}
+
+// Reads from the catalog without reporting any errors. The caller decides whether the entry is invalid.
+char read_catalog( entry_iterator *ei, unsigned long offset, char *buf, unsigned long length )
+{
+	if ( offset > ei->catalog_length || length > ei->catalog_length - offset )
+	{
+		return SC_FAIL;
+	}
+
+	unsigned long total = 0;
+
+	return read_chain( &ei->si->fm, ei->si, ei->catalog_chain, ei->catalog_is_short, offset, buf, length, total, NULL, NULL );
+}
+
+// Reads the header of the catalog entry at offset.
+// name_offset and name_length describe the entry's name, and next_offset is the offset of the entry that follows it.
+char read_catalog_entry( entry_iterator *ei, unsigned long offset, unsigned int &entry_num, long long &date_modified, unsigned long &name_offset, unsigned long &name_length, unsigned long &next_offset )
+{
+	// Entry length (4 bytes), entry number (4 bytes), and date modified (8 bytes).
+	// It seems that version 4 databases have an additional value before the filename.
+	char entry_header[ 20 ];
+	unsigned long entry_header_length = ( ei->si->sect_size == 4096 ? 20 : 16 );
+
+	if ( offset + entry_header_length > ei->catalog_end || read_catalog( ei, offset, entry_header, entry_header_length ) != SC_OK )
+	{
+		return SC_FAIL;
+	}
+
+	unsigned int entry_length = 0;
+	memcpy( &entry_length, entry_header, sizeof( unsigned int ) );
+	memcpy( &entry_num, entry_header + sizeof( unsigned int ), sizeof( unsigned int ) );
+	memcpy( &date_modified, entry_header + ( sizeof( unsigned int ) * 2 ), sizeof( long long ) );
+
+	if ( ei->si->sect_size == 4096 )
+	{
+		entry_length -= sizeof( unsigned int );	// Padding?
+	}
+
+	name_offset = offset + entry_header_length;
+	name_length = entry_length - 0x14;
+
+	if ( name_length > ei->catalog_end || name_offset + name_length > ei->catalog_end )
+	{
+		return SC_FAIL;
+	}
+
+	next_offset = name_offset + name_length + 4;
+
+	return SC_OK;
+}
+
+// Converts the catalog entry's name. The returned string must be freed.
+wchar_t *read_catalog_name( entry_iterator *ei, unsigned long name_offset, unsigned long name_length )
+{
+	if ( name_length > ei->name_buf_size )
+	{
+		free( ei->name_buf );
+		ei->name_buf = ( char * )malloc( sizeof( char ) * name_length );
+		ei->name_buf_size = name_length;
+	}
+
+	if ( read_catalog( ei, name_offset, ei->name_buf, name_length ) != SC_OK )
+	{
+		return NULL;
+	}
+
+	return copy_utf16_string( ei->name_buf, name_length / 2 );
+}
+
+// Indexes every catalog entry by its sid so that a directory entry finds its catalog entry without scanning for it.
+// Only the offset and sid of each catalog entry are kept. Nothing is kept for the directory's entries.
+char build_catalog_index( entry_iterator *ei )
+{
+	unsigned int entry_num = 0;
+	long long date_modified = 0;
+	unsigned long name_offset = 0, name_length = 0, next_offset = 0;
+
+	unsigned long entry_header_length = ( ei->si->sect_size == 4096 ? 20 : 16 );
+	unsigned long offset = ei->catalog_start;
+
+	unsigned long *offsets = NULL;
+	unsigned long long *sids = NULL;
+	unsigned long offsets_size = 0;
+	unsigned long catalog_count = 0;
+
+	while ( offset + entry_header_length <= ei->catalog_end )
+	{
+		// Stop processing and exit the thread.
+		if ( is_cancelled( ei->dc ) == true )
+		{
+			free( sids );
+			free( offsets );
+
+			return SC_QUIT;
+		}
+
+		if ( read_catalog_entry( ei, offset, entry_num, date_modified, name_offset, name_length, next_offset ) != SC_OK )
+		{
+			// Nothing after this entry can be trusted. It's reported once a search would have reached it.
+			ei->catalog_end = offset;
+			ei->catalog_truncated = true;
+
+			break;
+		}
+
+		if ( catalog_count >= offsets_size )
+		{
+			offsets_size += 1024;
+			offsets = ( unsigned long * )realloc( offsets, sizeof( unsigned long ) * offsets_size );
+			sids = ( unsigned long long * )realloc( sids, sizeof( unsigned long long ) * offsets_size );
+		}
+
+		offsets[ catalog_count ] = offset;
+		sids[ catalog_count ] = get_catalog_sid_number( ei->si->version, entry_num );
+		++catalog_count;
+
+		offset = next_offset;
+	}
+
+	// Positions are in catalog order, so entries that share a sid are linked in the order they appear.
+	ei->catalog_index = ( sid_index * )malloc( sizeof( sid_index ) );
+	create_sid_index( ei->catalog_index, catalog_count );
+
+	for ( unsigned long i = 0; i < catalog_count; ++i )
+	{
+		add_sid_entry( ei->catalog_index, i, sids[ i ] );
+	}
+
+	free( sids );
+	ei->catalog_offsets = offsets;
+
+	return SC_OK;
+}
+
+// Returns the position of the catalog entry that the current entry should be matched with, or the catalog count if there isn't one.
+// Entries are usually in the same order as the directory, so the first one after the last match is used. Otherwise it's the first one in the catalog.
+unsigned long find_catalog_entry( entry_iterator *ei, unsigned long long sid_num )
+{
+	sid_index *index = ei->catalog_index;
+	unsigned long first_position = index->entry_count;
+
+	if ( sid_num != SID_NONE )
+	{
+		for ( unsigned long position = find_sid_entry( index, sid_num ); position < index->entry_count; position = ( index->next_entries[ position ] != 0 ? index->next_entries[ position ] - 1 : index->entry_count ) )
+		{
+			// Entries that share a sid are in offset order, so the rest are past the end too.
+			if ( ei->catalog_offsets[ position ] >= ei->catalog_end )
+			{
+				break;
+			}
+
+			if ( ei->catalog_offsets[ position ] >= ei->catalog_offset )
+			{
+				return position;
+			}
+
+			if ( first_position == index->entry_count )
+			{
+				first_position = position;
+			}
+		}
+	}
+
+	// A scan from the last match would have reached the invalid entry before starting over.
+	if ( ei->catalog_truncated == true )
+	{
+		ei->catalog_truncated = false;
+
+		report_error( ei->dc, "Invalid directory entry." );
+	}
+
+	return first_position;
+}
+
+// Updates the current entry with the name and date of its catalog entry.
+void match_catalog_entry( entry_iterator *ei )
+{
+	if ( ei->catalog_found == false || ei->catalog_index == NULL )
+	{
+		return;
+	}
+
+	unsigned int entry_num = 0;
+	long long date_modified = 0;
+	unsigned long name_offset = 0, name_length = 0, next_offset = 0;
+
+	unsigned long long sid_num = get_sid_number( ei->fi.filename );
+
+	while ( true )
+	{
+		unsigned long position = find_catalog_entry( ei, sid_num );
+		if ( position >= ei->catalog_index->entry_count )
+		{
+			return;	// The entry isn't in the catalog.
+		}
+
+		unsigned long offset = ei->catalog_offsets[ position ];
+
+		wchar_t *original_name = NULL;
+		bool valid_entry = ( read_catalog_entry( ei, offset, entry_num, date_modified, name_offset, name_length, next_offset ) == SC_OK );
+		if ( valid_entry == true )
+		{
+			original_name = read_catalog_name( ei, name_offset, name_length );
+			valid_entry = ( original_name != NULL );
+		}
+
+		if ( valid_entry == false )
+		{
+			report_error( ei->dc, "Invalid directory entry." );
+
+			// Nothing after this entry can be trusted. Entries before it can still be matched.
+			ei->catalog_end = offset;
+			ei->catalog_truncated = false;	// A search can't reach the entry that ended the index anymore.
+			if ( ei->catalog_offset > offset )
+			{
+				ei->catalog_offset = offset;
+			}
+
+			continue;
+		}
+
+		ei->fi.date_modified = date_modified;
+		free( ei->fi.filename );
+		ei->fi.filename = original_name;
+
+		ei->catalog_offset = next_offset;
+
+		return;
+	}
+}
+
+// Opens the database so that its entries can be read with next_entry.
+// Only the allocation tables, the short stream container's chain, an index of the catalog, and the current entry are held in memory.
+char open_entry_iterator( const wchar_t *path, database_callbacks *dc, entry_iterator *ei )
+{
+	memset( ei, 0, sizeof( entry_iterator ) );
+	ei->dc = dc;
+
+	char status = open_database( path, dc, &ei->si );
+	if ( status != SC_OK )
+	{
+		return status;
+	}
+
+	shared_info *si = ei->si;
+
+	// Cache entries are found by walking the file. There's no directory or catalog.
+	if ( si->database_type == DATABASE_TYPE_CACHE )
+	{
+		ei->cache_offset = si->cache_start;
+
+		return SC_OK;
+	}
+
+	// Nothing is kept for an entry once we've moved past it, and that includes its chain.
+	si->cache_chains = false;
+
+	// Find the root and catalog entries before any entry is returned. Errors are reported when the entries are walked.
+	database_callbacks quiet_dc = { 0 };
+	if ( dc != NULL )
+	{
+		quiet_dc = *dc;
+		quiet_dc.report_error = NULL;
+	}
+
+	bool root_found = false;
+	directory_header root_dh = { 0 };
+	directory_header catalog_dh = { 0 };
+	bool has_entries = false;
+
+	directory_cursor dcur;
+	start_directory( si, &dcur );
+
+	directory_header *dh = NULL;
+	while ( ( status = next_directory_entry( si, &dcur, &dh, &quiet_dc ) ) == SC_OK )
+	{
+		if ( dh->entry_type == 5 )
+		{
+			root_dh = *dh;
+			root_found = true;
+			continue;
+		}
+
+		wchar_t *filename = copy_utf16_string( ( char * )dh->sid, 31 );
+
+		if ( ei->catalog_found == false && wcscmp( filename, L"Catalog" ) == 0 )
+		{
+			catalog_dh = *dh;
+			ei->catalog_found = true;
+		}
+		else
+		{
+			has_entries = true;
+		}
+
+		free( filename );
+	}
+
+	end_directory( &dcur );
+
+	if ( status == SC_QUIT )
+	{
+		close_entry_iterator( ei );
+
+		return SC_QUIT;
+	}
+
+	if ( has_entries == false )
+	{
+		ei->catalog_found = false;
+	}
+	else
+	{
+		if ( dcur.terminated == true )
+		{
+			si->system = 3;	// Assume the system is Vista/2008/7
+		}
+
+		if ( root_found == true && open_short_stream_container( &si->fm, root_dh, si, dc ) == SC_QUIT )
+		{
+			close_entry_iterator( ei );
+
+			return SC_QUIT;
+		}
+	}
+
+	if ( ei->catalog_found == true )
+	{
+		ei->catalog_is_short = ( catalog_dh.stream_length < si->short_sect_cutoff );
+		ei->catalog_length = catalog_dh.stream_length;
+		ei->catalog_chain = get_chain( si, catalog_dh.first_stream_sect, ei->catalog_is_short );
+
+		// 2 byte offset, 2 byte version, 4 bytes number of entries.
+		char catalog_header[ 2 * sizeof( unsigned short ) ];
+		if ( catalog_dh.stream_length > sizeof( catalog_header ) && read_catalog( ei, 0, catalog_header, sizeof( catalog_header ) ) == SC_OK )
+		{
+			unsigned short header_length = 0;
+			memcpy( &header_length, catalog_header, sizeof( unsigned short ) );
+			memcpy( &si->version, catalog_header + sizeof( unsigned short ), sizeof( unsigned short ) );
+
+			ei->catalog_start = header_length;
+			ei->catalog_end = ei->catalog_length;
+			ei->catalog_offset = header_length;
+
+			// The system is the same for every entry, so the first entry is enough to determine it.
+			unsigned int entry_num = 0;
+			long long date_modified = 0;
+			unsigned long name_offset = 0, name_length = 0, next_offset = 0;
+			if ( read_catalog_entry( ei, ei->catalog_start, entry_num, date_modified, name_offset, name_length, next_offset ) == SC_OK )
+			{
+				wchar_t *original_name = read_catalog_name( ei, name_offset, name_length );
+				if ( original_name != NULL )
+				{
+					si->system = get_catalog_system( si->version, original_name );
+					free( original_name );
+				}
+			}
+
+			if ( build_catalog_index( ei ) == SC_QUIT )
+			{
+				close_entry_iterator( ei );
+
+				return SC_QUIT;
+			}
+		}
+		else
+		{
+			ei->catalog_found = false;
+		}
+	}
+
+	start_directory( si, &ei->dir );
+
+	return SC_OK;
+}
+
+// Moves to the next entry. Returns SC_FAIL once there are no more entries.
+char next_entry( entry_iterator *ei )
+{
+	if ( ei == NULL || ei->si == NULL )
+	{
+		return SC_FAIL;
+	}
+
+	free( ei->fi.filename );
+	ei->fi.filename = NULL;
+
+	if ( ei->si->database_type == DATABASE_TYPE_CACHE )
+	{
+		return next_cache_entry( ei );
+	}
+
+	directory_header *dh = NULL;
+	char status = SC_FAIL;
+
+	while ( ( status = next_directory_entry( ei->si, &ei->dir, &dh, ei->dc ) ) == SC_OK )
+	{
+		if ( dh->entry_type == 5 )
+		{
+			continue;
+		}
+
+		wchar_t *filename = copy_utf16_string( ( char * )dh->sid, 31 );
+
+		if ( ei->catalog_skipped == false && wcscmp( filename, L"Catalog" ) == 0 )
+		{
+			free( filename );
+
+			ei->catalog_skipped = true;
+			continue;
+		}
+
+		// dh->create_time never seems to be set.
+		ei->fi.filename = filename;
+		memcpy( &ei->fi.date_modified, dh->modify_time, 8 );
+		ei->fi.offset = dh->first_stream_sect;
+		ei->fi.size = dh->stream_length;
+		ei->fi.entry_type = dh->entry_type;
+		ei->fi.flag = 0;
+		ei->fi.si = ei->si;
+		ei->fi.entry_hash = get_entry_hash( filename );
+
+		match_catalog_entry( ei );
+
+		++ei->entry_count;
+
+		return SC_OK;
+	}
+
+	if ( status == SC_FAIL && ei->dir.terminated == true && ei->entry_count == 0 )
+	{
+		ei->dir.terminated = false;	// Only report it once.
+
+		report_error( ei->dc, "No entries were found." );
+	}
+
+	return status;
+}
+
+// Reads the current entry's stream. The buffer belongs to the iterator and is only valid until the next call to next_entry.
+char *read_current_entry( entry_iterator *ei, unsigned long &size, unsigned long &header_offset )
+{
+	if ( ei == NULL || ei->fi.filename == NULL )
+	{
+		return NULL;
+	}
+
+	return read_entry( &ei->fi, ei->buf, ei->buf_size, size, header_offset, ei->dc );
+}
+
+void close_entry_iterator( entry_iterator *ei )
+{
+	if ( ei == NULL )
+	{
+		return;
+	}
+
+	free( ei->fi.filename );
+	ei->fi.filename = NULL;
+	free( ei->buf );
+	ei->buf = NULL;
+	ei->buf_size = 0;
+	free( ei->name_buf );
+	ei->name_buf = NULL;
+	ei->name_buf_size = 0;
+
+	end_directory( &ei->dir );
+	release_chain( ei->catalog_chain );
+	ei->catalog_chain = NULL;
+
+	if ( ei->catalog_index != NULL )
+	{
+		free_sid_index( ei->catalog_index );
+		free( ei->catalog_index );
+		ei->catalog_index = NULL;
+	}
+	free( ei->catalog_offsets );
+	ei->catalog_offsets = NULL;
+
+	// No entries hold a reference to the shared info, so it's freed.
+	close_database( &ei->si );
+}
@@ -0,0 +1,336 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THUMBS_DB_H
+#define THUMBS_DB_H
+
+// The database parser doesn't depend on the user interface. It builds on Windows and Linux.
+
+#include "file_map.h"
+#include "dllrbt.h"
+
+#ifdef USE_IO_URING
+	#include "async_read.h"
+#endif
+
+#include <wchar.h>
+
+#ifndef _WIN32
+	#include <pthread.h>
+#endif
+
+#define FILE_TYPE_JPEG	"\xFF\xD8\xFF\xE0"
+#define FILE_TYPE_PNG	"\x89\x50\x4E\x47\x0D\x0A\x1A\x0A"
+
+// 20 bytes
+#define jfif_header		"\xFF\xD8\xFF\xE0\x00\x10\x4A\x46\x49\x46\x00\x01\x01\x01\x00\x60" \
+						"\x00\x60\x00\x00"
+
+// 138 bytes (Luminance and Chrominance)
+#define quantization	"\xFF\xDB\x00\x43\x00\x08\x06\x06\x07\x06\x05\x08\x07\x07\x07\x09" \
+						"\x09\x08\x0A\x0C\x14\x0D\x0C\x0B\x0B\x0C\x19\x12\x13\x0F\x14\x1D" \
+						"\x1A\x1F\x1E\x1D\x1A\x1C\x1C\x20\x24\x2E\x27\x20\x22\x2C\x23\x1C" \
+						"\x1C\x28\x37\x29\x2C\x30\x31\x34\x34\x34\x1F\x27\x39\x3D\x38\x32" \
+						"\x3C\x2E\x33\x34\x32"											   \
+						"\xFF\xDB\x00\x43\x01\x09\x09\x09\x0C\x0B\x0C\x18\x0D\x0D\x18\x32" \
+						"\x21\x1C\x21\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32" \
+						"\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32" \
+						"\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32\x32" \
+						"\x32\x32\x32\x32\x32"
+
+// 216 bytes
+#define huffman_table	"\xFF\xC4\x00\x1F\x00\x00\x01\x05\x01\x01\x01\x01\x01\x01\x00\x00" \
+						"\x00\x00\x00\x00\x00\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A" \
+						"\x0B\xFF\xC4\x00\xB5\x10\x00\x02\x01\x03\x03\x02\x04\x03\x05\x05" \
+						"\x04\x04\x00\x00\x01\x7D\x01\x02\x03\x00\x04\x11\x05\x12\x21\x31" \
+						"\x41\x06\x13\x51\x61\x07\x22\x71\x14\x32\x81\x91\xA1\x08\x23\x42" \
+						"\xB1\xC1\x15\x52\xD1\xF0\x24\x33\x62\x72\x82\x09\x0A\x16\x17\x18" \
+						"\x19\x1A\x25\x26\x27\x28\x29\x2A\x34\x35\x36\x37\x38\x39\x3A\x43" \
+						"\x44\x45\x46\x47\x48\x49\x4A\x53\x54\x55\x56\x57\x58\x59\x5A\x63" \
+						"\x64\x65\x66\x67\x68\x69\x6A\x73\x74\x75\x76\x77\x78\x79\x7A\x83" \
+						"\x84\x85\x86\x87\x88\x89\x8A\x92\x93\x94\x95\x96\x97\x98\x99\x9A" \
+						"\xA2\xA3\xA4\xA5\xA6\xA7\xA8\xA9\xAA\xB2\xB3\xB4\xB5\xB6\xB7\xB8" \
+						"\xB9\xBA\xC2\xC3\xC4\xC5\xC6\xC7\xC8\xC9\xCA\xD2\xD3\xD4\xD5\xD6" \
+						"\xD7\xD8\xD9\xDA\xE1\xE2\xE3\xE4\xE5\xE6\xE7\xE8\xE9\xEA\xF1\xF2" \
+						"\xF3\xF4\xF5\xF6\xF7\xF8\xF9\xFA"
+
+// Limits on the number of database views that remain mapped after they've been used for extraction.
+// The least recently used views are unmapped once either limit is exceeded.
+#define MAX_MAPPED_DATABASES	64
+#define MAX_MAPPED_SIZE			( 256 * 1024 * 1024 )
+
+// Return status codes for various functions.
+#define SC_FAIL	0
+#define SC_OK	1
+#define SC_QUIT	2
+
+// fileinfo flags.
+#define FIF_TYPE_JPG		1
+#define FIF_TYPE_CMYK_JPG	2
+#define FIF_TYPE_PNG		4
+#define FIF_TYPE_UNKNOWN	8
+#define FIF_ARENA_ENTRY		32	// The fileinfo is held by its database's arena.
+#define FIF_ARENA_NAME		64	// The filename is held by its database's arena.
+
+#define ARENA_BLOCK_SIZE	( 64 * 1024 )	// Minimum size of each block in a database's arena.
+
+// Kinds of databases that can be read.
+#define DATABASE_TYPE_THUMBS	0	// Thumbs.db and ehthumbs.db compound files.
+#define DATABASE_TYPE_CACHE		1	// thumbcache_*.db files.
+
+// The on-disk structures use int for their 32 bit values so that they're the same size on LP64 systems.
+struct database_header
+{
+	char magic_identifier[ 8 ]; // {0xd0, 0xcf, 0x11, 0xe0, 0xa1, 0xb1, 0x1a, 0xe1} for current version, was {0x0e, 0x11, 0xfc, 0x0d, 0xd0, 0xcf, 0x11, 0xe0} on old, beta 2 files (late '92)
+	char class_id[ 16 ];
+	unsigned short minor_version;
+	unsigned short dll_version;
+	unsigned short byte_order;	// Always 0xFFFE
+	unsigned short sector_shift;
+	unsigned short short_sect_shift;
+	unsigned short reserved_1;
+	unsigned int reserved_2;
+	unsigned int num_dir_sects;	// Not supported in Version 3 databases.
+	unsigned int num_sat_sects;
+	int first_dir_sect;
+	unsigned int transactioning_sig;
+	unsigned int short_sect_cutoff;
+	int first_ssat_sect;
+	unsigned int num_ssat_sects;
+	int first_dis_sect;
+	unsigned int num_dis_sects;
+};
+
+struct directory_header
+{
+	unsigned short sid[ 32 ];	// NULL terminated UTF-16
+	unsigned short sid_length;
+	char entry_type;			// 0 = Invalid, 1 = Storage, 2 = Stream, 3 = Lock bytes, 4 = Property, 5 = Root
+	char node_color;			// 0 = Red, 1 = Black
+	int left_child;
+	int right_child;
+	int dir_id;
+	char clsid[ 16 ];
+	unsigned int user_flags;
+
+	char create_time[ 8 ];
+	char modify_time[ 8 ];
+
+	int first_stream_sect;
+	unsigned int stream_length;			// Low order bits. Should be less than or equal to 0x80000000 for Version 3 databases.
+	unsigned int stream_length_high;	// High order bits.
+};
+
+#ifdef _WIN32
+	typedef CRITICAL_SECTION database_lock;
+#else
+	typedef pthread_mutex_t database_lock;
+#endif
+
+// A stream's sectors in the order they're chained together.
+struct sector_chain
+{
+	int *sectors;			// Index of each sector in the chain.
+	unsigned long count;	// Number of sectors in the chain.
+	const char *error;		// Why the chain ended before it was terminated. NULL if it was terminated with -2.
+	bool cached;			// The chain belongs to the shared info's cache.
+};
+
+// A block of a database's arena. Entries and their names are carved out of it and are only freed with the database.
+struct arena_block
+{
+	arena_block *next;
+	unsigned long size;		// Bytes available after the block header.
+	unsigned long used;
+};
+
+// Holds shared variables among database entries.
+struct shared_info
+{
+	wchar_t *dbpath;
+	int *sat;
+	int *ssat;
+	sector_chain *short_stream_chain;		// Sectors of the short stream container. It's read from the view rather than copied.
+	unsigned long short_stream_length;
+	unsigned long short_stream_readable;	// Number of bytes of the container that are in the file. The rest reads as zeros.
+
+	file_map fm;				// Cached view of the database. base is NULL when it's not mapped.
+	shared_info *map_prev;		// Neighbors in the list of mapped databases (most recently used first).
+	shared_info *map_next;
+	unsigned long map_refs;		// Number of extractions using the view. It can't be evicted until this is 0.
+
+	dllrbt_tree *sat_chains;	// Chains of the streams in the SAT, keyed by their first sector.
+	dllrbt_tree *ssat_chains;	// Chains of the streams in the short stream container, keyed by their first sector.
+	unsigned char *sat_visited;	// Bitmaps of the sectors in the chain that's being resolved. They're used to find chains that loop.
+	unsigned char *ssat_visited;
+	database_lock chain_lock;	// Guards the chain caches and bitmaps.
+	bool cache_chains;			// Keep each chain once it's been resolved.
+
+	arena_block *arena;			// Holds the fileinfo structures and names of the entries. The newest block is first.
+
+	//These are found in the database header.
+	unsigned long num_sat_sects;
+	long first_dir_sect;
+	long first_ssat_sect;
+	unsigned long num_ssat_sects;
+	long first_dis_sect;
+	unsigned long num_dis_sects;
+	unsigned long short_sect_cutoff;
+
+	// These are found in the thumbcache header.
+	unsigned long long cache_start;			// Offset of the first entry.
+	unsigned long long cache_end;			// Offset after the last entry that was written.
+	unsigned int cache_entry_header_size;
+
+	unsigned long count;		// Number of directory entries.
+
+	unsigned short sect_size;
+	unsigned short version;
+	unsigned char system;		// 0 = Unknown, 1 = Me/2000, 2 = XP/2003, 3 = Vista/2008/7
+	unsigned char database_type;	// DATABASE_TYPE_THUMBS or DATABASE_TYPE_CACHE
+};
+
+// This structure holds information obtained as we read the database. The listview moves it into a row of its entry table.
+struct fileinfo
+{
+	long long entry_hash;				// Hashed filename for Vista and above.
+	long long date_modified;			// Modified FILETIME
+	shared_info *si;
+	wchar_t *filename;					// Name of the database entry.
+	unsigned long offset;				// Offset in SAT or short stream container (depends on size of entry), or of the thumbcache entry's header
+	unsigned long size;					// Size of file.
+	char entry_type;
+	unsigned char flag;					// 1 = jpg, 2 = cmyk jpg, 4 = png, 8 = unknown, 32 = entry in arena, 64 = name in arena.
+};
+
+// Lets the parser report to whoever is using it. Any of the functions can be NULL.
+struct database_callbacks
+{
+	void *context;											// Passed to each function.
+	void ( *add_entry )( void *context, fileinfo *fi );		// A new entry was found. It belongs to the caller once it's been added.
+	void ( *entries_updated )( void *context, shared_info *si );	// The catalog has updated the names and dates of the added entries.
+	bool ( *is_cancelled )( void *context );				// Return true to stop processing.
+	void ( *report_error )( void *context, const char *message );
+};
+
+// Holds one entry of a batch that's passed to read_entries.
+struct entry_buffer
+{
+	char *buf;						// Reused from one batch to the next. It must be freed once the batches are done.
+	unsigned long buf_size;
+	char *data;						// Set to buf if the entry was read. NULL otherwise.
+	unsigned long size;				// Excludes the header offset.
+	unsigned long header_offset;
+};
+
+// Position within the directory's chain of sectors.
+struct directory_cursor
+{
+	sector_chain *chain;		// Chain of directory sectors.
+	unsigned long position;		// Position of the sector within the chain.
+	char *sector;				// Mapped sector that's being read. NULL if the next sector hasn't been read.
+	unsigned long read;			// Number of bytes available in the sector.
+	int item;					// Next directory item within the sector.
+	bool terminated;			// The directory ended with -2.
+	bool done;
+};
+
+struct sid_index;
+
+// Walks the entries of a database one at a time without keeping them.
+// Memory is bounded by the allocation tables, the short stream container's chain, the catalog's index, and the entry that's being read.
+struct entry_iterator
+{
+	fileinfo fi;					// The current entry. It's only valid until the next call to next_entry.
+
+	shared_info *si;
+	database_callbacks *dc;
+
+	char *buf;						// Holds the current entry's stream. It's reused for each entry.
+	unsigned long buf_size;
+	char *name_buf;					// Holds catalog names before they're converted.
+	unsigned long name_buf_size;
+
+	directory_cursor dir;
+
+	sector_chain *catalog_chain;
+	unsigned long catalog_length;
+	bool catalog_is_short;			// The catalog is in the short stream container.
+
+	unsigned long catalog_start;	// Offset of the first catalog entry.
+	unsigned long catalog_end;		// Offset after the last catalog entry that can be read.
+	unsigned long catalog_offset;	// Offset of the catalog entry we expect to match next.
+
+	sid_index *catalog_index;		// Finds catalog entries by their sid. Each position is a catalog entry.
+	unsigned long *catalog_offsets;	// Offset of the catalog entry at each position.
+	bool catalog_truncated;			// An invalid catalog entry ended the index. It hasn't been reported yet.
+
+	unsigned long long cache_offset;	// Offset of the next thumbcache entry.
+
+	unsigned long entry_count;		// Number of entries that have been returned.
+
+	bool catalog_found;
+	bool catalog_skipped;			// The catalog's own directory entry has been passed over.
+};
+
+void initialize_lock( database_lock *lock );
+void delete_lock( database_lock *lock );
+void enter_lock( database_lock *lock );
+void leave_lock( database_lock *lock );
+
+// Must be called before any database is read, and after every database has been cleaned up.
+void initialize_database_reader();
+void uninitialize_database_reader();
+
+char read_database( const wchar_t *path, database_callbacks *dc );
+char read_databases( const wchar_t **paths, unsigned long path_count, database_callbacks *dc, unsigned long thread_count );
+
+char open_database( const wchar_t *path, database_callbacks *dc, shared_info **si );
+char build_directory( shared_info *si, database_callbacks *dc );
+void close_database( shared_info **si );
+
+char open_entry_iterator( const wchar_t *path, database_callbacks *dc, entry_iterator *ei );
+char next_entry( entry_iterator *ei );
+char *read_current_entry( entry_iterator *ei, unsigned long &size, unsigned long &header_offset );
+void close_entry_iterator( entry_iterator *ei );
+
+// Reads the entry into buf, growing it if it's too small. Returns buf, or NULL if the entry could not be read.
+char *read_entry( fileinfo *fi, char *&buf, unsigned long &buf_size, unsigned long &size, unsigned long &header_offset, database_callbacks *dc );
+char *extract_entry( fileinfo *fi, unsigned long &size, unsigned long &header_offset, database_callbacks *dc );
+char read_entries( fileinfo **entries, unsigned long count, entry_buffer *ebs, database_callbacks *dc );
+
+file_map *acquire_database_map( shared_info *si );
+void release_database_map( shared_info *si );
+
+void cleanup_shared_info( shared_info **si );
+
+// Releases an entry that was added by read_database. Its database is cleaned up once its last entry has been released.
+void free_fileinfo( fileinfo *fi );
+
+void report_error( database_callbacks *dc, const char *message );
+bool is_cancelled( database_callbacks *dc );
+
+unsigned long convert_utf16_string( const char *string, unsigned long length, wchar_t *wide_string );
+wchar_t *copy_utf16_string( const char *string, unsigned long length );
+
+void *arena_alloc( shared_info *si, unsigned long size );
+void arena_shrink( shared_info *si, void *p, unsigned long old_size, unsigned long new_size );
+
+unsigned long get_processor_count();
+
+#endif
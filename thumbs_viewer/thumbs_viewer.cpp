@@ -50,6 +50,9 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLin
 	// Blocks our reading thread and various GUI operations.
 	InitializeCriticalSection( &pe_cs );
 
+	// Sets up the database reader's locks.
+	initialize_database_reader();
+
 	// Get the default message system font.
 	NONCLIENTMETRICS ncm = { NULL };
 	ncm.cbSize = sizeof( NONCLIENTMETRICS );
@@ -266,6 +269,8 @@ CLEANUP:
 	// Delete our critical section.
 	DeleteCriticalSection( &pe_cs );
 
+	uninitialize_database_reader();
+
 	// Shutdown GDI+
 	Gdiplus::GdiplusShutdown( gdiplusToken );
 
@@ -0,0 +1,157 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times inserting, finding, and tearing down typed_dllrbt against dllrbt. Run it with: make bench
+// rbt.h and dllrbt.h can't be included together, so typed_rbt is timed against rbt in typed_rbt_bench.
+#include "dllrbt.h"
+#include "typed_rbt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_NODES_PER_SIZE	3000000		// Small trees are rebuilt until about this many nodes have been timed.
+
+static unsigned long long random_state = 0xBB67AE8584CAA73BULL;
+
+// splitmix64
+static unsigned long long next_random()
+{
+	unsigned long long z = ( random_state += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+static int bench_compare( void *a, void *b )
+{
+	if ( a > b )
+	{
+		return 1;
+	}
+
+	if ( a < b )
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static void bench_nodes( unsigned long node_count )
+{
+	unsigned long *keys = ( unsigned long * )malloc( sizeof( unsigned long ) * node_count );
+	unsigned long *queries = ( unsigned long * )malloc( sizeof( unsigned long ) * node_count );
+
+	for ( unsigned long i = 0; i < node_count; ++i )
+	{
+		keys[ i ] = ( unsigned long )next_random();
+	}
+
+	// Half of the lookups are hits.
+	for ( unsigned long i = 0; i < node_count; ++i )
+	{
+		queries[ i ] = ( i % 2 == 0 ? keys[ next_random() % node_count ] : ( unsigned long )next_random() );
+	}
+
+	unsigned long repeats = ( BENCH_NODES_PER_SIZE / node_count ) + 1;
+	unsigned long total = repeats * node_count;
+
+	// The count keeps the lookups from being optimized away.
+	unsigned long found = 0;
+
+	clock_t insert_time = 0, find_time = 0, teardown_time = 0;
+	clock_t typed_insert_time = 0, typed_find_time = 0, typed_teardown_time = 0;
+
+	for ( unsigned long r = 0; r < repeats; ++r )
+	{
+		clock_t start = clock();
+
+		dllrbt_tree *tree = dllrbt_create( bench_compare );
+		for ( unsigned long i = 0; i < node_count; ++i )
+		{
+			dllrbt_insert( tree, ( void * )keys[ i ], ( void * )keys[ i ] );
+		}
+
+		clock_t split = clock();
+		insert_time += split - start;
+		start = split;
+
+		for ( unsigned long i = 0; i < node_count; ++i )
+		{
+			if ( dllrbt_find( tree, ( void * )queries[ i ], true ) != NULL )
+			{
+				++found;
+			}
+		}
+
+		split = clock();
+		find_time += split - start;
+		start = split;
+
+		dllrbt_delete_recursively( tree );
+
+		split = clock();
+		teardown_time += split - start;
+		start = split;
+
+		typed_dllrbt< unsigned long, unsigned long > *typed_tree = new typed_dllrbt< unsigned long, unsigned long >;
+		for ( unsigned long i = 0; i < node_count; ++i )
+		{
+			typed_tree->insert( keys[ i ], keys[ i ] );
+		}
+
+		split = clock();
+		typed_insert_time += split - start;
+		start = split;
+
+		for ( unsigned long i = 0; i < node_count; ++i )
+		{
+			if ( typed_tree->find( queries[ i ] ) != NULL )
+			{
+				++found;
+			}
+		}
+
+		split = clock();
+		typed_find_time += split - start;
+		start = split;
+
+		delete typed_tree;
+
+		typed_teardown_time += clock() - start;
+	}
+
+	double scale = 1000000000.0 / CLOCKS_PER_SEC / total;
+
+	printf( "%8lu nodes  insert: %-6s %6.1f ns  %-12s %6.1f ns  find: %6.1f ns  %6.1f ns  teardown: %5.1f ns  %5.1f ns  (%lu)\n",
+			node_count, "dllrbt", insert_time * scale, "typed_dllrbt", typed_insert_time * scale, find_time * scale, typed_find_time * scale,
+			teardown_time * scale, typed_teardown_time * scale, found );
+
+	free( queries );
+	free( keys );
+}
+
+int main()
+{
+	bench_nodes( 1000 );
+	bench_nodes( 100000 );
+	bench_nodes( 1000000 );
+
+	return 0;
+}
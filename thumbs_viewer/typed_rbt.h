@@ -0,0 +1,608 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Typed versions of rbt and dllrbt.
+// This Red-Black tree is based on an implementation by Thomas Niemann.
+// Refer to "Sorting and Searching Algorithms: A Cookbook"
+//
+// The keys and values are stored as their own types, and the comparison is a class that can be inlined.
+// Nodes come from a pool that belongs to the tree. They're freed a block at a time when the tree is cleared or destroyed.
+// Keys and values are copied by assignment and are never destroyed, so they should be plain types like numbers and pointers.
+
+#ifndef TYPED_RBT_H
+#define TYPED_RBT_H
+
+#include <stdlib.h>
+
+#define NODE_POOL_BLOCK_NODES	256		// Number of nodes in each block of a pool.
+
+// Returns less than 0, 0, or greater than 0 like the comparison functions of rbt and dllrbt.
+template < class Key >
+struct rbt_compare
+{
+	int operator()( const Key &a, const Key &b ) const
+	{
+		return ( a > b ? 1 : ( a < b ? -1 : 0 ) );
+	}
+};
+
+template < class Node >
+class node_pool
+{
+	struct pool_block
+	{
+		pool_block *next;
+		Node nodes[ NODE_POOL_BLOCK_NODES ];
+	};
+
+	pool_block *blocks;
+	unsigned int used;			// Nodes that have been handed out from the newest block.
+	Node *free_nodes;			// Nodes that were returned. Each one holds the next in its parent.
+
+public:
+	node_pool() : blocks( NULL ), used( NODE_POOL_BLOCK_NODES ), free_nodes( NULL ) {}
+	~node_pool() { release(); }
+
+	Node *allocate()
+	{
+		if ( free_nodes != NULL )
+		{
+			Node *n = free_nodes;
+			free_nodes = n->parent;
+			return n;
+		}
+
+		if ( used == NODE_POOL_BLOCK_NODES )
+		{
+			pool_block *block = ( pool_block * )malloc( sizeof( pool_block ) );
+			if ( block == NULL )
+			{
+				return NULL;
+			}
+
+			block->next = blocks;
+			blocks = block;
+			used = 0;
+		}
+
+		return &blocks->nodes[ used++ ];
+	}
+
+	void deallocate( Node *n )
+	{
+		n->parent = free_nodes;
+		free_nodes = n;
+	}
+
+	// Frees every node at once.
+	void release()
+	{
+		while ( blocks != NULL )
+		{
+			pool_block *del_block = blocks;
+			blocks = blocks->next;
+			free( del_block );
+		}
+
+		used = NODE_POOL_BLOCK_NODES;
+		free_nodes = NULL;
+	}
+
+private:
+	node_pool( const node_pool & );
+	node_pool &operator=( const node_pool & );
+};
+
+template < class Key, class Value >
+struct typed_rbt_node
+{
+	typed_rbt_node *left;		// Left child
+	typed_rbt_node *right;		// Right child
+	typed_rbt_node *parent;		// Parent
+	bool red;					// Node color (red or black)
+	Key key;					// Key used for searching
+	Value val;					// User data
+
+	typed_rbt_node *previous;	// Previous node. Only kept if the tree is linked.
+	typed_rbt_node *next;		// Next node. Only kept if the tree is linked.
+};
+
+// Linked trees also keep their nodes in a doubly-linked list that's in key order.
+template < class Key, class Value, class Compare, bool Linked >
+class typed_rbt_base
+{
+public:
+	typedef typed_rbt_node< Key, Value > node;
+
+	typed_rbt_base() { reset(); }
+
+	// Returns false if the key is already in the tree, or if there's no memory for it.
+	bool insert( const Key &key, const Value &val )
+	{
+		node *current = root;
+		node *parent = NULL;
+		int rc = 0;
+
+		// Find the future parent.
+		while ( current != &sentinel )
+		{
+			rc = compare( key, current->key );
+			if ( rc == 0 )
+			{
+				return false;
+			}
+			parent = current;
+			current = ( rc < 0 ) ? current->left : current->right;
+		}
+
+		node *x = pool.allocate();
+		if ( x == NULL )
+		{
+			return false;
+		}
+		x->parent = parent;
+		x->left = &sentinel;
+		x->right = &sentinel;
+		x->red = true;
+		x->key = key;
+		x->val = val;
+		x->previous = NULL;
+		x->next = NULL;
+
+		// Insert node in tree
+		if ( parent != NULL )
+		{
+			if ( rc < 0 )
+			{
+				if ( Linked )
+				{
+					x->next = parent;
+					x->previous = parent->previous;
+					if ( parent->previous != NULL )
+					{
+						parent->previous->next = x;
+					}
+					parent->previous = x;
+
+					if ( head == parent )
+					{
+						head = x;
+					}
+				}
+
+				parent->left = x;
+			}
+			else
+			{
+				if ( Linked )
+				{
+					x->previous = parent;
+					x->next = parent->next;
+					if ( parent->next != NULL )
+					{
+						parent->next->previous = x;
+					}
+					parent->next = x;
+
+					if ( tail == parent )
+					{
+						tail = x;
+					}
+				}
+
+				parent->right = x;
+			}
+		}
+		else
+		{
+			head = x;
+			tail = x;
+
+			root = x;
+		}
+
+		++count;
+
+		insert_fixup( x );
+
+		return true;
+	}
+
+	// Removes the node from the tree. Its key and value aren't freed.
+	void remove( node *z )
+	{
+		node *x, *y;
+
+		if ( z->left == &sentinel || z->right == &sentinel )
+		{
+			y = z;	// y has a sentinel node as a child
+		}
+		else
+		{
+			// Find tree successor with a sentinel node as a child
+			y = z->right;
+			while ( y->left != &sentinel )
+			{
+				y = y->left;
+			}
+		}
+
+		// x is y's only child
+		x = ( y->left != &sentinel ? y->left : y->right );
+
+		// Remove y from the parent chain
+		x->parent = y->parent;
+		if ( y->parent != NULL )
+		{
+			if ( y == y->parent->left )
+			{
+				y->parent->left = x;
+			}
+			else
+			{
+				y->parent->right = x;
+			}
+		}
+		else
+		{
+			root = x;
+		}
+
+		// y is z's successor, so z takes its place in the list as well.
+		if ( y != z )
+		{
+			z->key = y->key;
+			z->val = y->val;
+		}
+
+		if ( y->red == false )
+		{
+			delete_fixup( x );
+		}
+
+		if ( Linked )
+		{
+			if ( y->previous != NULL )
+			{
+				y->previous->next = y->next;
+			}
+			else	// y is the head, update the head.
+			{
+				head = y->next;
+			}
+
+			if ( y->next != NULL )
+			{
+				y->next->previous = y->previous;
+			}
+			else	// y is the tail, update the tail.
+			{
+				tail = y->previous;
+			}
+		}
+
+		pool.deallocate( y );
+
+		--count;
+	}
+
+	// Returns the node with the key, or NULL if there isn't one.
+	node *find( const Key &key ) const
+	{
+		node *current = root;
+		while ( current != &sentinel )
+		{
+			int rc = compare( key, current->key );
+			if ( rc == 0 )
+			{
+				return current;
+			}
+			current = ( rc < 0 ) ? current->left : current->right;
+		}
+
+		return NULL;
+	}
+
+	// Returns the value associated with the key, or not_found if there isn't one.
+	Value find_value( const Key &key, const Value &not_found ) const
+	{
+		node *n = find( key );
+
+		return ( n != NULL ? n->val : not_found );
+	}
+
+	unsigned int get_count() const { return count; }
+
+	// Removes every node. Their keys and values aren't freed.
+	void clear()
+	{
+		pool.release();
+		reset();
+	}
+
+protected:
+	node *head;		// Head node of the doubly-linked list.
+	node *tail;		// Tail node of the doubly-linked list.
+
+private:
+	node *root;		// Root node of red-black tree.
+	node sentinel;
+	Compare compare;
+	node_pool< node > pool;
+	unsigned int count;
+
+	void reset()
+	{
+		root = &sentinel;
+		sentinel.left = &sentinel;
+		sentinel.right = &sentinel;
+		sentinel.parent = NULL;
+		sentinel.red = false;
+		sentinel.previous = NULL;
+		sentinel.next = NULL;
+		head = NULL;
+		tail = NULL;
+		count = 0;
+	}
+
+	void rotate_left( node *x )
+	{
+		// Rotate node x to the left
+		node *y = x->right;
+
+		// Establish x->right link
+		x->right = y->left;
+		if ( y->left != &sentinel )
+		{
+			y->left->parent = x;
+		}
+
+		// Establish y->parent link
+		if ( y != &sentinel )
+		{
+			y->parent = x->parent;
+		}
+
+		if ( x->parent != NULL )
+		{
+			if ( x == x->parent->left )
+			{
+				x->parent->left = y;
+			}
+			else
+			{
+				x->parent->right = y;
+			}
+		}
+		else
+		{
+			root = y;
+		}
+
+		// Link x and y
+		y->left = x;
+		if ( x != &sentinel )
+		{
+			x->parent = y;
+		}
+	}
+
+	void rotate_right( node *x )
+	{
+		// Rotate node x to the right
+		node *y = x->left;
+
+		// Establish x->left link
+		x->left = y->right;
+		if ( y->right != &sentinel )
+		{
+			y->right->parent = x;
+		}
+
+		// Establish y->parent link
+		if ( y != &sentinel )
+		{
+			y->parent = x->parent;
+		}
+
+		if ( x->parent != NULL )
+		{
+			if ( x == x->parent->right )
+			{
+				x->parent->right = y;
+			}
+			else
+			{
+				x->parent->left = y;
+			}
+		}
+		else
+		{
+			root = y;
+		}
+
+		// Link x and y
+		y->right = x;
+		if ( x != &sentinel )
+		{
+			x->parent = y;
+		}
+	}
+
+	void insert_fixup( node *x )
+	{
+		// Maintain red-black tree balance after inserting node x and check red-black properties
+		while ( x != root && x->parent->red == true )
+		{
+			// We have a violation
+			if ( x->parent == x->parent->parent->left )
+			{
+				node *y = x->parent->parent->right;
+				if ( y->red == true )
+				{
+					// Uncle is red
+					x->parent->red = false;
+					y->red = false;
+					x->parent->parent->red = true;
+					x = x->parent->parent;
+				}
+				else
+				{
+					// Uncle is black
+					if ( x == x->parent->right )
+					{
+						// Make x a left child
+						x = x->parent;
+						rotate_left( x );
+					}
+
+					// Recolor and rotate
+					x->parent->red = false;
+					x->parent->parent->red = true;
+					rotate_right( x->parent->parent );
+				}
+			}
+			else
+			{
+				// Mirror image of above code
+				node *y = x->parent->parent->left;
+				if ( y->red == true )
+				{
+					// Uncle is red
+					x->parent->red = false;
+					y->red = false;
+					x->parent->parent->red = true;
+					x = x->parent->parent;
+				}
+				else
+				{
+					// Uncle is black
+					if ( x == x->parent->left )
+					{
+						x = x->parent;
+						rotate_right( x );
+					}
+					x->parent->red = false;
+					x->parent->parent->red = true;
+					rotate_left( x->parent->parent );
+				}
+			}
+		}
+
+		root->red = false;
+	}
+
+	void delete_fixup( node *x )
+	{
+		// Maintain red-black tree balance after deleting node x
+		while ( x != root && x->red == false )
+		{
+			if ( x == x->parent->left )
+			{
+				node *w = x->parent->right;
+				if ( w->red == true )
+				{
+					w->red = false;
+					x->parent->red = true;
+					rotate_left( x->parent );
+					w = x->parent->right;
+				}
+
+				if ( w->left->red == false && w->right->red == false )
+				{
+					w->red = true;
+					x = x->parent;
+				}
+				else
+				{
+					if ( w->right->red == false )
+					{
+						w->left->red = false;
+						w->red = true;
+						rotate_right( w );
+						w = x->parent->right;
+					}
+
+					w->red = x->parent->red;
+					x->parent->red = false;
+					w->right->red = false;
+					rotate_left( x->parent );
+					x = root;
+				}
+			}
+			else
+			{
+				node *w = x->parent->left;
+				if ( w->red == true )
+				{
+					w->red = false;
+					x->parent->red = true;
+					rotate_right( x->parent );
+					w = x->parent->left;
+				}
+
+				if ( w->right->red == false && w->left->red == false )
+				{
+					w->red = true;
+					x = x->parent;
+				}
+				else
+				{
+					if ( w->left->red == false )
+					{
+						w->right->red = false;
+						w->red = true;
+						rotate_left( w );
+						w = x->parent->left;
+					}
+
+					w->red = x->parent->red;
+					x->parent->red = false;
+					w->left->red = false;
+					rotate_right( x->parent );
+					x = root;
+				}
+			}
+		}
+
+		x->red = false;
+	}
+
+	typed_rbt_base( const typed_rbt_base & );
+	typed_rbt_base &operator=( const typed_rbt_base & );
+};
+
+template < class Key, class Value, class Compare = rbt_compare< Key > >
+class typed_rbt : public typed_rbt_base< Key, Value, Compare, false >
+{
+};
+
+template < class Key, class Value, class Compare = rbt_compare< Key > >
+class typed_dllrbt : public typed_rbt_base< Key, Value, Compare, true >
+{
+public:
+	typedef typename typed_rbt_base< Key, Value, Compare, true >::node node;
+
+	// Returns the head of the doubly-linked list.
+	node *get_head() const { return this->head; }
+
+	// Returns the tail of the doubly-linked list.
+	node *get_tail() const { return this->tail; }
+};
+
+#endif
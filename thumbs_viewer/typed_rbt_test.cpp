@@ -0,0 +1,201 @@
+/*
+    thumbs_viewer will extract thumbnail images from thumbs database files.
+    Copyright (C) 2011-2015 Eric Kutcher
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Checks typed_rbt and typed_dllrbt against a std::map while keys are inserted, found, and removed. Run it with: make check
+#include "typed_rbt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+
+#define TEST_ROUNDS			3
+#define TEST_OPERATIONS		200000
+#define TEST_KEY_RANGE		5000		// Small enough that keys are often already in the tree.
+#define TEST_CHECK_INTERVAL	10007
+
+static unsigned long failures = 0;
+static unsigned long long random_state = 0x6A09E667F3BCC909ULL;
+
+// splitmix64
+static unsigned long long next_random()
+{
+	unsigned long long z = ( random_state += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+static void fail( const char *tree_name, const char *message, unsigned long key )
+{
+	if ( failures++ < 10 )
+	{
+		fprintf( stderr, "%s: %s: key %lu\n", tree_name, message, key );
+	}
+}
+
+// The list has to hold every key in order, in both directions.
+static void check_list( typed_dllrbt< unsigned long, unsigned long > &tree, std::map< unsigned long, unsigned long > &expected )
+{
+	std::map< unsigned long, unsigned long >::iterator i = expected.begin();
+	for ( typed_dllrbt< unsigned long, unsigned long >::node *n = tree.get_head(); n != NULL; n = n->next, ++i )
+	{
+		if ( i == expected.end() || i->first != n->key || i->second != n->val )
+		{
+			fail( "typed_dllrbt", "the list is out of order", n->key );
+
+			return;
+		}
+	}
+
+	if ( i != expected.end() )
+	{
+		fail( "typed_dllrbt", "the list is missing keys", i->first );
+	}
+
+	std::map< unsigned long, unsigned long >::reverse_iterator r = expected.rbegin();
+	for ( typed_dllrbt< unsigned long, unsigned long >::node *n = tree.get_tail(); n != NULL; n = n->previous, ++r )
+	{
+		if ( r == expected.rend() || r->first != n->key )
+		{
+			fail( "typed_dllrbt", "the list is out of order backwards", n->key );
+
+			return;
+		}
+	}
+}
+
+// typed_rbt has no list.
+static void check_list( typed_rbt< unsigned long, unsigned long > &, std::map< unsigned long, unsigned long > & )
+{
+}
+
+// Every key in the range is looked up, so both hits and misses are checked.
+template < class Tree >
+static void check_keys( const char *tree_name, Tree &tree, std::map< unsigned long, unsigned long > &expected )
+{
+	if ( tree.get_count() != expected.size() )
+	{
+		fail( tree_name, "the count is wrong", tree.get_count() );
+	}
+
+	for ( unsigned long key = 0; key < TEST_KEY_RANGE; ++key )
+	{
+		std::map< unsigned long, unsigned long >::iterator i = expected.find( key );
+		unsigned long want = ( i != expected.end() ? i->second : 0xFFFFFFFF );
+
+		if ( tree.find_value( key, 0xFFFFFFFF ) != want )
+		{
+			fail( tree_name, "find_value doesn't match", key );
+		}
+	}
+
+	check_list( tree, expected );
+}
+
+template < class Tree >
+static void check_tree( const char *tree_name, Tree &tree )
+{
+	std::map< unsigned long, unsigned long > expected;
+
+	for ( int round = 0; round < TEST_ROUNDS; ++round )
+	{
+		for ( unsigned long i = 0; i < TEST_OPERATIONS; ++i )
+		{
+			unsigned long key = ( unsigned long )( next_random() % TEST_KEY_RANGE );
+			unsigned long operation = ( unsigned long )( next_random() % 3 );
+
+			if ( operation == 0 )
+			{
+				unsigned long val = ( unsigned long )next_random();
+				bool inserted = tree.insert( key, val );
+				if ( inserted != expected.insert( std::make_pair( key, val ) ).second )
+				{
+					fail( tree_name, "insert doesn't match", key );
+				}
+			}
+			else if ( operation == 1 )
+			{
+				typename Tree::node *n = tree.find( key );
+				std::map< unsigned long, unsigned long >::iterator j = expected.find( key );
+				if ( ( n != NULL ) != ( j != expected.end() ) )
+				{
+					fail( tree_name, "find doesn't match", key );
+				}
+				else if ( n != NULL )
+				{
+					tree.remove( n );
+					expected.erase( j );
+				}
+			}
+			else
+			{
+				std::map< unsigned long, unsigned long >::iterator j = expected.find( key );
+				if ( tree.find_value( key, 0xFFFFFFFF ) != ( j != expected.end() ? j->second : 0xFFFFFFFF ) )
+				{
+					fail( tree_name, "find_value doesn't match", key );
+				}
+			}
+
+			if ( i % TEST_CHECK_INTERVAL == 0 )
+			{
+				check_keys( tree_name, tree, expected );
+			}
+		}
+
+		check_keys( tree_name, tree, expected );
+
+		// Odd rounds empty the tree one node at a time, the others clear it all at once.
+		if ( round % 2 == 1 )
+		{
+			while ( expected.empty() == false )
+			{
+				typename Tree::node *n = tree.find( expected.begin()->first );
+				if ( n == NULL )
+				{
+					fail( tree_name, "a key is missing", expected.begin()->first );
+
+					break;
+				}
+
+				tree.remove( n );
+				expected.erase( expected.begin() );
+			}
+		}
+		else
+		{
+			tree.clear();
+			expected.clear();
+		}
+
+		check_keys( tree_name, tree, expected );
+	}
+}
+
+int main()
+{
+	typed_rbt< unsigned long, unsigned long > tree;
+	check_tree( "typed_rbt", tree );
+
+	typed_dllrbt< unsigned long, unsigned long > linked_tree;
+	check_tree( "typed_dllrbt", linked_tree );
+
+	printf( "%s: %lu failures\n", ( failures == 0 ? "PASS" : "FAIL" ), failures );
+
+	return ( failures == 0 ? 0 : 1 );
+}
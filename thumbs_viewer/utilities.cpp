@@ -30,7 +30,9 @@ CRITICAL_SECTION pe_cs;				// Queues additional worker threads.
 bool in_thread = false;				// Flag to indicate that we're in a worker thread.
 bool skip_draw = false;				// Prevents WM_DRAWITEM from accessing listview items while we're removing them.
 
-dllrbt_tree *fileinfo_tree = NULL;	// Red-black tree of fileinfo structures.
+entry_table g_entry_table = { NULL };	// Holds the entries that are in the listview.
+hash_table entry_hash_table = { NULL };	// Entry rows, keyed by their entry hash.
+bloom_filter entry_bloom_filter = { NULL };	// Rules out most hashes before the entry hash table is searched.
 
 bool is_close( int a, int b )
 {
@@ -57,21 +59,6 @@ void Processing_Window( bool enable )
 	}
 }
 
-int dllrbt_compare( void *a, void *b )
-{
-	if ( a > b )
-	{
-		return 1;
-	}
-
-	if ( a < b )
-	{
-		return -1;
-	}
-
-	return 0;
-}
-
 wchar_t *get_extension_from_filename( wchar_t *filename, unsigned long length )
 {
 	while ( length != 0 && filename[ --length ] != L'.' );
@@ -90,127 +77,54 @@ wchar_t *get_filename_from_path( wchar_t *path, unsigned long length )
 	return path + length;
 }
 
-void reverse_string( wchar_t *string )
+// Files a new row under its entry hash, so that a scan doesn't have to go through every entry first.
+// Only the entries of a thumbs database that are named after their hashed filename can be mapped.
+void add_entry_hash( unsigned long row )
 {
-	if ( string == NULL )
+	long long entry_hash = ENTRY_FIELD( &g_entry_table, row, entry_hash );
+	if ( entry_hash == 0 || ENTRY_FIELD( &g_entry_table, row, si )->database_type != DATABASE_TYPE_THUMBS )
 	{
 		return;
 	}
 
-	int end = wcslen( string ) - 1;
-	int start = 0;
+	// Rows with the same hash each get their own slot.
+	insert_hash_row( &entry_hash_table, entry_hash, row );
 
-	while ( start < end )
+	// The filter can't grow, so it's rebuilt from the table once it's full. This also drops the hashes of rows that were taken out.
+	if ( entry_bloom_filter.key_count >= entry_bloom_filter.capacity )
 	{
-		string[ start ] ^= string[ end ];
-		string[ end ] ^= string[ start ];
-		string[ start ] ^= string[ end ];
-
-		++start;
-		--end;
-	}
-}
+		free_bloom_filter( &entry_bloom_filter );
+		create_bloom_filter( &entry_bloom_filter, entry_hash_table.row_count * 2 );
 
-void cleanup_shared_info( shared_info **si )
-{
-	free( ( *si )->short_stream_container );
-	free( ( *si )->ssat );
-	free( ( *si )->sat );
-	free( *si );
-	*si = NULL;
-}
-
-void cleanup_fileinfo_tree()
-{
-	// Free the values of the fileinfo tree.
-	node_type *node = dllrbt_get_head( fileinfo_tree );
-	while ( node != NULL )
-	{
-		// Free the linked list if there is one.
-		linked_list *fi_node = ( linked_list * )node->val;
-		while ( fi_node != NULL )
+		for ( unsigned long i = 0; i < entry_hash_table.slot_count; ++i )
 		{
-			linked_list *del_fi_node = fi_node;
-
-			fi_node = fi_node->next;
-
-			free( del_fi_node );
+			if ( entry_hash_table.slots[ i ].row != 0 )
+			{
+				add_bloom_filter( &entry_bloom_filter, entry_hash_table.slots[ i ].hash );
+			}
 		}
-
-		node = node->next;
 	}
-
-	// Clean up our fileinfo tree.
-	dllrbt_delete_recursively( fileinfo_tree );
-	fileinfo_tree = NULL;
+	else
+	{
+		add_bloom_filter( &entry_bloom_filter, entry_hash );
+	}
 }
 
-void create_fileinfo_tree()
+// Takes the row out of the entry hash table once it's been mapped or removed.
+// Its hash is left in the Bloom filter. That only lets a few more hashes through to the table.
+void remove_entry_hash( unsigned long row )
 {
-	LVITEM lvi = { NULL };
-	lvi.mask = LVIF_PARAM;
-
-	fileinfo *fi = NULL;
-
-	int item_count = SendMessage( g_hWnd_list, LVM_GETITEMCOUNT, 0, 0 );
-
-	// Create the fileinfo tree if it doesn't exist.
-	if ( fileinfo_tree == NULL )
+	long long entry_hash = ENTRY_FIELD( &g_entry_table, row, entry_hash );
+	if ( entry_hash != 0 )
 	{
-		fileinfo_tree = dllrbt_create( dllrbt_compare );
+		remove_hash_row( &entry_hash_table, entry_hash, row );
 	}
+}
 
-	// Go through each item and add them to our tree.
-	for ( int i = 0; i < item_count; ++i )
-	{
-		// We don't want to continue scanning if the user cancels the scan.
-		if ( g_kill_scan == true )
-		{
-			break;
-		}
-
-		lvi.iItem = i;
-		SendMessage( g_hWnd_list, LVM_GETITEM, 0, ( LPARAM )&lvi );
-
-		fi = ( fileinfo * )lvi.lParam;
-
-		// Don't attempt to insert the fileinfo if it's already in the tree.
-		if ( fi != NULL )
-		{
-			// Make sure it's a hashed filename. It should be formatted like: 256_0123456789ABCDEF
-			wchar_t *filename = wcschr( fi->filename, L'_' );
-
-			if ( filename != NULL )
-			{
-				int filename_length = wcslen( filename + 1 );
-				if ( filename_length <= 16 && filename_length >= 0 )
-				{
-					fi->entry_hash = _wcstoui64( filename + 1, NULL, 16 );
-
-					// Create the node to insert into a linked list.
-					linked_list *fi_node = ( linked_list * )malloc( sizeof( linked_list ) );
-					fi_node->fi = fi;
-					fi_node->next = NULL;
-
-					// See if our tree has the hash to add the node to.
-					linked_list *ll = ( linked_list * )dllrbt_find( fileinfo_tree, ( void * )fi->entry_hash, true );
-					if ( ll == NULL )
-					{
-						if ( dllrbt_insert( fileinfo_tree, ( void * )fi->entry_hash, fi_node ) != DLLRBT_STATUS_OK )
-						{
-							free( fi_node );
-						}
-					}
-					else	// If a hash exits, insert the node into the linked list.
-					{
-						linked_list *next = ll->next;	// We'll insert the node after the head.
-						fi_node->next = next;
-						ll->next = fi_node;
-					}
-				}
-			}
-		}
-	}
+void clear_entry_hashes()
+{
+	free_hash_table( &entry_hash_table );
+	free_bloom_filter( &entry_bloom_filter );
 }
 
 int GetEncoderClsid( const WCHAR *format, CLSID *pClsid )
@@ -459,13 +373,17 @@ unsigned __stdcall copy_items( void *pArguments )
 
 		SendMessage( g_hWnd_list, LVM_GETITEM, 0, ( LPARAM )&lvi );
 
-		fileinfo *fi = ( fileinfo * )lvi.lParam;
+		unsigned long row = ( unsigned long )lvi.lParam;
 
-		if ( fi == NULL || ( fi != NULL && fi->si == NULL ) )
+		if ( !is_entry_row( &g_entry_table, row ) )
 		{
 			continue;
 		}
 
+		fileinfo entry;
+		get_entry_row( &g_entry_table, row, &entry );
+		fileinfo *fi = &entry;
+
 		add_newline = add_tab = false;
 
 		for ( int j = 1; j < NUM_COLUMNS; ++j )
@@ -490,8 +408,8 @@ unsigned __stdcall copy_items( void *pArguments )
 
 				case 3:
 				{
-					// Distinguish between Short SAT and SAT entries.
-					value_length = swprintf_s( buf, MAX_PATH, ( fi->size < fi->si->short_sect_cutoff ? L"%d in SSAT" : L"%d in SAT" ), fi->offset );
+					// Distinguish between Short SAT, SAT, and thumbcache entries.
+					value_length = swprintf_s( buf, MAX_PATH, ( fi->si->database_type == DATABASE_TYPE_CACHE ? L"%d in cache" : ( fi->size < fi->si->short_sect_cutoff ? L"%d in SSAT" : L"%d in SAT" ) ), fi->offset );
 				}
 				break;
 
@@ -660,48 +578,15 @@ unsigned __stdcall remove_items( void *pArguments )
 	LVITEM lvi = { NULL };
 	lvi.mask = LVIF_PARAM;
 
-	fileinfo *fi = NULL;
-
 	int item_count = SendMessage( g_hWnd_list, LVM_GETITEMCOUNT, 0, 0 );
 	int sel_count = SendMessage( g_hWnd_list, LVM_GETSELECTEDCOUNT, 0, 0 );
 
 	// See if we've selected all the items. We can clear the list much faster this way.
 	if ( item_count == sel_count )
 	{
-		// Go through each item, and free their lParam values. current_fileinfo will get deleted here.
-		for ( int i = 0; i < item_count; ++i )
-		{
-			// Stop processing and exit the thread.
-			if ( g_kill_thread == true )
-			{
-				break;
-			}
-
-			// We first need to get the lParam value otherwise the memory won't be freed.
-			lvi.iItem = i;
-			SendMessage( g_hWnd_list, LVM_GETITEM, 0, ( LPARAM )&lvi );
-
-			fi = ( fileinfo * )lvi.lParam;
-
-			if ( fi != NULL )
-			{
-				if ( fi->si != NULL )
-				{
-					--( fi->si->count );
-
-					// Remove our shared information from the linked list if there's no more items for this database.
-					if ( fi->si->count == 0 )
-					{
-						cleanup_shared_info( &( fi->si ) );
-					}
-				}
-
-				// First free the filename pointer. We don't need to bother with the linked list pointer since it's only used during the initial read.
-				free( fi->filename );
-				// Then free the fileinfo structure.
-				free( fi );
-			}
-		}
+		// Frees every filename, and the shared information of each database. current_row will get deleted here.
+		clear_entry_table( &g_entry_table );
+		clear_entry_hashes();
 
 		SendMessage( g_hWnd_list, LVM_DELETEALLITEMS, 0, 0 );
 	}
@@ -734,27 +619,16 @@ unsigned __stdcall remove_items( void *pArguments )
 			lvi.iItem = index_array[ i ];
 			SendMessage( g_hWnd_list, LVM_GETITEM, 0, ( LPARAM )&lvi );
 
-			fi = ( fileinfo * )lvi.lParam;
-
-			if ( fi != NULL )
+			// The row can be handed out again, so it can't be left in the entry hash table.
+			if ( is_entry_row( &g_entry_table, ( unsigned long )lvi.lParam ) )
 			{
-				if ( fi->si != NULL )
-				{
-					--( fi->si->count );
-
-					// Remove our shared information from the linked list if there's no more items for this database.
-					if ( fi->si->count == 0 )
-					{
-						cleanup_shared_info( &( fi->si ) );
-					}
-				}
-		
-				// Free our filename, then fileinfo structure. We don't need to bother with the linked list pointer since it's only used during the initial read.
-				free( fi->filename );
-				// Then free the fileinfo structure.
-				free( fi );
+				remove_entry_hash( ( unsigned long )lvi.lParam );
 			}
 
+			// Frees the filename, and the shared information if there's no more items for this database.
+			// Entries that came out of the database's arena are only released once the last of them is removed.
+			remove_entry_row( &g_entry_table, ( unsigned long )lvi.lParam );
+
 			// Remove the list item.
 			SendMessage( g_hWnd_list, LVM_DELETEITEM, index_array[ i ], 0 );
 		}
@@ -869,7 +743,8 @@ unsigned __stdcall save_csv( void *pArguments )
 			LVITEM lvi = { NULL };
 			lvi.mask = LVIF_PARAM;
 
-			fileinfo *fi = NULL;
+			fileinfo entry;
+			fileinfo *fi = &entry;
 
 			// Go through all the items we'll be saving.
 			for ( int i = 0; i < save_items; ++i )
@@ -883,12 +758,14 @@ unsigned __stdcall save_csv( void *pArguments )
 				lvi.iItem = i;
 				SendMessage( g_hWnd_list, LVM_GETITEM, 0, ( LPARAM )&lvi );
 
-				fi = ( fileinfo * )lvi.lParam;
-				if ( fi == NULL || ( fi != NULL && fi->si == NULL ) )
+				unsigned long row = ( unsigned long )lvi.lParam;
+				if ( !is_entry_row( &g_entry_table, row ) )
 				{
 					continue;
 				}
 
+				get_entry_row( &g_entry_table, row, fi );
+
 				int filename_length = WideCharToMultiByte( CP_UTF8, 0, ( fi->filename != NULL ? fi->filename : L"" ), -1, NULL, 0, NULL, NULL );
 				char *utf8_filename = ( char * )malloc( sizeof( char ) * filename_length ); // Size includes the null character.
 				filename_length = WideCharToMultiByte( CP_UTF8, 0, ( fi->filename != NULL ? fi->filename : L"" ), -1, utf8_filename, filename_length, NULL, NULL ) - 1;
@@ -944,11 +821,11 @@ unsigned __stdcall save_csv( void *pArguments )
 					write_buf_offset = 0;
 				}
 
-				write_buf_offset += sprintf_s( write_buf + write_buf_offset, size - write_buf_offset, "\r\n\"%s\",%lu,%d in %sSAT,",
+				write_buf_offset += sprintf_s( write_buf + write_buf_offset, size - write_buf_offset, "\r\n\"%s\",%lu,%d in %s,",
 											   utf8_filename,
 											   fi->size,
 											   fi->offset,
-											   ( fi->size < fi->si->short_sect_cutoff ? "S" : "" ) );
+											   ( fi->si->database_type == DATABASE_TYPE_CACHE ? "cache" : ( fi->size < fi->si->short_sect_cutoff ? "SSAT" : "SAT" ) ) );
 
 				if ( fi->date_modified != 0 )
 				{
@@ -1019,6 +896,312 @@ unsigned __stdcall save_csv( void *pArguments )
 	return 0;
 }
 
+// An entry that's being saved. A worker fills it in and the save thread writes it out.
+struct save_slot
+{
+	fileinfo fi;				// A copy of the entry's row.
+	unsigned long row;
+	wchar_t fullpath[ ( MAX_PATH * 2 ) + 6 ];	// Directory + backslash + filename + extension + NULL character = ( MAX_PATH * 2 ) + 6
+
+	char *buf;					// Reused by every entry that passes through the slot.
+	unsigned long buf_size;
+
+	char *data;					// What will be written to the file. NULL if there's nothing to write.
+	unsigned long size;
+	IStream *converted;			// Holds the data of a CMYK JPEG or raw bitmap once it's been re-encoded.
+
+	char **errors;				// Reported while the entry was extracted or converted.
+	unsigned long error_count;
+	unsigned long errors_size;
+
+	HANDLE done;				// Signaled once the worker is finished with the entry.
+};
+
+// Entries wait in a fixed number of slots. Each slot is written out in order before it's reused, so memory stays flat.
+struct save_queue
+{
+	save_slot *slots;
+	unsigned long slot_count;
+
+	unsigned long next_job;		// Next entry that a worker will take.
+	unsigned long job_count;	// Number of entries that have been queued.
+
+	HANDLE jobs;				// Counts the queued entries, and then one more for each worker once we're finished.
+	CRITICAL_SECTION lock;
+
+	wchar_t *save_directory;
+
+	CLSID jpgClsid;
+	CLSID pngClsid;
+};
+
+bool save_is_cancelled( void *context )
+{
+	return g_kill_thread;
+}
+
+// Keep the error so that the save thread can show it when the entry is written out.
+void save_report_error( void *context, const char *message )
+{
+	save_slot *slot = ( save_slot * )context;
+
+	if ( slot->error_count == slot->errors_size )
+	{
+		slot->errors_size = ( slot->errors_size == 0 ? 4 : slot->errors_size * 2 );
+		slot->errors = ( char ** )realloc( slot->errors, sizeof( char * ) * slot->errors_size );
+	}
+
+	unsigned long message_length = strlen( message ) + 1;	// Include the NULL character.
+	slot->errors[ slot->error_count ] = ( char * )malloc( sizeof( char ) * message_length );
+	memcpy( slot->errors[ slot->error_count++ ], message, message_length );
+}
+
+void get_save_path( fileinfo *fi, unsigned long header_offset, wchar_t *save_directory, wchar_t *fullpath )
+{
+	wchar_t *filename = get_filename_from_path( fi->filename, wcslen( fi->filename ) );
+
+	if ( ( fi->flag & FIF_TYPE_JPG ) || ( fi->flag & FIF_TYPE_CMYK_JPG ) )
+	{
+		wchar_t *ext = get_extension_from_filename( filename, wcslen( filename ) );
+		// The extension in the filename might not be the actual type. So we'll append .jpg to the end of it.
+		if ( _wcsicmp( ext, L".jpg" ) == 0 || _wcsicmp( ext, L".jpeg" ) == 0 )
+		{
+			swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s", save_directory, filename );
+		}
+		else
+		{
+			swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s.jpg", save_directory, filename );
+		}
+	}
+	else if ( ( fi->flag & FIF_TYPE_PNG ) || ( ( fi->flag & FIF_TYPE_UNKNOWN ) && header_offset > 0 ) )
+	{
+		wchar_t *ext = get_extension_from_filename( filename, wcslen( filename ) );
+		// The extension in the filename might not be the actual type. So we'll append .png to the end of it.
+		if ( _wcsicmp( ext, L".png" ) == 0 )
+		{
+			swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s", save_directory, filename );
+		}
+		else
+		{
+			swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s.png", save_directory, filename );
+		}
+	}
+	else
+	{
+		swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s", save_directory, filename );
+	}
+}
+
+// Extracts the entry and converts it if it needs to be. Nothing is written to disk here.
+void prepare_save_slot( save_queue *sq, save_slot *slot )
+{
+	slot->data = NULL;
+	slot->size = 0;
+	slot->converted = NULL;
+
+	if ( g_kill_thread == true )
+	{
+		return;
+	}
+
+	database_callbacks dc;
+	dc.context = ( void * )slot;
+	dc.add_entry = NULL;
+	dc.entries_updated = NULL;
+	dc.is_cancelled = save_is_cancelled;
+	dc.report_error = save_report_error;
+
+	fileinfo *fi = &slot->fi;
+
+	unsigned long size = 0, header_offset = 0;	// Size excludes the header offset.
+	// The slot's buffer is reused for our new bitmap.
+	char *save_image = read_entry( fi, slot->buf, slot->buf_size, size, header_offset, &dc );
+
+	// Keep the type that was found.
+	ENTRY_FIELD( &g_entry_table, slot->row, flag ) |= fi->flag;
+
+	if ( save_image == NULL )
+	{
+		return;
+	}
+
+	get_save_path( fi, header_offset, sq->save_directory, slot->fullpath );
+
+	// If we have a CMYK based JPEG, then we're going to have to convert it to RGB.
+	if ( fi->flag & FIF_TYPE_CMYK_JPG )
+	{
+		Gdiplus::Image *save_bm_image = create_image( save_image + header_offset, size, 1 );
+
+		Gdiplus::EncoderParameters encoderParameters;
+		encoderParameters.Count = 1;
+		encoderParameters.Parameter[ 0 ].Guid = Gdiplus::EncoderQuality;
+		encoderParameters.Parameter[ 0 ].Type = Gdiplus::EncoderParameterValueTypeLong;
+		encoderParameters.Parameter[ 0 ].NumberOfValues = 1;
+		ULONG quality = 100;
+		encoderParameters.Parameter[ 0 ].Value = &quality;
+
+		// The size will differ from what's listed in the database since we had to reconstruct the image.
+		// Switch the encoder to PNG or BMP to save a lossless image.
+		CreateStreamOnHGlobal( NULL, TRUE, &slot->converted );
+		if ( save_bm_image->Save( slot->converted, &sq->jpgClsid, &encoderParameters ) != Gdiplus::Ok )
+		{
+			save_report_error( slot, "An error occurred while converting the image to save." );
+
+			slot->converted->Release();
+			slot->converted = NULL;
+		}
+
+		delete save_bm_image;
+	}
+	else
+	{
+		if ( ( fi->flag & FIF_TYPE_UNKNOWN ) && header_offset > 0 )
+		{
+			unsigned char format = 0;
+			unsigned int raw_width = 0;
+			unsigned int raw_height = 0;
+			unsigned int raw_size = 0;
+			int raw_stride = 0;
+
+			if ( header_offset == 0x18 )
+			{
+				memcpy_s( &raw_stride, sizeof( int ), save_image + ( header_offset - ( sizeof( unsigned int ) * 4 ) ), sizeof( int ) );
+				memcpy_s( &raw_width, sizeof( unsigned int ), save_image + ( header_offset - ( sizeof( unsigned int ) * 3 ) ), sizeof( unsigned int ) );
+				memcpy_s( &raw_height, sizeof( unsigned int ), save_image + ( header_offset - ( sizeof( unsigned int ) * 2 ) ), sizeof( unsigned int ) );
+				format = 2;
+			}
+			else if ( header_offset == 0x34 )
+			{
+				memcpy_s( &raw_width, sizeof( unsigned int ), save_image + sizeof( unsigned int ), sizeof( unsigned int ) );
+				memcpy_s( &raw_height, sizeof( unsigned int ), save_image + ( sizeof( unsigned int ) * 2 ), sizeof( unsigned int ) );
+				memcpy_s( &raw_stride, sizeof( int ), save_image + ( sizeof( unsigned int ) * 3 ), sizeof( int ) );
+				format = 3;
+			}
+			memcpy_s( &raw_size, sizeof( unsigned int ), save_image + ( header_offset - sizeof( unsigned int ) ), sizeof( unsigned int ) );
+
+			Gdiplus::Image *save_bm_image = create_image( save_image + header_offset, size, format, raw_width, raw_height, raw_size, raw_stride );
+
+			Gdiplus::EncoderParameters encoderParameters;
+			encoderParameters.Count = 1;
+			encoderParameters.Parameter[ 0 ].Guid = Gdiplus::EncoderQuality;
+			encoderParameters.Parameter[ 0 ].Type = Gdiplus::EncoderParameterValueTypeLong;
+			encoderParameters.Parameter[ 0 ].NumberOfValues = 1;
+			ULONG quality = 100;
+			encoderParameters.Parameter[ 0 ].Value = &quality;
+
+			// We're going to save this as a PNG in order to preserve any alpha channels.
+			// The size will differ from what's listed in the database since we had to reconstruct the image.
+			CreateStreamOnHGlobal( NULL, TRUE, &slot->converted );
+			if ( save_bm_image->Save( slot->converted, &sq->pngClsid, &encoderParameters ) != Gdiplus::Ok )
+			{
+				save_report_error( slot, "An error occurred while converting the image to save." );
+
+				slot->converted->Release();
+				slot->converted = NULL;
+			}
+
+			delete save_bm_image;
+		}
+		else
+		{
+			slot->data = save_image + header_offset;
+			slot->size = size;
+		}
+	}
+}
+
+// Shows the slot's errors and writes its data to disk. The slot can be reused afterward.
+void write_save_slot( save_slot *slot )
+{
+	for ( unsigned long i = 0; i < slot->error_count; ++i )
+	{
+		if ( cmd_line != 2 && g_kill_thread == false ){ MessageBoxA( g_hWnd_main, slot->errors[ i ], PROGRAM_CAPTION_A, MB_APPLMODAL | MB_ICONWARNING ); }
+		free( slot->errors[ i ] );
+	}
+	slot->error_count = 0;
+
+	HGLOBAL hglobal = NULL;
+	if ( slot->converted != NULL )
+	{
+		STATSTG stat;
+		if ( slot->converted->Stat( &stat, STATFLAG_NONAME ) == S_OK && GetHGlobalFromStream( slot->converted, &hglobal ) == S_OK )
+		{
+			slot->data = ( char * )GlobalLock( hglobal );
+			slot->size = stat.cbSize.LowPart;
+		}
+	}
+
+	if ( slot->data != NULL && g_kill_thread == false )
+	{
+		// Attempt to open a file for saving.
+		HANDLE hFile_save = CreateFile( slot->fullpath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+		if ( hFile_save != INVALID_HANDLE_VALUE )
+		{
+			// Write the buffer to our file.
+			DWORD dwBytesWritten = 0;
+			WriteFile( hFile_save, slot->data, slot->size, &dwBytesWritten, NULL );
+
+			CloseHandle( hFile_save );
+		}
+
+		// See if the path was too long.
+		if ( GetLastError() == ERROR_PATH_NOT_FOUND )
+		{
+			if ( cmd_line != 2 ){ MessageBoxA( g_hWnd_main, "One or more files could not be saved. Please check the filename and path.", PROGRAM_CAPTION_A, MB_APPLMODAL | MB_ICONWARNING ); }
+		}
+	}
+
+	if ( slot->converted != NULL )
+	{
+		if ( hglobal != NULL )
+		{
+			GlobalUnlock( hglobal );
+		}
+
+		slot->converted->Release();
+		slot->converted = NULL;
+	}
+
+	slot->data = NULL;
+	slot->size = 0;
+}
+
+unsigned __stdcall save_worker( void *pArguments )
+{
+	save_queue *sq = ( save_queue * )pArguments;
+
+	while ( true )
+	{
+		WaitForSingleObject( sq->jobs, INFINITE );
+
+		unsigned long index = 0;
+		bool take_job = false;
+
+		EnterCriticalSection( &sq->lock );
+		if ( sq->next_job < sq->job_count )
+		{
+			index = sq->next_job++;
+			take_job = true;
+		}
+		LeaveCriticalSection( &sq->lock );
+
+		// We've been told to finish and there's nothing left to take.
+		if ( take_job == false )
+		{
+			break;
+		}
+
+		save_slot *slot = &sq->slots[ index % sq->slot_count ];
+
+		prepare_save_slot( sq, slot );
+
+		SetEvent( slot->done );
+	}
+
+	_endthreadex( 0 );
+	return 0;
+}
+
 unsigned __stdcall save_items( void *pArguments )
 {
 	// This will block every other thread from entering until the first thread is complete.
@@ -1055,13 +1238,47 @@ unsigned __stdcall save_items( void *pArguments )
 		// Depending on what was selected, get the number of items we'll be saving.
 		int save_items = ( save_type->save_all == true ? SendMessage( g_hWnd_list, LVM_GETITEMCOUNT, 0, 0 ) : SendMessage( g_hWnd_list, LVM_GETSELECTEDCOUNT, 0, 0 ) );
 
+		// Extracting and converting the entries is done by a worker on each processor. We write the files out in the same order as the listview.
+		unsigned long thread_count = get_processor_count();
+		if ( thread_count > ( unsigned long )save_items )
+		{
+			thread_count = ( save_items > 0 ? save_items : 1 );
+		}
+
+		save_queue sq;
+		sq.slot_count = thread_count * SAVE_SLOTS_PER_THREAD;
+		sq.slots = ( save_slot * )malloc( sizeof( save_slot ) * sq.slot_count );
+		memset( sq.slots, 0, sizeof( save_slot ) * sq.slot_count );
+		for ( unsigned long i = 0; i < sq.slot_count; ++i )
+		{
+			sq.slots[ i ].done = CreateEvent( NULL, FALSE, FALSE, NULL );
+		}
+		sq.next_job = 0;
+		sq.job_count = 0;
+		sq.jobs = CreateSemaphore( NULL, 0, sq.slot_count + thread_count, NULL );
+		InitializeCriticalSection( &sq.lock );
+		sq.save_directory = save_directory;
+
+		// Get the class identifiers for the JPEG and PNG encoders.
+		GetEncoderClsid( L"image/jpeg", &sq.jpgClsid );
+		GetEncoderClsid( L"image/png", &sq.pngClsid );
+
+		HANDLE *threads = ( HANDLE * )malloc( sizeof( HANDLE ) * thread_count );
+		unsigned long threads_created = 0;
+		for ( unsigned long i = 0; i < thread_count; ++i )
+		{
+			threads[ threads_created ] = ( HANDLE )_beginthreadex( NULL, 0, &save_worker, ( void * )&sq, 0, NULL );
+			if ( threads[ threads_created ] != NULL )
+			{
+				++threads_created;
+			}
+		}
+
 		// Retrieve the lParam value from the selected listview item.
 		LVITEM lvi = { NULL };
 		lvi.mask = LVIF_PARAM;
 		lvi.iItem = -1;	// Set this to -1 so that the LVM_GETNEXTITEM call can go through the list correctly.
 
-		fileinfo *fi = NULL;
-
 		// Go through all the items we'll be saving.
 		for ( int i = 0; i < save_items; ++i )
 		{
@@ -1074,153 +1291,76 @@ unsigned __stdcall save_items( void *pArguments )
 			lvi.iItem = ( save_type->save_all == true ? i : SendMessage( g_hWnd_list, LVM_GETNEXTITEM, lvi.iItem, LVNI_SELECTED ) );
 			SendMessage( g_hWnd_list, LVM_GETITEM, 0, ( LPARAM )&lvi );
 
-			fi = ( fileinfo * )lvi.lParam;
-			if ( fi == NULL || ( fi != NULL && fi->filename == NULL ) )
-			{
-				continue;
-			}
-
-			unsigned long size = 0, header_offset = 0;	// Size excludes the header offset.
-			// Create a buffer to read in our new bitmap.
-			char *save_image = extract( fi, size, header_offset );
-			if ( save_image == NULL )
+			unsigned long row = ( unsigned long )lvi.lParam;
+			if ( !is_entry_row( &g_entry_table, row ) || ENTRY_FIELD( &g_entry_table, row, filename ) == NULL )
 			{
 				continue;
 			}
 
-			// Directory + backslash + filename + extension + NULL character = ( MAX_PATH * 2 ) + 6
-			wchar_t fullpath[ ( MAX_PATH * 2 ) + 6 ] = { 0 };
+			save_slot *slot = &sq.slots[ sq.job_count % sq.slot_count ];
 
-			wchar_t *filename = get_filename_from_path( fi->filename, wcslen( fi->filename ) );
-
-			if ( ( fi->flag & FIF_TYPE_JPG ) || ( fi->flag & FIF_TYPE_CMYK_JPG ) )
-			{
-				wchar_t *ext = get_extension_from_filename( filename, wcslen( filename ) );
-				// The extension in the filename might not be the actual type. So we'll append .jpg to the end of it.
-				if ( _wcsicmp( ext, L".jpg" ) == 0 || _wcsicmp( ext, L".jpeg" ) == 0 )
-				{
-					swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s", save_directory, filename );
-				}
-				else
-				{
-					swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s.jpg", save_directory, filename );
-				}
-			}
-			else if ( ( fi->flag & FIF_TYPE_PNG ) || ( ( fi->flag & FIF_TYPE_UNKNOWN ) && header_offset > 0 ) )
+			if ( threads_created == 0 )	// Save it ourselves if no worker could be started.
 			{
-				wchar_t *ext = get_extension_from_filename( filename, wcslen( filename ) );
-				// The extension in the filename might not be the actual type. So we'll append .png to the end of it.
-				if ( _wcsicmp( ext, L".png" ) == 0 )
-				{
-					swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s", save_directory, filename );
-				}
-				else
-				{
-					swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s.png", save_directory, filename );
-				}
-			}
-			else
-			{
-				swprintf_s( fullpath, ( MAX_PATH * 2 ) + 6, L"%.259s\\%.259s", save_directory, filename );
+				get_entry_row( &g_entry_table, row, &slot->fi );
+				slot->row = row;
+				prepare_save_slot( &sq, slot );
+				write_save_slot( slot );
+
+				continue;
 			}
 
-			// If we have a CMYK based JPEG, then we're going to have to convert it to RGB.
-			if ( fi->flag & FIF_TYPE_CMYK_JPG )
+			// Wait for the oldest entry to be finished and write it out to make room for this one.
+			if ( sq.job_count >= sq.slot_count )
 			{
-				Gdiplus::Image *save_bm_image = create_image( save_image + header_offset, size, 1 );
-
-				// Get the class identifier for the JPEG encoder.
-				CLSID jpgClsid;
-				GetEncoderClsid( L"image/jpeg", &jpgClsid );
-
-				Gdiplus::EncoderParameters encoderParameters;
-				encoderParameters.Count = 1;
-				encoderParameters.Parameter[ 0 ].Guid = Gdiplus::EncoderQuality;
-				encoderParameters.Parameter[ 0 ].Type = Gdiplus::EncoderParameterValueTypeLong;
-				encoderParameters.Parameter[ 0 ].NumberOfValues = 1;
-				ULONG quality = 100;
-				encoderParameters.Parameter[ 0 ].Value = &quality;
-
-				// The size will differ from what's listed in the database since we had to reconstruct the image.
-				// Switch the encoder to PNG or BMP to save a lossless image.
-				if ( save_bm_image->Save( fullpath, &jpgClsid, &encoderParameters ) != Gdiplus::Ok )
-				{
-					if ( cmd_line != 2 ){ MessageBoxA( g_hWnd_main, "An error occurred while converting the image to save.", PROGRAM_CAPTION_A, MB_APPLMODAL | MB_ICONWARNING ); }
-				}
-
-				delete save_bm_image;
+				WaitForSingleObject( slot->done, INFINITE );
+				write_save_slot( slot );
 			}
-			else
-			{
-				if ( ( fi->flag & FIF_TYPE_UNKNOWN ) && header_offset > 0 )
-				{
-					unsigned char format = 0;
-					unsigned int raw_width = 0;
-					unsigned int raw_height = 0;
-					unsigned int raw_size = 0;
-					int raw_stride = 0;
 
-					if ( header_offset == 0x18 )
-					{
-						memcpy_s( &raw_stride, sizeof( int ), save_image + ( header_offset - ( sizeof( unsigned int ) * 4 ) ), sizeof( int ) );
-						memcpy_s( &raw_width, sizeof( unsigned int ), save_image + ( header_offset - ( sizeof( unsigned int ) * 3 ) ), sizeof( unsigned int ) );
-						memcpy_s( &raw_height, sizeof( unsigned int ), save_image + ( header_offset - ( sizeof( unsigned int ) * 2 ) ), sizeof( unsigned int ) );
-						format = 2;
-					}
-					else if ( header_offset == 0x34 )
-					{
-						memcpy_s( &raw_width, sizeof( unsigned int ), save_image + sizeof( unsigned int ), sizeof( unsigned int ) );
-						memcpy_s( &raw_height, sizeof( unsigned int ), save_image + ( sizeof( unsigned int ) * 2 ), sizeof( unsigned int ) );
-						memcpy_s( &raw_stride, sizeof( int ), save_image + ( sizeof( unsigned int ) * 3 ), sizeof( int ) );
-						format = 3;
-					}
-					memcpy_s( &raw_size, sizeof( unsigned int ), save_image + ( header_offset - sizeof( unsigned int ) ), sizeof( unsigned int ) );
+			get_entry_row( &g_entry_table, row, &slot->fi );
+			slot->row = row;
 
-					Gdiplus::Image *save_bm_image = create_image( save_image + header_offset, size, format, raw_width, raw_height, raw_size, raw_stride );
+			EnterCriticalSection( &sq.lock );
+			++sq.job_count;
+			LeaveCriticalSection( &sq.lock );
 
-					// Get the class identifier for the PNG encoder. We're going to save this as a PNG in order to preserve any alpha channels.
-					CLSID pngClsid;
-					GetEncoderClsid( L"image/png", &pngClsid );
+			ReleaseSemaphore( sq.jobs, 1, NULL );
+		}
 
-					Gdiplus::EncoderParameters encoderParameters;
-					encoderParameters.Count = 1;
-					encoderParameters.Parameter[ 0 ].Guid = Gdiplus::EncoderQuality;
-					encoderParameters.Parameter[ 0 ].Type = Gdiplus::EncoderParameterValueTypeLong;
-					encoderParameters.Parameter[ 0 ].NumberOfValues = 1;
-					ULONG quality = 100;
-					encoderParameters.Parameter[ 0 ].Value = &quality;
+		// Write out the entries that are still in the queue.
+		if ( threads_created > 0 )
+		{
+			for ( unsigned long i = ( sq.job_count > sq.slot_count ? sq.job_count - sq.slot_count : 0 ); i < sq.job_count; ++i )
+			{
+				save_slot *slot = &sq.slots[ i % sq.slot_count ];
 
-					// The size will differ from what's listed in the database since we had to reconstruct the image.
-					if ( save_bm_image->Save( fullpath, &pngClsid, &encoderParameters ) != Gdiplus::Ok )
-					{
-						if ( cmd_line != 2 ){ MessageBoxA( g_hWnd_main, "An error occurred while converting the image to save.", PROGRAM_CAPTION_A, MB_APPLMODAL | MB_ICONWARNING ); }
-					}
+				WaitForSingleObject( slot->done, INFINITE );
+				write_save_slot( slot );
+			}
+		}
 
-					delete save_bm_image;
-				}
-				else
-				{
-					// Attempt to open a file for saving.
-					HANDLE hFile_save = CreateFile( fullpath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
-					if ( hFile_save != INVALID_HANDLE_VALUE )
-					{
-						// Write the buffer to our file.
-						DWORD dwBytesWritten = 0;
-						WriteFile( hFile_save, save_image + header_offset, size, &dwBytesWritten, NULL );
+		// Let the workers exit. They'll find that there's nothing left to take.
+		if ( threads_created > 0 )
+		{
+			ReleaseSemaphore( sq.jobs, threads_created, NULL );
+		}
 
-						CloseHandle( hFile_save );
-					}
+		for ( unsigned long i = 0; i < threads_created; ++i )
+		{
+			WaitForSingleObject( threads[ i ], INFINITE );
+			CloseHandle( threads[ i ] );
+		}
+		free( threads );
 
-					// See if the path was too long.
-					if ( GetLastError() == ERROR_PATH_NOT_FOUND )
-					{
-						if ( cmd_line != 2 ){ MessageBoxA( g_hWnd_main, "One or more files could not be saved. Please check the filename and path.", PROGRAM_CAPTION_A, MB_APPLMODAL | MB_ICONWARNING ); }
-					}
-				}
-			}
-			// Free our buffer.
-			free( save_image );
+		for ( unsigned long i = 0; i < sq.slot_count; ++i )
+		{
+			free( sq.slots[ i ].buf );
+			free( sq.slots[ i ].errors );
+			CloseHandle( sq.slots[ i ].done );
 		}
+		free( sq.slots );
+
+		CloseHandle( sq.jobs );
+		DeleteCriticalSection( &sq.lock );
 
 		free( save_type->filepath );
 		free( save_type );
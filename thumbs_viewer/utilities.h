@@ -21,9 +21,14 @@
 
 #include "globals.h"
 #include "dllrbt.h"
+#include "entry_table.h"
+#include "hash_table.h"
+#include "bloom_filter.h"
 
 #define SNAP_WIDTH		10		// The minimum distance at which our windows will attach together.
 
+#define SAVE_SLOTS_PER_THREAD	4	// Number of entries each save worker can have queued or waiting to be written.
+
 unsigned __stdcall cleanup( void *pArguments );
 unsigned __stdcall remove_items( void *pArguments );
 unsigned __stdcall save_csv( void *pArguments );
@@ -32,12 +37,11 @@ unsigned __stdcall copy_items( void *pArguments );
 
 wchar_t *get_extension_from_filename( wchar_t *filename, unsigned long length );
 wchar_t *get_filename_from_path( wchar_t *path, unsigned long length );
-void reverse_string( wchar_t *string );
 char *escape_csv( const char *string );
 
-void cleanup_shared_info( shared_info **si );
-void cleanup_fileinfo_tree();
-void create_fileinfo_tree();
+void add_entry_hash( unsigned long row );
+void remove_entry_hash( unsigned long row );
+void clear_entry_hashes();
 
 bool is_close( int a, int b );
 
@@ -46,6 +50,8 @@ void Processing_Window( bool enable );
 Gdiplus::Image *create_image( char *buffer, unsigned long size, unsigned char format, unsigned int raw_width = 0, unsigned int raw_height = 0, unsigned int raw_size = 0, int raw_stride = 0 );
 
 extern HANDLE shutdown_semaphore;	// Blocks shutdown while a worker thread is active.
-extern dllrbt_tree *fileinfo_tree;	// Red-black tree of fileinfo structures.
+extern entry_table g_entry_table;	// Holds the entries that are in the listview.
+extern hash_table entry_hash_table;	// Entry rows, keyed by their entry hash.
+extern bloom_filter entry_bloom_filter;	// Rules out most hashes before the entry hash table is searched.
 
 #endif
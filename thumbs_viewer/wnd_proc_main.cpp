@@ -20,6 +20,7 @@
 #include "utilities.h"
 #include "read_thumbs.h"
 #include "menus.h"
+#include "map_entries.h"
 
 WNDPROC ListViewProc = NULL;		// Subclassed listview window.
 WNDPROC EditProc = NULL;			// Subclassed listview edit window.
@@ -52,14 +53,15 @@ RECT last_dim = { 0 };				// Keeps track of the image window's dimension before
 HCURSOR wait_cursor = NULL;			// Temporary cursor while processing entries.
 
 // Image variables
-fileinfo *current_fileinfo = NULL;	// Holds information about the currently selected image. Gets deleted in WM_DESTROY.
+unsigned long current_row = 0;		// Entry table row of the item that's being renamed.
 Gdiplus::Image *gdi_image = NULL;	// GDI+ image object. We need it to handle .png and .jpg images.
 
 // Sort function for columns.
 int CALLBACK CompareFunc( LPARAM lParam1, LPARAM lParam2, LPARAM lParamSort )
 {
-	fileinfo *fi1 = ( ( fileinfo * )lParam1 );
-	fileinfo *fi2 = ( ( fileinfo * )lParam2 );
+	// The lParam values are rows in the entry table. Each comparison only reads the column it needs.
+	unsigned long row1 = ( unsigned long )lParam1;
+	unsigned long row2 = ( unsigned long )lParam2;
 
 	unsigned char index = 0;
 
@@ -73,58 +75,66 @@ int CALLBACK CompareFunc( LPARAM lParam1, LPARAM lParam2, LPARAM lParamSort )
 	{
 		index = ( unsigned char )lParamSort;
 
-		fi1 = ( ( fileinfo * )lParam2 );
-		fi2 = ( ( fileinfo * )lParam1 );
+		row1 = ( unsigned long )lParam2;
+		row2 = ( unsigned long )lParam1;
 	}
 
+	entry_table *table = &g_entry_table;
+
 	switch ( index )
 	{
 		case 1:
 		{
-			return _wcsicmp( fi1->filename, fi2->filename );
+			return _wcsicmp( ENTRY_FIELD( table, row1, filename ), ENTRY_FIELD( table, row2, filename ) );
 		}
 		break;
 
 		case 2:
 		{
-			return ( fi1->size > fi2->size );
+			return ( ENTRY_FIELD( table, row1, size ) > ENTRY_FIELD( table, row2, size ) );
 		}
 		break;
 
 		case 3:
 		{
-			return ( fi1->offset > fi2->offset );
+			return ( ENTRY_FIELD( table, row1, offset ) > ENTRY_FIELD( table, row2, offset ) );
 		}
 		break;
 
 		case 4:
 		{
-			return ( fi1->date_modified > fi2->date_modified );
+			return ( ENTRY_FIELD( table, row1, date_modified ) > ENTRY_FIELD( table, row2, date_modified ) );
 		}
 		break;
 
 		case 5:
 		{
-			if ( fi1->si == NULL && fi2->si == NULL ) { return 0; }
-			else if ( fi1->si != NULL && fi2->si == NULL ) { return 1; }
-			else if ( fi1->si == NULL && fi2->si != NULL ) { return -1; }
-			if ( fi1->si->system == fi2->si->system )
+			shared_info *si1 = ENTRY_FIELD( table, row1, si );
+			shared_info *si2 = ENTRY_FIELD( table, row2, si );
+
+			if ( si1 == NULL && si2 == NULL ) { return 0; }
+			else if ( si1 != NULL && si2 == NULL ) { return 1; }
+			else if ( si1 == NULL && si2 != NULL ) { return -1; }
+			if ( si1->system == si2->system )
 			{
-				return ( fi1->si->version > fi2->si->version );	// Based on our values for the system, this will be sorted by operating system age.
+				return ( si1->version > si2->version );	// Based on our values for the system, this will be sorted by operating system age.
 			}
 			else
 			{
-				return ( fi1->si->system > fi2->si->system );	// Handles unknown versions and systems.
+				return ( si1->system > si2->system );	// Handles unknown versions and systems.
 			}
 		}
 		break;
 
 		case 6:
 		{
-			if ( fi1->si == NULL && fi2->si == NULL ) { return 0; }
-			else if ( fi1->si != NULL && fi2->si == NULL ) { return 1; }
-			else if ( fi1->si == NULL && fi2->si != NULL ) { return -1; }
-			return _wcsicmp( fi1->si->dbpath, fi2->si->dbpath );
+			shared_info *si1 = ENTRY_FIELD( table, row1, si );
+			shared_info *si2 = ENTRY_FIELD( table, row2, si );
+
+			if ( si1 == NULL && si2 == NULL ) { return 0; }
+			else if ( si1 != NULL && si2 == NULL ) { return 1; }
+			else if ( si1 == NULL && si2 != NULL ) { return -1; }
+			return _wcsicmp( si1->dbpath, si2->dbpath );
 		}
 		break;
 
@@ -744,15 +754,23 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 					lvi.iItem = nmlv->iItem;
 					SendMessage( nmlv->hdr.hwndFrom, LVM_GETITEM, 0, ( LPARAM )&lvi );
 
-					fileinfo *fi = ( fileinfo * )lvi.lParam;
-					if ( fi == NULL )
+					unsigned long row = ( unsigned long )lvi.lParam;
+					if ( !is_entry_row( &g_entry_table, row ) )
 					{
 						break;
 					}
 
+					fileinfo entry;
+					get_entry_row( &g_entry_table, row, &entry );
+					fileinfo *fi = &entry;
+
 					unsigned long size = 0, header_offset = 0;	// Size excludes the header offset.
 					// Create a buffer to read in our new bitmap.
 					char *current_image = extract( fi, size, header_offset );
+
+					// Keep the type that was found.
+					ENTRY_FIELD( &g_entry_table, row, flag ) |= fi->flag;
+
 					if ( current_image == NULL )
 					{
 						break;
@@ -875,13 +893,15 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 					lvi.mask = LVIF_PARAM;
 					SendMessage( pdi->hdr.hwndFrom, LVM_GETITEM, 0, ( LPARAM )&lvi );
 
-					// Save our current fileinfo.
-					current_fileinfo = ( fileinfo * )lvi.lParam;
-					if ( current_fileinfo == NULL )
+					// Save our current row.
+					current_row = ( unsigned long )lvi.lParam;
+					if ( !is_entry_row( &g_entry_table, current_row ) )
 					{
 						return TRUE;
 					}
 
+					wchar_t *current_filename = ENTRY_FIELD( &g_entry_table, current_row, filename );
+
 					// Get the bounding box of the Filename column we're editing.
 					current_edit_pos.top = 1;
 					current_edit_pos.left = LVIR_BOUNDS;
@@ -895,11 +915,11 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 					SetWindowLongPtr( g_hWnd_edit, GWL_WNDPROC, ( LONG )EditSubProc );
 
 					// Set our edit control's text to the list item's text.
-					SetWindowText( g_hWnd_edit, current_fileinfo->filename );
+					SetWindowText( g_hWnd_edit, current_filename );
 
 					// Get the length of the filename without the extension.
-					int ext_len = wcslen( current_fileinfo->filename );
-					while ( ext_len != 0 && current_fileinfo->filename[ --ext_len ] != L'.' );
+					int ext_len = wcslen( current_filename );
+					while ( ext_len != 0 && current_filename[ --ext_len ] != L'.' );
 
 					// Select all the text except the file extension (if ext_len = 0, then everything is selected)
 					SendMessage( g_hWnd_edit, EM_SETSEL, 0, ext_len );
@@ -924,16 +944,19 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 					{
 						return FALSE;
 					}
+					// Prevent the edit if the entry is gone.
+					if ( !is_entry_row( &g_entry_table, current_row ) )
+					{
+						return FALSE;
+					}
 
-					// Free the old filename.
-					free( current_fileinfo->filename );
 					// Create a new filename based on the editbox's text.
 					wchar_t *filename = ( wchar_t * )malloc( sizeof( wchar_t ) * ( length + 1 ) );
 					wmemset( filename, 0, length + 1 );
 					wcscpy_s( filename, length + 1, pdi->item.pszText );
 
-					// Modify our listview item's fileinfo lParam value.
-					current_fileinfo->filename = filename;
+					// Modify our listview item's entry. The old filename is freed if it was allocated on its own.
+					set_entry_name( &g_entry_table, current_row, filename );
 
 					// Set the image window's new title.
 					wchar_t new_title[ MAX_PATH + 30 ] = { 0 };
@@ -956,12 +979,16 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 			// The item we want to draw is our listview.
 			if ( dis->CtlType == ODT_LISTVIEW && dis->itemData != NULL )
 			{
-				fileinfo *fi = ( fileinfo * )dis->itemData;
-				if ( fi->si == NULL )
+				unsigned long row = ( unsigned long )dis->itemData;
+				if ( !is_entry_row( &g_entry_table, row ) )
 				{
 					return TRUE;
 				}
 
+				fileinfo entry;
+				get_entry_row( &g_entry_table, row, &entry );
+				fileinfo *fi = &entry;
+
 				// Alternate item color's background.
 				if ( dis->itemID % 2 )	// Even rows will have a light grey background.
 				{
@@ -1034,8 +1061,8 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 						{
 							RIGHT_COLUMNS = DT_RIGHT;
 
-							// Distinguish between Short SAT and SAT entries.
-							swprintf_s( buf, MAX_PATH, ( fi->size < fi->si->short_sect_cutoff ? L"%d in SSAT" : L"%d in SAT" ), fi->offset );
+							// Distinguish between Short SAT, SAT, and thumbcache entries.
+							swprintf_s( buf, MAX_PATH, ( fi->si->database_type == DATABASE_TYPE_CACHE ? L"%d in cache" : ( fi->size < fi->si->short_sect_cutoff ? L"%d in SSAT" : L"%d in SAT" ) ), fi->offset );
 						}
 						break;
 
@@ -1187,8 +1214,11 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 			EnableWindow( g_hWnd_scan, FALSE );
 			ShowWindow( g_hWnd_scan, SW_HIDE );
 
+			// Stop the scan window's watch. It can be about to map a batch of changes, so it's waited on like any other secondary thread.
+			g_kill_scan = true;
+
 			// If we're in a secondary thread, then kill it (cleanly) and wait for it to exit.
-			if ( in_thread == true )
+			if ( in_thread == true || g_watching == true )
 			{
 				CloseHandle( ( HANDLE )_beginthreadex( NULL, 0, &cleanup, ( void * )NULL, 0, NULL ) );
 			}
@@ -1210,40 +1240,9 @@ LRESULT CALLBACK MainWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 
 		case WM_DESTROY:
 		{
-			// Get the number of items in the listview.
-			int num_items = SendMessage( g_hWnd_list, LVM_GETITEMCOUNT, 0, 0 );
-
-			LVITEM lvi = { NULL };
-			lvi.mask = LVIF_PARAM;
-
-			fileinfo *fi = NULL;
-
-			// Go through each item, and free their lParam values. current_fileinfo will get deleted here.
-			for ( int i = 0; i < num_items; ++i )
-			{
-				lvi.iItem = i;
-				SendMessage( g_hWnd_list, LVM_GETITEM, 0, ( LPARAM )&lvi );
-
-				fi = ( fileinfo * )lvi.lParam;
-				if ( fi != NULL )
-				{
-					if ( fi->si != NULL )
-					{
-						--( fi->si->count );
-
-						// Remove our shared information from the linked list if there's no more items for this database.
-						if ( fi->si->count == 0 )
-						{
-							cleanup_shared_info( &( fi->si ) );
-						}
-					}
-
-					// First free the filename pointer.
-					free( fi->filename );
-					// Then free the fileinfo structure.
-					free( fi );
-				}
-			}
+			// Free every entry, and the shared information of each database.
+			free_entry_table( &g_entry_table );
+			clear_entry_hashes();
 
 			// Delete out image object.
 			if ( gdi_image != NULL )
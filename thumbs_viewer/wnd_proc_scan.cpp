@@ -28,6 +28,7 @@
 HWND g_hWnd_path = NULL;
 HWND g_hWnd_extensions = NULL;
 HWND g_hWnd_chk_folders = NULL;
+HWND g_hWnd_chk_watch = NULL;
 HWND g_hWnd_hashing = NULL;
 HWND g_hWnd_btn_scan = NULL;
 HWND g_hWnd_btn_cancel = NULL;
@@ -62,6 +63,7 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 			SendMessage( g_hWnd_extensions, EM_LIMITTEXT, MAX_PATH - 1, 0 );
 
 			g_hWnd_chk_folders = CreateWindowA( WC_BUTTONA, "Include Folders", BS_AUTOCHECKBOX | WS_CHILD | WS_TABSTOP | WS_VISIBLE, 0, 0, 0, 0, hWnd, NULL, NULL, NULL );
+			g_hWnd_chk_watch = CreateWindowA( WC_BUTTONA, "Watch for Changes", BS_AUTOCHECKBOX | WS_CHILD | WS_TABSTOP | WS_VISIBLE, 0, 0, 0, 0, hWnd, NULL, NULL, NULL );
 
 			g_hWnd_static3 = CreateWindowA( WC_STATICA, "Current file/folder:", WS_CHILD, 20, 110, rc.right - 40, 15, hWnd, NULL, NULL, NULL );
 			g_hWnd_hashing = CreateWindowEx( WS_EX_CLIENTEDGE, WC_EDIT, NULL, ES_AUTOHSCROLL | ES_READONLY | WS_CHILD, 0, 0, 0, 0, hWnd, NULL, NULL, NULL );
@@ -87,6 +89,7 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 			SendMessage( g_hWnd_load, WM_SETFONT, ( WPARAM )hFont, 0 );
 			SendMessage( g_hWnd_extensions, WM_SETFONT, ( WPARAM )hFont, 0 );
 			SendMessage( g_hWnd_chk_folders, WM_SETFONT, ( WPARAM )hFont, 0 );
+			SendMessage( g_hWnd_chk_watch, WM_SETFONT, ( WPARAM )hFont, 0 );
 			SendMessage( g_hWnd_hashing, WM_SETFONT, ( WPARAM )hFont, 0 );
 			SendMessage( g_hWnd_static_hash, WM_SETFONT, ( WPARAM )hFont, 0 );
 			SendMessage( g_hWnd_static_count, WM_SETFONT, ( WPARAM )hFont, 0 );
@@ -219,6 +222,7 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 							}
 
 							g_include_folders = SendMessage( g_hWnd_chk_folders, BM_GETCHECK, 0, 0 ) ? true : false;
+							g_watch_changes = SendMessage( g_hWnd_chk_watch, BM_GETCHECK, 0, 0 ) ? true : false;
 
 							// Run the scan thread.
 							CloseHandle( ( HANDLE )_beginthreadex( NULL, 0, &map_entries, NULL, 0, NULL ) );
@@ -312,11 +316,12 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 			GetClientRect( hWnd, &rc );
 
 			// Allow our controls to move in relation to the parent window.
-			HDWP hdwp = BeginDeferWindowPos( 8 );
+			HDWP hdwp = BeginDeferWindowPos( 9 );
 			DeferWindowPos( hdwp, g_hWnd_path, HWND_TOP, 20, 35, rc.right - 75, 20, SWP_NOZORDER );
 			DeferWindowPos( hdwp, g_hWnd_load, HWND_TOP, rc.right - 50, 35, 30, 20, SWP_NOZORDER );
-			DeferWindowPos( hdwp, g_hWnd_extensions, HWND_TOP, 20, 80, rc.right - 145, 20, SWP_NOZORDER );
-			DeferWindowPos( hdwp, g_hWnd_chk_folders, HWND_TOP, rc.right - 120, 80, 100, 20, SWP_NOZORDER );
+			DeferWindowPos( hdwp, g_hWnd_extensions, HWND_TOP, 20, 80, rc.right - 260, 20, SWP_NOZORDER );
+			DeferWindowPos( hdwp, g_hWnd_chk_folders, HWND_TOP, rc.right - 235, 80, 100, 20, SWP_NOZORDER );
+			DeferWindowPos( hdwp, g_hWnd_chk_watch, HWND_TOP, rc.right - 130, 80, 110, 20, SWP_NOZORDER );
 			DeferWindowPos( hdwp, g_hWnd_hashing, HWND_TOP, 20, 125, rc.right - 40, 20, SWP_NOZORDER );
 			DeferWindowPos( hdwp, g_hWnd_btn_details, HWND_TOP, 10, rc.bottom - 32, 100, 23, SWP_NOZORDER );
 			DeferWindowPos( hdwp, g_hWnd_btn_scan, HWND_TOP, rc.right - 175, rc.bottom - 32, 80, 23, SWP_NOZORDER );
@@ -349,7 +354,11 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 
 		case WM_CLOSE:
 		{
-			g_kill_scan = true;
+			// The watch keeps going so that the main window can be used. It's stopped from this window.
+			if ( g_watching == false )
+			{
+				g_kill_scan = true;
+			}
 
 			// Reenable the main window.
 			EnableWindow( g_hWnd_main, TRUE );
@@ -375,6 +384,7 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 				EnableWindow( g_hWnd_load, FALSE );
 				EnableWindow( g_hWnd_extensions, FALSE );
 				EnableWindow( g_hWnd_chk_folders, FALSE );
+				EnableWindow( g_hWnd_chk_watch, FALSE );
 
 				// We're scanning. Set the button's text to "Stop".
 				SendMessageA( g_hWnd_btn_scan, WM_SETTEXT, 0, ( LPARAM )"Stop" );
@@ -394,6 +404,7 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 				EnableWindow( g_hWnd_load, TRUE );
 				EnableWindow( g_hWnd_extensions, TRUE );
 				EnableWindow( g_hWnd_chk_folders, TRUE );
+				EnableWindow( g_hWnd_chk_watch, TRUE );
 
 				// We've stopped/finished scanning. Set the button's text to "Scan".
 				SendMessageA( g_hWnd_btn_scan, WM_SETTEXT, 0, ( LPARAM )"Scan" );
@@ -413,14 +424,18 @@ LRESULT CALLBACK ScanWndProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam
 			}
 			else
 			{
-				g_kill_scan = true;
+				// Show the watch's details if it's still going.
+				if ( g_watching == false )
+				{
+					g_kill_scan = true;
 
-				// Reset text information.
-				SendMessage( g_hWnd_hashing, WM_SETTEXT, 0, 0 );
-				SendMessageA( g_hWnd_static_hash, WM_SETTEXT, 0, 0 );
-				SendMessageA( g_hWnd_static_count, WM_SETTEXT, 0, 0 );
-				SendMessageA( g_hWnd_btn_scan, WM_SETTEXT, 0, ( LPARAM )"Scan" );
-				EnableWindow( g_hWnd_btn_scan, ( SendMessage( g_hWnd_path, WM_GETTEXTLENGTH, 0, 0 ) >= 3 ) ? TRUE : FALSE );
+					// Reset text information.
+					SendMessage( g_hWnd_hashing, WM_SETTEXT, 0, 0 );
+					SendMessageA( g_hWnd_static_hash, WM_SETTEXT, 0, 0 );
+					SendMessageA( g_hWnd_static_count, WM_SETTEXT, 0, 0 );
+					SendMessageA( g_hWnd_btn_scan, WM_SETTEXT, 0, ( LPARAM )"Scan" );
+					EnableWindow( g_hWnd_btn_scan, ( SendMessage( g_hWnd_path, WM_GETTEXTLENGTH, 0, 0 ) >= 3 ) ? TRUE : FALSE );
+				}
 
 				// Disable the main window.
 				EnableWindow( g_hWnd_main, FALSE );